@@ -7,18 +7,55 @@ import os
 from scipy.stats import lognorm
 
 base_path = "../results"
+results_extension = ".txt"  # ".acol" to plot the files written with results_format = columnar
+
+def results_file(file_name):
+    """ The path of the result file file_name, given without its extension, in base_path"""
+
+    return os.path.join(base_path, file_name + results_extension)
+
+def read_columns(path):
+    """ Memory-map a columnar result file (.acol, written with results_format = columnar) without reading it :
+        a dict of the column names to float64 arrays backed by the file. The layout is documented in
+        src/result_writer.hpp"""
+
+    with open(path, 'rb') as f:
+        if f.read(8) != b'ACOLS002':
+            raise ValueError(f"{path} is not a columnar result file")
+        byte_order = f.read(8)
+        if byte_order == bytes(range(8, 0, -1)):
+            endian = '<'
+        elif byte_order == bytes(range(1, 9)):
+            endian = '>'
+        else:
+            raise ValueError(f"{path} has no byte order")
+        num_columns, num_rows = np.frombuffer(f.read(16), dtype=endian + 'u8')
+        names = []
+        for _ in range(num_columns):
+            length = int(np.frombuffer(f.read(8), dtype=endian + 'u8')[0])
+            names.append(f.read(length).decode())
+        offset = (f.tell() + 7) // 8 * 8
+    data = np.memmap(path, dtype=endian + 'f8', mode='r', offset=offset, shape=(int(num_columns), int(num_rows)))
+    return {name: data[i] for i, name in enumerate(names)}
+
+def read_results(path):
+    """ A result file as a DataFrame, from its columns if it is columnar, else parsed as text"""
+
+    if path.endswith('.acol'):
+        return pd.DataFrame(read_columns(path), copy=False)
+    return pd.read_csv(path, sep=r'\s+')
 
 def QRvsIAC_10vs50(num_reconstructions, translation_range, ylim = None):
     """ Read and display comparison between QR and IAC methods for recovering K over 10 and 50 cameras
         using 1997 Pollefeys method to recover absolute quadric"""
 
     # Load both datasets
-    file_name_10 = f"QRvsIAC_10Cams_{num_reconstructions}Reconstr_{translation_range}Transl.txt"
-    file_name_50 = f"QRvsIAC_50Cams_{num_reconstructions}Reconstr_{translation_range}Transl.txt"
-    path_10 = os.path.join(base_path, file_name_10)
-    path_50 = os.path.join(base_path, file_name_50)
-    df_10 = pd.read_csv(path_10, sep=r'\s+')
-    df_50 = pd.read_csv(path_50, sep=r'\s+')
+    file_name_10 = f"QRvsIAC_10Cams_{num_reconstructions}Reconstr_{translation_range}Transl"
+    file_name_50 = f"QRvsIAC_50Cams_{num_reconstructions}Reconstr_{translation_range}Transl"
+    path_10 = results_file(file_name_10)
+    path_50 = results_file(file_name_50)
+    df_10 = read_results(path_10)
+    df_50 = read_results(path_50)
 
     # Create side-by-side plots
     fig, axes = plt.subplots(1, 2, figsize=(14, 5), sharey=True)
@@ -52,12 +89,12 @@ def QRvsIAC_10vs50_1997paper(num_reconstructions, translation_range, ylim = None
     """ Read and display comparison between QR and IAC methods for recovering K over 10 and 50 cameras
         using 1997 Pollefeys method to recover absolute quadric"""
     # Load both datasets
-    file_name_10 = f"QRvsIAC_10Cams_{num_reconstructions}Reconstr_{translation_range}Transl_1997paper.txt"
-    file_name_50 = f"QRvsIAC_50Cams_{num_reconstructions}Reconstr_{translation_range}Transl_1997paper.txt"
-    path_10 = os.path.join(base_path, file_name_10)
-    path_50 = os.path.join(base_path, file_name_50)
-    df_10 = pd.read_csv(path_10, sep=r'\s+')
-    df_50 = pd.read_csv(path_50, sep=r'\s+')
+    file_name_10 = f"QRvsIAC_10Cams_{num_reconstructions}Reconstr_{translation_range}Transl_1997paper"
+    file_name_50 = f"QRvsIAC_50Cams_{num_reconstructions}Reconstr_{translation_range}Transl_1997paper"
+    path_10 = results_file(file_name_10)
+    path_50 = results_file(file_name_50)
+    df_10 = read_results(path_10)
+    df_50 = read_results(path_50)
 
     # Create side-by-side plots
     fig, axes = plt.subplots(1, 2, figsize=(14, 5), sharey=True)
@@ -0,0 +1,72 @@
+// Autocalibration of rigs of a few cameras without any heap allocation : everything the metric upgrade needs is a
+// fixed-size Eigen type on the stack, so that its latency does not depend on the allocator in real-time use.
+
+#pragma once
+
+#include <Eigen/SVD>
+
+#include "libmv.hpp"
+
+namespace rootba_povar {
+
+    /** \brief AutoCalibrationLinear for at most N projections, solved with the
+     *         SVD of a fixed-size constraint matrix.
+     *
+     *  The constraints of Policy are assembled as by AutoCalibrationLinear,
+     *  into the rows of the matrix kept by the object, and MetricTransformation
+     *  decomposes it with a fixed-size JacobiSVD : neither adding a projection
+     *  nor the metric upgrade allocates.  The rows of the projections not added
+     *  are zero, which leaves the nullspace unchanged, so that fewer than N
+     *  projections can be used.  There is no normal equations mode, no sliding
+     *  window and no cache of the result.
+     */
+    template <typename Scalar, int N, typename Policy = Pollefeys2004Constraints>
+    class AutoCalibrationFixed {
+    public:
+        using Linear = AutoCalibrationLinear<Scalar, Policy>;
+        static constexpr int kNumRows = N * Linear::kNumConstraints;
+
+        AutoCalibrationFixed() { A_.setZero(); }
+
+        /** \brief See AutoCalibrationLinear::AddProjection.
+         *  \return The index of the projection, -1 if N projections are already held.
+         */
+        int AddProjection(const Eigen::Matrix<Scalar, 3, 4> &P, Scalar width, Scalar height) {
+            return AddProjection(Linear::ComputeDiacCoefficients(P, width, height));
+        }
+
+        /** \brief AddProjection, from the coefficients of ComputeDiacCoefficients. */
+        int AddProjection(const DiacCoefficients<Scalar> &coefficients) {
+            if (num_projections_ == N) return -1;
+            A_.template middleRows<Linear::kNumConstraints>(num_projections_ * Linear::kNumConstraints) = Linear::ComputeConstraints(coefficients);
+            return num_projections_++;
+        }
+
+        int num_projections() const { return num_projections_; }
+
+        /** \brief Forgets all the projections, to start again with the next frame. */
+        void Clear() {
+            A_.setZero();
+            num_projections_ = 0;
+        }
+
+        /** \brief See AutoCalibrationLinear::MetricTransformation. */
+        Eigen::Matrix<Scalar, 4, 4> MetricTransformation(Eigen::Matrix<Scalar, 4, 4> *Q_final = nullptr, int *rank = nullptr) const {
+            // Compute the dual absolute quadric, Q.
+            Eigen::JacobiSVD<ConstraintMatrix> svd(A_, Eigen::ComputeFullV);
+            const Eigen::Matrix<Scalar, 10, 1> q = svd.matrixV().col(9);
+            const Eigen::Matrix<Scalar, 4, 4> Q = Linear::AbsoluteQuadricMatFromVec(q);
+            if (Q_final) *Q_final = Q;
+
+            // Compute a transformation to a metric frame by decomposing Q.
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 4, 4>> eigen_solver(Q);
+            return Linear::MetricTransformationFromEigen(eigen_solver.eigenvalues(), eigen_solver.eigenvectors(), rank);
+        }
+
+    private:
+        using ConstraintMatrix = Eigen::Matrix<Scalar, kNumRows, 10>;
+
+        ConstraintMatrix A_;  // The constraints of projection i in rows i * kNumConstraints onwards.
+        int num_projections_ = 0;
+    };
+}
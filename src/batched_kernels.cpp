@@ -0,0 +1,544 @@
+#include "batched_kernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ROOTBA_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace rootba_povar {
+
+    namespace {
+
+        // Packs are only passed by value between functions that end up flattened into the target-specific entry
+        // points below, so the vector ABI never matters.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+        template <typename Scalar, int Bytes>
+        struct PackOf {
+            typedef Scalar type __attribute__((vector_size(Bytes)));
+        };
+
+        // An instruction set : the type holding one value per lane, and the operations not covered by the
+        // GCC vector extensions.
+        struct ScalarIsa {
+            template <typename Scalar> using Pack = Scalar;
+            static float sqrt(float x) { return __builtin_sqrtf(x); }
+            static double sqrt(double x) { return __builtin_sqrt(x); }
+        };
+
+#ifdef ROOTBA_X86_SIMD
+        // The square roots pass their packs through memory, unaligned : sqrt, built for the default target as the
+        // lane functions calling it, is only inlined into the entry points of the instruction set by flatten when
+        // optimizing, and a pack passed by value between functions of different targets is read from other
+        // registers than it was written to.
+        struct Avx2Isa {
+            template <typename Scalar> using Pack = typename PackOf<Scalar, 32>::type;
+            __attribute__((target("avx2,fma"))) static void sqrt(const float *x, float *root) { _mm256_storeu_ps(root, _mm256_sqrt_ps(_mm256_loadu_ps(x))); }
+            __attribute__((target("avx2,fma"))) static void sqrt(const double *x, double *root) { _mm256_storeu_pd(root, _mm256_sqrt_pd(_mm256_loadu_pd(x))); }
+            template <typename P> static P sqrt(P x) {
+                P root;
+                sqrt(&x[0], &root[0]);
+                return root;
+            }
+        };
+
+        struct Avx512Isa {
+            template <typename Scalar> using Pack = typename PackOf<Scalar, 64>::type;
+            // The masked forms, with every lane selected, take x for the unselected lanes : the plain ones pass an
+            // undefined register, which GCC 12 reports as used uninitialized.
+            __attribute__((target("avx512f"))) static void sqrt(const float *x, float *root) {
+                const __m512 value = _mm512_loadu_ps(x);
+                _mm512_storeu_ps(root, _mm512_mask_sqrt_ps(value, __mmask16(0xFFFF), value));
+            }
+            __attribute__((target("avx512f"))) static void sqrt(const double *x, double *root) {
+                const __m512d value = _mm512_loadu_pd(x);
+                _mm512_storeu_pd(root, _mm512_mask_sqrt_pd(value, __mmask8(0xFF), value));
+            }
+            template <typename P> static P sqrt(P x) {
+                P root;
+                sqrt(&x[0], &root[0]);
+                return root;
+            }
+        };
+#endif
+
+        // Jacobi eigenvalue algorithm on one symmetric N x N matrix per lane, a and v being stored row-major with one
+        // pack per element.  On return the diagonal of a holds the eigenvalues and the columns of v the eigenvectors.
+        //
+        // Each sweep visits the N (N - 1) / 2 pairs in round-robin order : N - 1 steps of N / 2 disjoint pairs, whose
+        // rotations are independent, so their square roots and divisions overlap instead of forming one long chain.
+        template <typename Isa, typename Scalar, int N>
+        inline void JacobiLanes(typename Isa::template Pack<Scalar> *__restrict a, typename Isa::template Pack<Scalar> *__restrict v, int num_sweeps) {
+            static_assert(N % 2 == 0, "the round-robin ordering pairs all the rows at every step");
+            using Pack = typename Isa::template Pack<Scalar>;
+            const Pack zero = Pack{} * 0, one = zero + 1, minus_one = zero - 1;
+            const Pack epsilon = zero + std::numeric_limits<Scalar>::epsilon();
+            constexpr int num_pairs = N / 2;
+
+            for (int i = 0; i < N; ++i) {
+                for (int j = 0; j < N; ++j) {
+                    v[i * N + j] = (i == j) ? one : zero;
+                }
+            }
+
+            for (int sweep = 0; sweep < num_sweeps; ++sweep) {
+                for (int step = 0; step < N - 1; ++step) {
+                    // Row N - 1 stays in place while the others turn around it.
+                    int P[num_pairs], Q[num_pairs];
+                    for (int k = 0; k < num_pairs; ++k) {
+                        int i = (k == 0) ? N - 1 : (step + k) % (N - 1);
+                        int j = (step + N - 1 - k) % (N - 1);
+                        P[k] = std::min(i, j);
+                        Q[k] = std::max(i, j);
+                    }
+
+                    // Rotations zeroing a(p,q) : t = tan(theta) is the smaller root of t^2 + 2 t cot(2 theta) - 1 = 0,
+                    // written without dividing by a(p,q) so that a(p,q) = 0 gives t = 0, the identity.
+                    Pack c[num_pairs], s[num_pairs];
+                    for (int k = 0; k < num_pairs; ++k) {
+                        const int p = P[k], q = Q[k];
+                        const Pack apq = a[p * N + q], app = a[p * N + p], aqq = a[q * N + q];
+                        const Pack tau = aqq - app;
+                        const Pack sign = (tau < zero) ? minus_one : one;
+                        const Pack denominator = sign * tau + Isa::sqrt(tau * tau + 4 * apq * apq);
+
+                        // Elements already negligible against the diagonal are dropped instead of rotated, otherwise the
+                        // converged lanes keep shrinking them into denormals, which are very slow.
+                        const Pack abs_apq = (apq < zero) ? -apq : apq;
+                        const Pack abs_app = (app < zero) ? -app : app;
+                        const Pack abs_aqq = (aqq < zero) ? -aqq : aqq;
+                        const auto rotate = (abs_apq > epsilon * (abs_app + abs_aqq)) & (denominator > zero);
+                        const Pack t = rotate ? 2 * sign * apq / denominator : zero;
+                        c[k] = 1 / Isa::sqrt(1 + t * t);
+                        s[k] = t * c[k];
+
+                        // The 2x2 blocks are only touched by their own rotation, so they are set exactly here and
+                        // skipped below.
+                        a[p * N + p] = app - t * apq;
+                        a[q * N + q] = aqq + t * apq;
+                        a[p * N + q] = zero;
+                        a[q * N + p] = zero;
+                    }
+
+                    // A <- J^T A J, J being the product of the disjoint rotations : the 2x2 block of A at the rows of
+                    // pair k and the columns of pair m is rotated by both, and mirrored to the block of m and k.
+                    for (int k = 0; k < num_pairs; ++k) {
+                        for (int m = k + 1; m < num_pairs; ++m) {
+                            const int pk = P[k], qk = Q[k], pm = P[m], qm = Q[m];
+                            const Pack b00 = a[pk * N + pm], b01 = a[pk * N + qm], b10 = a[qk * N + pm], b11 = a[qk * N + qm];
+                            const Pack r00 = c[k] * b00 - s[k] * b10, r01 = c[k] * b01 - s[k] * b11;
+                            const Pack r10 = s[k] * b00 + c[k] * b10, r11 = s[k] * b01 + c[k] * b11;
+                            a[pk * N + pm] = a[pm * N + pk] = c[m] * r00 - s[m] * r01;
+                            a[pk * N + qm] = a[qm * N + pk] = s[m] * r00 + c[m] * r01;
+                            a[qk * N + pm] = a[pm * N + qk] = c[m] * r10 - s[m] * r11;
+                            a[qk * N + qm] = a[qm * N + qk] = s[m] * r10 + c[m] * r11;
+                        }
+                    }
+                    for (int k = 0; k < num_pairs; ++k) {
+                        const int p = P[k], q = Q[k];
+                        for (int r = 0; r < N; ++r) {
+                            const Pack vrp = v[r * N + p], vrq = v[r * N + q];
+                            v[r * N + p] = c[k] * vrp - s[k] * vrq;
+                            v[r * N + q] = s[k] * vrp + c[k] * vrq;
+                        }
+                    }
+                }
+            }
+        }
+
+        template <typename Scalar, int N>
+        void JacobiScalar(Scalar *a, Scalar *v, int num_sweeps) {
+            JacobiLanes<ScalarIsa, Scalar, N>(a, v, num_sweeps);
+        }
+
+#ifdef ROOTBA_X86_SIMD
+        template <typename Scalar, int N>
+        __attribute__((target("avx2,fma"), flatten)) void JacobiAvx2(Scalar *a, Scalar *v, int num_sweeps) {
+            using Pack = Avx2Isa::Pack<Scalar>;
+            JacobiLanes<Avx2Isa, Scalar, N>(reinterpret_cast<Pack *>(a), reinterpret_cast<Pack *>(v), num_sweeps);
+        }
+
+        template <typename Scalar, int N>
+        __attribute__((target("avx512f"), flatten)) void JacobiAvx512(Scalar *a, Scalar *v, int num_sweeps) {
+            using Pack = Avx512Isa::Pack<Scalar>;
+            JacobiLanes<Avx512Isa, Scalar, N>(reinterpret_cast<Pack *>(a), reinterpret_cast<Pack *>(v), num_sweeps);
+        }
+#endif
+
+        // Copies element (i, j) of matrices[l] to packed[(i * Cols + j) * Lanes + l], the lanes from count on being
+        // filled with padding.  Elements are read through data(), without the bound checks of operator().
+        template <int Lanes, typename Matrix>
+        void Interleave(const Matrix *matrices, int count, const Matrix &padding, typename Matrix::Scalar *packed) {
+            static_assert(!Matrix::IsRowMajor, "elements are read in column-major order");
+            constexpr int Rows = Matrix::RowsAtCompileTime, Cols = Matrix::ColsAtCompileTime;
+            for (int l = 0; l < Lanes; ++l) {
+                const typename Matrix::Scalar *m = (l < count) ? matrices[l].data() : padding.data();
+                for (int j = 0; j < Cols; ++j) {
+                    for (int i = 0; i < Rows; ++i) {
+                        packed[(i * Cols + j) * Lanes + l] = m[j * Rows + i];
+                    }
+                }
+            }
+        }
+
+        template <int Lanes, typename Matrix>
+        void Deinterleave(const typename Matrix::Scalar *packed, int count, Matrix *matrices) {
+            static_assert(!Matrix::IsRowMajor, "elements are written in column-major order");
+            constexpr int Rows = Matrix::RowsAtCompileTime, Cols = Matrix::ColsAtCompileTime;
+            for (int l = 0; l < count; ++l) {
+                typename Matrix::Scalar *m = matrices[l].data();
+                for (int j = 0; j < Cols; ++j) {
+                    for (int i = 0; i < Rows; ++i) {
+                        m[j * Rows + i] = packed[(i * Cols + j) * Lanes + l];
+                    }
+                }
+            }
+        }
+
+        // Interleaves Lanes matrices at a time into the layout of JacobiLanes, runs kernel on them and
+        // deinterleaves the results.  The lanes left over by the last group hold identities.
+        template <typename Scalar, int N, int Lanes>
+        void SymmetricEigenLanes(const Eigen::Matrix<Scalar, N, N> *matrices,
+                                 size_t count,
+                                 Eigen::Matrix<Scalar, N, 1> *eigenvalues,
+                                 Eigen::Matrix<Scalar, N, N> *eigenvectors,
+                                 int num_sweeps,
+                                 void (*kernel)(Scalar *, Scalar *, int)) {
+            alignas(64) Scalar a[N * N * Lanes];
+            alignas(64) Scalar v[N * N * Lanes];
+            const Eigen::Matrix<Scalar, N, N> identity = Eigen::Matrix<Scalar, N, N>::Identity();
+
+            for (size_t first = 0; first < count; first += Lanes) {
+                const int num_lanes = static_cast<int>(std::min<size_t>(Lanes, count - first));
+                Interleave<Lanes>(matrices + first, num_lanes, identity, a);
+                kernel(a, v, num_sweeps);
+                Deinterleave<Lanes>(v, num_lanes, eigenvectors + first);
+                for (int l = 0; l < num_lanes; ++l) {
+                    for (int i = 0; i < N; ++i) {
+                        eigenvalues[first + l](i) = a[(i * N + i) * Lanes + l];
+                    }
+                }
+            }
+        }
+
+        // The RQ decomposition of KRt_From_P on one projection per lane, all the matrices being stored row-major with
+        // one pack per element.  The Givens rotations, sign fixes and the identity used when an element is already
+        // zero are the ones of KRt_From_P, as selects instead of branches.
+        template <typename Isa, typename Scalar>
+        inline void KRtLanes(const typename Isa::template Pack<Scalar> *__restrict P,
+                             typename Isa::template Pack<Scalar> *__restrict K,
+                             typename Isa::template Pack<Scalar> *__restrict R,
+                             typename Isa::template Pack<Scalar> *__restrict t) {
+            using Pack = typename Isa::template Pack<Scalar>;
+            const Pack zero = Pack{} * 0, one = zero + 1, minus_one = zero - 1;
+
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    K[i * 3 + j] = P[i * 4 + j];
+                    R[i * 3 + j] = (i == j) ? one : zero;
+                }
+            }
+
+            // K <- K G and R <- G^T R for the rotation G of columns (rows of R) i and j taking K(row, i) to zero, with
+            // the same (c, s) as KRt_From_P up to normalization.
+            auto rotate = [&](int row, int i, int j, const Pack &c_unnormalized, const Pack &s_unnormalized) {
+                const auto nonzero = (K[row * 3 + i] != zero);
+                const Pack inverse_norm = 1 / Isa::sqrt(nonzero ? c_unnormalized * c_unnormalized + s_unnormalized * s_unnormalized : one);
+                const Pack c = nonzero ? c_unnormalized * inverse_norm : one;
+                const Pack s = nonzero ? s_unnormalized * inverse_norm : zero;
+                for (int r = 0; r < 3; ++r) {
+                    const Pack ki = K[r * 3 + i], kj = K[r * 3 + j];
+                    K[r * 3 + i] = c * ki + s * kj;
+                    K[r * 3 + j] = c * kj - s * ki;
+                    const Pack ri = R[i * 3 + r], rj = R[j * 3 + r];
+                    R[i * 3 + r] = c * ri + s * rj;
+                    R[j * 3 + r] = c * rj - s * ri;
+                }
+                K[row * 3 + i] = zero;
+            };
+            rotate(2, 1, 2, -K[8], K[7]);  // K(2,1)
+            rotate(2, 0, 2, K[8], -K[6]);  // K(2,0)
+            rotate(1, 0, 1, -K[4], K[3]);  // K(1,0)
+
+            // Positive diagonal : flip K(2,2) with the whole of K and R, then the other two with their column of K
+            // and row of R.
+            const Pack sign2 = (K[8] < zero) ? minus_one : one;
+            for (int i = 0; i < 9; ++i) {
+                K[i] *= sign2;
+                R[i] *= sign2;
+            }
+            for (int d = 1; d >= 0; --d) {
+                const Pack sign = (K[d * 3 + d] < zero) ? minus_one : one;
+                for (int r = 0; r < 3; ++r) {
+                    K[r * 3 + d] *= sign;
+                    R[d * 3 + r] *= sign;
+                }
+            }
+
+            // t = K^-1 p by back substitution, K being upper triangular.
+            t[2] = P[11] / K[8];
+            t[1] = (P[7] - K[5] * t[2]) / K[4];
+            t[0] = (P[3] - K[1] * t[1] - K[2] * t[2]) / K[0];
+
+            // Scale K so that K(2,2) = 1.
+            const Pack inverse_k22 = 1 / K[8];
+            for (int i = 0; i < 9; ++i) {
+                K[i] *= inverse_k22;
+            }
+        }
+
+        template <typename Scalar>
+        void KRtScalar(const Scalar *P, Scalar *K, Scalar *R, Scalar *t) {
+            KRtLanes<ScalarIsa, Scalar>(P, K, R, t);
+        }
+
+#ifdef ROOTBA_X86_SIMD
+        template <typename Scalar>
+        __attribute__((target("avx2,fma"), flatten)) void KRtAvx2(const Scalar *P, Scalar *K, Scalar *R, Scalar *t) {
+            using Pack = Avx2Isa::Pack<Scalar>;
+            KRtLanes<Avx2Isa, Scalar>(reinterpret_cast<const Pack *>(P), reinterpret_cast<Pack *>(K), reinterpret_cast<Pack *>(R),
+                                      reinterpret_cast<Pack *>(t));
+        }
+
+        template <typename Scalar>
+        __attribute__((target("avx512f"), flatten)) void KRtAvx512(const Scalar *P, Scalar *K, Scalar *R, Scalar *t) {
+            using Pack = Avx512Isa::Pack<Scalar>;
+            KRtLanes<Avx512Isa, Scalar>(reinterpret_cast<const Pack *>(P), reinterpret_cast<Pack *>(K), reinterpret_cast<Pack *>(R),
+                                        reinterpret_cast<Pack *>(t));
+        }
+#endif
+
+        // Converts Lanes projections at a time to the SoA layout of KRtLanes.  The lanes left over by the last
+        // group hold [I | 0].
+        template <typename Scalar, int Lanes>
+        void KRtLanesBatch(const Eigen::Matrix<Scalar, 3, 4> *P,
+                           size_t count,
+                           Eigen::Matrix<Scalar, 3, 3> *K,
+                           Eigen::Matrix<Scalar, 3, 3> *R,
+                           Eigen::Matrix<Scalar, 3, 1> *t,
+                           void (*kernel)(const Scalar *, Scalar *, Scalar *, Scalar *)) {
+            alignas(64) Scalar P_lanes[12 * Lanes];
+            alignas(64) Scalar K_lanes[9 * Lanes];
+            alignas(64) Scalar R_lanes[9 * Lanes];
+            alignas(64) Scalar t_lanes[3 * Lanes];
+            const Eigen::Matrix<Scalar, 3, 4> padding = Eigen::Matrix<Scalar, 3, 4>::Identity();
+
+            for (size_t first = 0; first < count; first += Lanes) {
+                const int num_lanes = static_cast<int>(std::min<size_t>(Lanes, count - first));
+                Interleave<Lanes>(P + first, num_lanes, padding, P_lanes);
+                kernel(P_lanes, K_lanes, R_lanes, t_lanes);
+                Deinterleave<Lanes>(K_lanes, num_lanes, K + first);
+                Deinterleave<Lanes>(R_lanes, num_lanes, R + first);
+                Deinterleave<Lanes>(t_lanes, num_lanes, t + first);
+            }
+        }
+
+        // The closed form upper Cholesky factorization of UpperCholesky3 on one matrix per lane, stored row-major with
+        // one pack per element.  positive_definite is 1 or 0 in each lane, the K of the lanes at 0 being NaN.
+        template <typename Isa, typename Scalar>
+        inline void UpperCholeskyLanes(const typename Isa::template Pack<Scalar> *__restrict KKt,
+                                       typename Isa::template Pack<Scalar> *__restrict K,
+                                       typename Isa::template Pack<Scalar> *__restrict positive_definite) {
+            using Pack = typename Isa::template Pack<Scalar>;
+            const Pack zero = Pack{} * 0, one = zero + 1, nan = zero + std::numeric_limits<Scalar>::quiet_NaN();
+
+            // Square roots and divisions are taken on 1 in the lanes that already failed, so no NaN or infinity is
+            // produced before the final select.
+            const Pack d2 = KKt[8];
+            const auto ok2 = (d2 > zero);
+            const Pack k22 = Isa::sqrt(ok2 ? d2 : one);
+            const Pack k12 = KKt[5] / k22, k02 = KKt[2] / k22;
+
+            const Pack d1 = KKt[4] - k12 * k12;
+            const auto ok1 = ok2 & (d1 > zero);
+            const Pack k11 = Isa::sqrt(ok1 ? d1 : one);
+            const Pack k01 = (KKt[1] - k02 * k12) / k11;
+
+            const Pack d0 = KKt[0] - k01 * k01 - k02 * k02;
+            const auto ok = ok1 & (d0 > zero);
+            const Pack k00 = Isa::sqrt(ok ? d0 : one);
+
+            K[0] = ok ? k00 : nan;
+            K[1] = ok ? k01 : nan;
+            K[2] = ok ? k02 : nan;
+            K[3] = ok ? zero : nan;
+            K[4] = ok ? k11 : nan;
+            K[5] = ok ? k12 : nan;
+            K[6] = ok ? zero : nan;
+            K[7] = ok ? zero : nan;
+            K[8] = ok ? k22 : nan;
+            *positive_definite = ok ? one : zero;
+        }
+
+        template <typename Scalar>
+        void UpperCholeskyScalar(const Scalar *KKt, Scalar *K, Scalar *positive_definite) {
+            UpperCholeskyLanes<ScalarIsa, Scalar>(KKt, K, positive_definite);
+        }
+
+#ifdef ROOTBA_X86_SIMD
+        template <typename Scalar>
+        __attribute__((target("avx2,fma"), flatten)) void UpperCholeskyAvx2(const Scalar *KKt, Scalar *K, Scalar *positive_definite) {
+            using Pack = Avx2Isa::Pack<Scalar>;
+            UpperCholeskyLanes<Avx2Isa, Scalar>(reinterpret_cast<const Pack *>(KKt), reinterpret_cast<Pack *>(K),
+                                                reinterpret_cast<Pack *>(positive_definite));
+        }
+
+        template <typename Scalar>
+        __attribute__((target("avx512f"), flatten)) void UpperCholeskyAvx512(const Scalar *KKt, Scalar *K, Scalar *positive_definite) {
+            using Pack = Avx512Isa::Pack<Scalar>;
+            UpperCholeskyLanes<Avx512Isa, Scalar>(reinterpret_cast<const Pack *>(KKt), reinterpret_cast<Pack *>(K),
+                                                  reinterpret_cast<Pack *>(positive_definite));
+        }
+#endif
+
+        // Converts Lanes matrices at a time to the layout of UpperCholeskyLanes.  The lanes left over by the last
+        // group hold identities.
+        template <typename Scalar, int Lanes>
+        void UpperCholeskyLanesBatch(const Eigen::Matrix<Scalar, 3, 3> *KKt,
+                                     size_t count,
+                                     Eigen::Matrix<Scalar, 3, 3> *K,
+                                     bool *positive_definite,
+                                     void (*kernel)(const Scalar *, Scalar *, Scalar *)) {
+            alignas(64) Scalar KKt_lanes[9 * Lanes];
+            alignas(64) Scalar K_lanes[9 * Lanes];
+            alignas(64) Scalar positive_definite_lanes[Lanes];
+            const Eigen::Matrix<Scalar, 3, 3> identity = Eigen::Matrix<Scalar, 3, 3>::Identity();
+
+            for (size_t first = 0; first < count; first += Lanes) {
+                const int num_lanes = static_cast<int>(std::min<size_t>(Lanes, count - first));
+                Interleave<Lanes>(KKt + first, num_lanes, identity, KKt_lanes);
+                kernel(KKt_lanes, K_lanes, positive_definite_lanes);
+                Deinterleave<Lanes>(K_lanes, num_lanes, K + first);
+                if (positive_definite) {
+                    for (int l = 0; l < num_lanes; ++l) {
+                        positive_definite[first + l] = (positive_definite_lanes[l] != 0);
+                    }
+                }
+            }
+        }
+#pragma GCC diagnostic pop
+
+        std::atomic<int> active_simd_level(-1);
+    }
+
+    SimdLevel SupportedSimdLevel() {
+#ifdef ROOTBA_X86_SIMD
+        static const SimdLevel level = [] {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+            return SimdLevel::Scalar;
+        }();
+        return level;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    SimdLevel ActiveSimdLevel() {
+        int level = active_simd_level.load(std::memory_order_relaxed);
+        return level < 0 ? SupportedSimdLevel() : static_cast<SimdLevel>(level);
+    }
+
+    void SetSimdLevel(SimdLevel level) {
+        level = std::min(level, SupportedSimdLevel());
+        active_simd_level.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    const char *SimdLevelName(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::AVX512: return "AVX-512";
+            case SimdLevel::AVX2: return "AVX2";
+            default: return "scalar";
+        }
+    }
+
+    template <typename Scalar, int N>
+    void SymmetricEigenBatch(const Eigen::Matrix<Scalar, N, N> *matrices,
+                             size_t count,
+                             Eigen::Matrix<Scalar, N, 1> *eigenvalues,
+                             Eigen::Matrix<Scalar, N, N> *eigenvectors,
+                             int num_sweeps) {
+        switch (ActiveSimdLevel()) {
+#ifdef ROOTBA_X86_SIMD
+            case SimdLevel::AVX512:
+                SymmetricEigenLanes<Scalar, N, 64 / sizeof(Scalar)>(matrices, count, eigenvalues, eigenvectors, num_sweeps, &JacobiAvx512<Scalar, N>);
+                break;
+            case SimdLevel::AVX2:
+                SymmetricEigenLanes<Scalar, N, 32 / sizeof(Scalar)>(matrices, count, eigenvalues, eigenvectors, num_sweeps, &JacobiAvx2<Scalar, N>);
+                break;
+#endif
+            default:
+                SymmetricEigenLanes<Scalar, N, 1>(matrices, count, eigenvalues, eigenvectors, num_sweeps, &JacobiScalar<Scalar, N>);
+                break;
+        }
+    }
+
+    template <typename Scalar>
+    void KRt_From_P_Batch(const Eigen::Matrix<Scalar, 3, 4> *P,
+                          size_t count,
+                          Eigen::Matrix<Scalar, 3, 3> *K,
+                          Eigen::Matrix<Scalar, 3, 3> *R,
+                          Eigen::Matrix<Scalar, 3, 1> *t) {
+        switch (ActiveSimdLevel()) {
+#ifdef ROOTBA_X86_SIMD
+            case SimdLevel::AVX512:
+                KRtLanesBatch<Scalar, 64 / sizeof(Scalar)>(P, count, K, R, t, &KRtAvx512<Scalar>);
+                break;
+            case SimdLevel::AVX2:
+                KRtLanesBatch<Scalar, 32 / sizeof(Scalar)>(P, count, K, R, t, &KRtAvx2<Scalar>);
+                break;
+#endif
+            default:
+                KRtLanesBatch<Scalar, 1>(P, count, K, R, t, &KRtScalar<Scalar>);
+                break;
+        }
+    }
+
+    template <typename Scalar>
+    void K_From_ImageOfTheDualAbsoluteQuadric_Batch(const Eigen::Matrix<Scalar, 3, 3> *KKt,
+                                                    size_t count,
+                                                    Eigen::Matrix<Scalar, 3, 3> *K,
+                                                    bool *positive_definite) {
+        switch (ActiveSimdLevel()) {
+#ifdef ROOTBA_X86_SIMD
+            case SimdLevel::AVX512:
+                UpperCholeskyLanesBatch<Scalar, 64 / sizeof(Scalar)>(KKt, count, K, positive_definite, &UpperCholeskyAvx512<Scalar>);
+                break;
+            case SimdLevel::AVX2:
+                UpperCholeskyLanesBatch<Scalar, 32 / sizeof(Scalar)>(KKt, count, K, positive_definite, &UpperCholeskyAvx2<Scalar>);
+                break;
+#endif
+            default:
+                UpperCholeskyLanesBatch<Scalar, 1>(KKt, count, K, positive_definite, &UpperCholeskyScalar<Scalar>);
+                break;
+        }
+    }
+
+#ifdef ROOTBA_INSTANTIATIONS_FLOAT
+    template void K_From_ImageOfTheDualAbsoluteQuadric_Batch(const Eigen::Matrix<float, 3, 3> *KKt, size_t count, Eigen::Matrix<float, 3, 3> *K,
+                                                             bool *positive_definite);
+    template void KRt_From_P_Batch(const Eigen::Matrix<float, 3, 4> *P, size_t count, Eigen::Matrix<float, 3, 3> *K,
+                                   Eigen::Matrix<float, 3, 3> *R, Eigen::Matrix<float, 3, 1> *t);
+    template void SymmetricEigenBatch(const Eigen::Matrix<float, 4, 4> *matrices, size_t count, Eigen::Matrix<float, 4, 1> *eigenvalues,
+                                      Eigen::Matrix<float, 4, 4> *eigenvectors, int num_sweeps);
+    template void SymmetricEigenBatch(const Eigen::Matrix<float, 10, 10> *matrices, size_t count, Eigen::Matrix<float, 10, 1> *eigenvalues,
+                                      Eigen::Matrix<float, 10, 10> *eigenvectors, int num_sweeps);
+#endif
+
+#ifdef ROOTBA_INSTANTIATIONS_DOUBLE
+    template void K_From_ImageOfTheDualAbsoluteQuadric_Batch(const Eigen::Matrix<double, 3, 3> *KKt, size_t count, Eigen::Matrix<double, 3, 3> *K,
+                                                             bool *positive_definite);
+    template void KRt_From_P_Batch(const Eigen::Matrix<double, 3, 4> *P, size_t count, Eigen::Matrix<double, 3, 3> *K,
+                                   Eigen::Matrix<double, 3, 3> *R, Eigen::Matrix<double, 3, 1> *t);
+    template void SymmetricEigenBatch(const Eigen::Matrix<double, 4, 4> *matrices, size_t count, Eigen::Matrix<double, 4, 1> *eigenvalues,
+                                      Eigen::Matrix<double, 4, 4> *eigenvectors, int num_sweeps);
+    template void SymmetricEigenBatch(const Eigen::Matrix<double, 10, 10> *matrices, size_t count, Eigen::Matrix<double, 10, 1> *eigenvalues,
+                                      Eigen::Matrix<double, 10, 10> *eigenvectors, int num_sweeps);
+#endif
+}
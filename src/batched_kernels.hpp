@@ -0,0 +1,88 @@
+// Small dense kernels run on many independent problems at once, several problems per SIMD register.
+
+#pragma once
+
+#include <Eigen/Core>
+#include <cstddef>
+
+namespace rootba_povar {
+
+    // Instruction sets the batched kernels are compiled for, picked at runtime from what the CPU supports.
+    enum class SimdLevel { Scalar, AVX2, AVX512 };
+
+    /** \brief The best instruction set supported by this CPU. */
+    SimdLevel SupportedSimdLevel();
+
+    /** \brief The instruction set used by the batched kernels, SupportedSimdLevel() by default. */
+    SimdLevel ActiveSimdLevel();
+
+    /** \brief Forces the instruction set of the batched kernels, for testing and benchmarks.
+     *
+     *  Levels above SupportedSimdLevel() are lowered to it.
+     */
+    void SetSimdLevel(SimdLevel level);
+
+    const char *SimdLevelName(SimdLevel level);
+
+    // Number of Jacobi sweeps after which the off-diagonal part of a symmetric matrix of size N is negligible in
+    // double precision : 6 are enough for the absolute quadric and 8 for the normal equations of the constraints.
+    constexpr int DefaultJacobiSweeps(int N) { return N <= 4 ? 6 : 8; }
+
+    /** \brief Eigen decomposition of many small symmetric matrices.
+     *
+     *  \param matrices count symmetric matrices.
+     *  \param count Number of matrices.
+     *  \param eigenvalues The eigenvalues of each matrix, unsorted.
+     *  \param eigenvectors The corresponding eigenvectors, as columns.
+     *  \param num_sweeps Number of Jacobi sweeps.
+     *
+     *  Matrices are packed into the lanes of SIMD registers (4 doubles or 8 floats
+     *  with AVX2, twice as many with AVX-512) and every lane runs the same fixed
+     *  number of sweeps, with no data-dependent branches.  Rotations that would
+     *  be skipped are applied as identities instead.  N must be even.
+     */
+    template <typename Scalar, int N>
+    void SymmetricEigenBatch(const Eigen::Matrix<Scalar, N, N> *matrices,
+                             size_t count,
+                             Eigen::Matrix<Scalar, N, 1> *eigenvalues,
+                             Eigen::Matrix<Scalar, N, N> *eigenvectors,
+                             int num_sweeps = DefaultJacobiSweeps(N));
+
+    /** \brief Decomposes many projections into K [R | t], as KRt_From_P does.
+     *
+     *  \param P count projection matrices.
+     *  \param count Number of projections.
+     *  \param K The calibrations, upper triangular with a positive diagonal and K(2,2) = 1.
+     *  \param R The rotations.
+     *  \param t The translations.
+     *
+     *  Projections are converted to a structure of arrays, one projection per
+     *  SIMD lane.  The Givens rotations and sign fixes of KRt_From_P become
+     *  selects, and t is obtained by back substitution in K instead of
+     *  inverting it.  KRt_From_P stays the reference implementation.
+     */
+    template <typename Scalar>
+    void KRt_From_P_Batch(const Eigen::Matrix<Scalar, 3, 4> *P,
+                          size_t count,
+                          Eigen::Matrix<Scalar, 3, 3> *K,
+                          Eigen::Matrix<Scalar, 3, 3> *R,
+                          Eigen::Matrix<Scalar, 3, 1> *t);
+
+    /** \brief Recovers many calibrations from their image of the dual absolute
+     *         quadric, as K_From_ImageOfTheDualAbsoluteQuadric does.
+     *
+     *  \param KKt count symmetric matrices.
+     *  \param count Number of matrices.
+     *  \param K The upper triangular matrices with a positive diagonal such that
+     *         K K^T = KKt, NaN where KKt is not positive definite.
+     *  \param positive_definite If not null, whether each KKt is positive
+     *         definite.
+     *
+     *  Runs the closed form of UpperCholesky3 on one matrix per SIMD lane.
+     */
+    template <typename Scalar>
+    void K_From_ImageOfTheDualAbsoluteQuadric_Batch(const Eigen::Matrix<Scalar, 3, 3> *KKt,
+                                                    size_t count,
+                                                    Eigen::Matrix<Scalar, 3, 3> *K,
+                                                    bool *positive_definite);
+}
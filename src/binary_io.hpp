@@ -0,0 +1,79 @@
+// Raw binary reading and writing of the accumulators of the sweeps, for the partial files of sharded runs.  The files
+// are read back on machines of the same endianness.
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rootba_povar {
+
+    template <typename T>
+    void WriteBinary(std::ostream &out, const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values are written as they are.");
+        out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void WriteBinary(std::ostream &out, const std::vector<T> &values) {
+        WriteBinary(out, uint64_t(values.size()));
+        for (const T &value : values) WriteBinary(out, value);
+    }
+
+    inline void WriteBinary(std::ostream &out, const std::string &text) {
+        WriteBinary(out, uint64_t(text.size()));
+        out.write(text.data(), text.size());
+    }
+
+    /** \brief The number of bytes left to read in in, the largest uint64_t if
+     *         in cannot tell.
+     */
+    inline uint64_t RemainingBytes(std::istream &in) {
+        const std::istream::pos_type position = in.tellg();
+        if (position == std::istream::pos_type(-1)) return UINT64_MAX;
+        in.seekg(0, std::ios::end);
+        const std::istream::pos_type end = in.tellg();
+        in.seekg(position);
+        return end == std::istream::pos_type(-1) ? UINT64_MAX : uint64_t(end - position);
+    }
+
+    /** \brief Reads a value written by WriteBinary.  Errors leave in the stream
+     *         state, so that a whole record can be read before checking it.
+     *         The sizes of vectors and strings are checked against the bytes
+     *         left, so that a corrupt size fails instead of allocating it.
+     */
+    template <typename T>
+    void ReadBinary(std::istream &in, T *value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values are read as they are.");
+        in.read(reinterpret_cast<char *>(value), sizeof(T));
+    }
+
+    template <typename T>
+    void ReadBinary(std::istream &in, std::vector<T> *values) {
+        uint64_t size = 0;
+        ReadBinary(in, &size);
+        if (!in) return;
+        if (size > RemainingBytes(in) / sizeof(T)) {
+            in.setstate(std::ios::failbit);
+            return;
+        }
+        values->resize(size);
+        for (T &value : *values) ReadBinary(in, &value);
+    }
+
+    inline void ReadBinary(std::istream &in, std::string *text) {
+        uint64_t size = 0;
+        ReadBinary(in, &size);
+        if (!in) return;
+        if (size > RemainingBytes(in)) {
+            in.setstate(std::ios::failbit);
+            return;
+        }
+        text->resize(size);
+        in.read(&(*text)[0], size);
+    }
+}
@@ -0,0 +1,131 @@
+// Checkpoints of long sweeps : the totals of the points already run, so that a sweep relaunched after dying partway
+// through continues from them and writes the same file as an uninterrupted run.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "binary_io.hpp"
+
+namespace rootba_povar {
+
+    /** \brief The checkpoint type of the sweeps run without one, so that their
+     *         accumulators need no save and load.
+     */
+    struct NoCheckpoint {
+        bool contains(size_t) const { return false; }
+        template <typename Accumulator>
+        bool take(size_t, Accumulator *, size_t *) { return false; }
+        template <typename Accumulator>
+        void save(size_t, const Accumulator &, size_t) {}
+    };
+
+    /** \brief The checkpoint file of a sweep, holding the total and the number
+     *         of reconstructions of every point run so far.
+     *
+     *  The random streams of a reconstruction only depend on (seed, point,
+     *  reconstruction), so these totals are the whole state of the sweep : a
+     *  relaunched sweep takes the totals of the points it finds here instead of
+     *  running them again.  Every point is appended and flushed once it is
+     *  over, a record torn by a crash being dropped when the file is reopened.
+     */
+    template <typename Accumulator>
+    class SweepCheckpoint {
+    public:
+        /** \brief Opens the checkpoint at path, resuming the points it holds if
+         *         it was written by a sweep with the same seed.
+         *
+         *  \param empty An accumulator of the records, whose load(std::istream &)
+         *         member reads one written by its save(std::ostream &).
+         */
+        SweepCheckpoint(const std::string &path, uint64_t seed, const Accumulator &empty) : path_(path) {
+            std::streamoff valid_size = 0;
+            {
+                std::ifstream in(path, std::ios::binary);
+                char magic[sizeof(kMagic)] = {};
+                uint64_t saved_seed = 0;
+                if (in) {
+                    in.read(magic, sizeof(magic));
+                    ReadBinary(in, &saved_seed);
+                }
+                if (in && std::equal(magic, magic + sizeof(magic), kMagic) && saved_seed == seed) {
+                    valid_size = in.tellg();
+                    while (in.peek() != std::ifstream::traits_type::eof()) {
+                        uint64_t point = 0, num_reconstructions = 0;
+                        Record record{empty, 0};
+                        ReadBinary(in, &point);
+                        ReadBinary(in, &num_reconstructions);
+                        record.total.load(in);
+                        if (!in) break;
+                        record.num_reconstructions = num_reconstructions;
+                        resumed_.insert_or_assign(point, record);
+                        valid_size = in.tellg();
+                    }
+                } else if (in) {
+                    std::cerr << "Ignoring the checkpoint " << path << " of another sweep" << std::endl;
+                }
+            }
+
+            if (valid_size > 0) {
+                std::error_code error;
+                std::filesystem::resize_file(path, valid_size, error);
+                out_.open(path, std::ios::binary | std::ios::app);
+                if (!resumed_.empty()) std::cout << "Resuming " << resumed_.size() << " points from " << path << std::endl;
+            } else {
+                out_.open(path, std::ios::binary);
+                out_.write(kMagic, sizeof(kMagic));
+                WriteBinary(out_, seed);
+                out_.flush();
+            }
+            if (!out_) std::cerr << "Errors opening the checkpoint " << path << ", the sweep will not be resumable" << std::endl;
+        }
+
+        size_t num_resumed() const { return resumed_.size(); }
+
+        bool contains(size_t point) const { return resumed_.count(point) > 0; }
+
+        /** \brief The total of a resumed point, released from the checkpoint.  False if it was not run. */
+        bool take(size_t point, Accumulator *total, size_t *num_reconstructions) {
+            auto record = resumed_.find(point);
+            if (record == resumed_.end()) return false;
+            *total = record->second.total;
+            *num_reconstructions = record->second.num_reconstructions;
+            resumed_.erase(record);
+            return true;
+        }
+
+        /** \brief Appends the total of a point that is over. */
+        void save(size_t point, const Accumulator &total, size_t num_reconstructions) {
+            WriteBinary(out_, uint64_t(point));
+            WriteBinary(out_, uint64_t(num_reconstructions));
+            total.save(out_);
+            out_.flush();
+        }
+
+        /** \brief Deletes the checkpoint, once the sweep has written its file. */
+        void remove() {
+            out_.close();
+            std::remove(path_.c_str());
+        }
+
+    private:
+        static constexpr char kMagic[8] = {'A', 'C', 'C', 'H', 'E', 'C', 'K', '1'};
+
+        struct Record {
+            Accumulator total;
+            size_t num_reconstructions;
+        };
+
+        std::string path_;
+        std::map<size_t, Record> resumed_;
+        std::ofstream out_;
+    };
+}
@@ -0,0 +1,526 @@
+#include "experiments.hpp"
+#include "testing_functions.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+
+namespace rootba_povar {
+
+    namespace {
+        std::string Trim(const std::string &text) {
+            const size_t first = text.find_first_not_of(" \t\r");
+            if (first == std::string::npos) return "";
+            const size_t last = text.find_last_not_of(" \t\r");
+            return text.substr(first, last - first + 1);
+        }
+
+        std::string LineSource(const std::string &source, size_t line) {
+            std::stringstream line_source;
+            line_source << source << ":" << line;
+            return line_source.str();
+        }
+
+        // Reads one line of a configuration into experiments and options, false with a message on a syntax error.
+        bool ParseConfigLine(const std::string &raw_line, const std::string &source, bool *in_section,
+                             std::vector<ExperimentConfig> *experiments, SchedulerOptions *options) {
+            const std::string line = Trim(raw_line.substr(0, raw_line.find('#')));
+            if (line.empty()) return true;
+
+            if (line.front() == '[') {
+                if (line.back() != ']' || line.size() < 3) {
+                    std::cerr << source << " : a section is written [experiment]" << std::endl;
+                    return false;
+                }
+                ExperimentConfig experiment;
+                experiment.name = Trim(line.substr(1, line.size() - 2));
+                experiment.parameters = options->defaults;
+                experiment.source = source;
+                experiments->push_back(experiment);
+                *in_section = true;
+                return true;
+            }
+
+            const size_t equal = line.find('=');
+            if (equal == std::string::npos) {
+                std::cerr << source << " : expected key = value or [experiment], got " << line << std::endl;
+                return false;
+            }
+            const std::string key = Trim(line.substr(0, equal)), value = Trim(line.substr(equal + 1));
+            if (key.empty() || value.empty()) {
+                std::cerr << source << " : expected key = value, got " << line << std::endl;
+                return false;
+            }
+            if (*in_section) {
+                experiments->back().parameters[key] = value;
+                experiments->back().own_parameters[key] = value;
+                return true;
+            }
+            if (key == "concurrent_experiments" || key == "progress_interval") {
+                std::istringstream in(value);
+                if (key == "concurrent_experiments") in >> options->concurrent_experiments;
+                else in >> options->progress_interval;
+                if (!in || !(in >> std::ws).eof() || value.front() == '-') {
+                    std::cerr << source << " : cannot read " << key << " from " << value << std::endl;
+                    return false;
+                }
+                return true;
+            }
+            options->defaults[key] = value;
+            return true;
+        }
+
+        // The parameters of an experiment, read as the experiment asks for them.  Errors are gathered for check().
+        class Parameters {
+        public:
+            explicit Parameters(const ExperimentConfig &experiment) : experiment_(experiment) {}
+
+            template <typename T>
+            T get(const std::string &key, T default_value) {
+                used_.insert(key);
+                auto parameter = experiment_.parameters.find(key);
+                if (parameter == experiment_.parameters.end()) return default_value;
+                T value = default_value;
+                if (!parse(parameter->second, &value)) {
+                    errors_.push_back("cannot read " + key + " from " + parameter->second);
+                }
+                values_[key] = canonical(value);
+                return value;
+            }
+
+            template <typename T>
+            T required(const std::string &key) {
+                if (experiment_.parameters.count(key) == 0) errors_.push_back("missing " + key);
+                return get(key, T());
+            }
+
+            const std::set<std::string> &used() const { return used_; }
+
+            // The name and the values read, the same for parameters written differently, as translation_range=1 and 1.0.
+            std::string signature() const {
+                std::string signature = experiment_.name;
+                for (const auto &value : values_) signature += " " + value.first + "=" + value.second;
+                return signature;
+            }
+
+            // The result file written by the experiment, empty for the tests.
+            void set_output(const std::string &path) { output_ = path; }
+            const std::string &output() const { return output_; }
+
+            /** \brief False, with a message, if a value could not be read or a
+             *         parameter of the section is not one of the experiment.
+             */
+            bool check() {
+                for (const auto &parameter : experiment_.own_parameters) {
+                    if (used_.count(parameter.first) == 0) errors_.push_back("unknown parameter " + parameter.first);
+                }
+                for (const std::string &error : errors_) {
+                    std::cerr << experiment_.source << " [" << experiment_.name << "] : " << error << std::endl;
+                }
+                return errors_.empty();
+            }
+
+        private:
+            static bool parse(const std::string &text, bool *value) {
+                if (text == "1" || text == "true" || text == "yes") *value = true;
+                else if (text == "0" || text == "false" || text == "no") *value = false;
+                else return false;
+                return true;
+            }
+
+            static bool parse(const std::string &text, RotationSampling *value) {
+                if (text == "euler") *value = RotationSampling::EulerAngles;
+                else if (text == "uniform") *value = RotationSampling::UniformQuaternions;
+                else return false;
+                return true;
+            }
+
+            static bool parse(const std::string &text, ResultFormat *value) {
+                if (text == "text") *value = ResultFormat::Text;
+                else if (text == "columnar") *value = ResultFormat::Columnar;
+                else return false;
+                return true;
+            }
+
+            template <typename T>
+            static std::string canonical(T value) {
+                std::ostringstream text;
+                text.precision(17);
+                if constexpr (std::is_enum<T>::value) text << static_cast<int>(value);
+                else text << value;
+                return text.str();
+            }
+
+            template <typename T>
+            static bool parse(const std::string &text, T *value) {
+                if (std::is_unsigned<T>::value && text.front() == '-') return false;
+                std::istringstream in(text);
+                in >> *value;
+                return in && (in >> std::ws).eof();
+            }
+
+            const ExperimentConfig &experiment_;
+            std::set<std::string> used_;
+            std::map<std::string, std::string> values_;  // Of the parameters given, as read.
+            std::vector<std::string> errors_;
+            std::string output_;
+        };
+
+        AdaptiveStopping ReadStopping(Parameters &parameters) {
+            AdaptiveStopping stopping;
+            stopping.min_reconstructions = parameters.get("min_reconstructions", stopping.min_reconstructions);
+            stopping.relative_half_width = parameters.get("ci_width", stopping.relative_half_width);
+            stopping.z = parameters.get("ci_z", stopping.z);
+            return stopping;
+        }
+
+        GridRefinement ReadRefinement(Parameters &parameters) {
+            GridRefinement refinement;
+            refinement.max_points = parameters.get("refine_points", refinement.max_points);
+            refinement.initial_intervals = parameters.get("refine_initial_intervals", refinement.initial_intervals);
+            refinement.num_intervals = parameters.get("refine_intervals", refinement.num_intervals);
+            refinement.tolerance = parameters.get("refine_tolerance", refinement.tolerance);
+            return refinement;
+        }
+
+        FocalLengthStrata ReadStrata(Parameters &parameters) {
+            FocalLengthStrata strata;
+            strata.min_focal_length = parameters.get("strata_min", strata.min_focal_length);
+            strata.max_focal_length = parameters.get("strata_max", strata.max_focal_length);
+            strata.target_count = parameters.get("strata_target", strata.target_count);
+            return strata;
+        }
+
+        Shard ReadShard(Parameters &parameters) {
+            Shard shard;
+            shard.index = parameters.get("shard_index", shard.index);
+            shard.count = parameters.get("shard_count", shard.count);
+            return shard;
+        }
+
+        // The settings read by an experiment besides those of every one, so that the others are unknown parameters of it.
+        enum SettingsGroup : unsigned {
+            kFocalLengthRange = 1,  // min_focal_length and max_focal_length, of the fixed focal length experiments.
+            kDistribution = 2,      // center, stddev and log_normal, of the varying focal length experiments.
+            kTranslationGrid = 4,   // translation_range_min, translation_range_max and translation_steps, of the sweeps.
+        };
+
+        ExperimentSettings ReadSettings(Parameters &parameters, unsigned groups) {
+            ExperimentSettings settings;
+            settings.width = parameters.get("width", settings.width);
+            settings.height = parameters.get("height", settings.height);
+            if (groups & kFocalLengthRange) {
+                settings.min_focal_length = parameters.get("min_focal_length", settings.min_focal_length);
+                settings.max_focal_length = parameters.get("max_focal_length", settings.max_focal_length);
+            }
+            if (groups & kDistribution) {
+                settings.center = parameters.get("center", settings.center);
+                settings.stddev = parameters.get("stddev", settings.stddev);
+                settings.use_log_normal = parameters.get("log_normal", settings.use_log_normal);
+            }
+            if (groups & kTranslationGrid) {
+                settings.translation_range_min = parameters.get("translation_range_min", settings.translation_range_min);
+                settings.translation_range_max = parameters.get("translation_range_max", settings.translation_range_max);
+                settings.translation_steps = parameters.get("translation_steps", settings.translation_steps);
+            }
+            settings.results_format = parameters.get("results_format", settings.results_format);
+            settings.rotations = parameters.get("rotations", settings.rotations);
+            settings.common_random_numbers = parameters.get("common_random_numbers", settings.common_random_numbers);
+            return settings;
+        }
+
+        // An experiment of the configurations : bind reads its parameters and returns the call running it.
+        struct ExperimentType {
+            const char *name;
+            const char *usage;
+            std::function<std::function<void()>(Parameters &)> bind;
+        };
+
+        const std::vector<ExperimentType> &ExperimentTypes() {
+            static const std::vector<ExperimentType> types = {
+                {"iac_vs_qr", "recoverK_IACvsQR : num_cams (10), num_reconstructions (1), translation_range (1), seed, stopping, settings",
+                 [](Parameters &parameters) -> std::function<void()> {
+                     const int num_cams = parameters.get("num_cams", 10), num_reconstructions = parameters.get("num_reconstructions", 1);
+                     const double translation_range = parameters.get("translation_range", 1.0);
+                     const uint64_t seed = parameters.get<uint64_t>("seed", 0);
+                     const AdaptiveStopping stopping = ReadStopping(parameters);
+                     const ExperimentSettings settings = ReadSettings(parameters, kFocalLengthRange);
+                     parameters.set_output(IACvsQRPath(num_cams, num_reconstructions, translation_range, stopping, settings));
+                     return [=]() { recoverK_IACvsQR(num_cams, num_reconstructions, translation_range, seed, stopping, settings); };
+                 }},
+                {"detailed_losses", "recoverK_detailed_losses : num_cams (10), num_reconstructions (10), translation_range (1), seed, stopping, settings",
+                 [](Parameters &parameters) -> std::function<void()> {
+                     const int num_cams = parameters.get("num_cams", 10), num_reconstructions = parameters.get("num_reconstructions", 10);
+                     const double translation_range = parameters.get("translation_range", 1.0);
+                     const uint64_t seed = parameters.get<uint64_t>("seed", 0);
+                     const AdaptiveStopping stopping = ReadStopping(parameters);
+                     const ExperimentSettings settings = ReadSettings(parameters, kFocalLengthRange);
+                     parameters.set_output(DetailedLossesPath(num_cams, num_reconstructions, translation_range, stopping, settings));
+                     return [=]() { recoverK_detailed_losses(num_cams, num_reconstructions, translation_range, seed, stopping, settings); };
+                 }},
+                {"varying_focal_length", "recoverK_varying_focal_length : num_cams (10), num_reconstructions (100), translation_range (1), seed, stopping, strata, settings",
+                 [](Parameters &parameters) -> std::function<void()> {
+                     const int num_cams = parameters.get("num_cams", 10), num_reconstructions = parameters.get("num_reconstructions", 100);
+                     const double translation_range = parameters.get("translation_range", 1.0);
+                     const uint64_t seed = parameters.get<uint64_t>("seed", 0);
+                     const AdaptiveStopping stopping = ReadStopping(parameters);
+                     const FocalLengthStrata strata = ReadStrata(parameters);
+                     const ExperimentSettings settings = ReadSettings(parameters, kDistribution);
+                     parameters.set_output(VaryingFocalLengthPath(num_cams, num_reconstructions, translation_range, stopping, strata, settings));
+                     return [=]() { recoverK_varying_focal_length(num_cams, num_reconstructions, translation_range, seed, stopping, strata, settings); };
+                 }},
+                {"fixed_translation_range", "recoverK_FIXED_IACvsQR_effect_of_translation_range : num_cams, num_reconstructions, focal_length, seed, stopping, refinement, shard, settings",
+                 [](Parameters &parameters) -> std::function<void()> {
+                     const int num_cams = parameters.required<int>("num_cams"), num_reconstructions = parameters.required<int>("num_reconstructions");
+                     const int focal_length = parameters.required<int>("focal_length");
+                     const uint64_t seed = parameters.get<uint64_t>("seed", 0);
+                     const AdaptiveStopping stopping = ReadStopping(parameters);
+                     const GridRefinement refinement = ReadRefinement(parameters);
+                     const Shard shard = ReadShard(parameters);
+                     const ExperimentSettings settings = ReadSettings(parameters, kTranslationGrid);
+                     const std::string path = FixedTranslationRangePath(num_cams, num_reconstructions, focal_length, stopping, refinement, settings);
+                     parameters.set_output(shard.enabled() ? ShardPath(path, shard) : path);
+                     return [=]() {
+                         recoverK_FIXED_IACvsQR_effect_of_translation_range(num_cams, num_reconstructions, focal_length, seed, stopping, refinement,
+                                                                            shard, settings);
+                     };
+                 }},
+                {"varying_translation_range", "recoverK_VARYING_IACvsQR_effect_of_translation_range : num_cams, num_reconstructions, seed, stopping, refinement, strata, shard, settings",
+                 [](Parameters &parameters) -> std::function<void()> {
+                     const int num_cams = parameters.required<int>("num_cams"), num_reconstructions = parameters.required<int>("num_reconstructions");
+                     const uint64_t seed = parameters.get<uint64_t>("seed", 0);
+                     const AdaptiveStopping stopping = ReadStopping(parameters);
+                     const GridRefinement refinement = ReadRefinement(parameters);
+                     const FocalLengthStrata strata = ReadStrata(parameters);
+                     const Shard shard = ReadShard(parameters);
+                     const ExperimentSettings settings = ReadSettings(parameters, kDistribution | kTranslationGrid);
+                     const std::string path = VaryingTranslationRangePath(num_cams, num_reconstructions, stopping, refinement, strata, settings);
+                     parameters.set_output(shard.enabled() ? ShardPath(path, shard) : path);
+                     return [=]() {
+                         recoverK_VARYING_IACvsQR_effect_of_translation_range(num_cams, num_reconstructions, seed, stopping, refinement, strata,
+                                                                              shard, settings);
+                     };
+                 }},
+                {"test_K_From_AbsoluteConic", "", [](Parameters &) { return std::function<void()>(test_K_From_AbsoluteConic); }},
+                {"test_with_metric_input", "", [](Parameters &) { return std::function<void()>(test_with_metric_input); }},
+                {"test_wc_closed_form", "", [](Parameters &) { return std::function<void()>(test_wc_closed_form); }},
+                {"test_normal_equations_vs_svd", "", [](Parameters &) { return std::function<void()>(test_normal_equations_vs_svd); }},
+                {"test_sliding_window", "", [](Parameters &) { return std::function<void()>(test_sliding_window); }},
+                {"test_simd_jacobi", "", [](Parameters &) { return std::function<void()>(test_simd_jacobi); }},
+                {"test_KRt_batch", "", [](Parameters &) { return std::function<void()>(test_KRt_batch); }},
+                {"test_upper_cholesky", "", [](Parameters &) { return std::function<void()>(test_upper_cholesky); }},
+                {"test_stacked_iac", "", [](Parameters &) { return std::function<void()>(test_stacked_iac); }},
+                {"test_sweep_determinism", "", [](Parameters &) { return std::function<void()>(test_sweep_determinism); }},
+                {"test_philox", "", [](Parameters &) { return std::function<void()>(test_philox); }},
+                {"test_streaming_statistics", "", [](Parameters &) { return std::function<void()>(test_streaming_statistics); }},
+                {"test_stratified_focal_lengths", "", [](Parameters &) { return std::function<void()>(test_stratified_focal_lengths); }},
+                {"test_checkpoint_resume", "", [](Parameters &) { return std::function<void()>(test_checkpoint_resume); }},
+                {"test_columnar_results", "", [](Parameters &) { return std::function<void()>(test_columnar_results); }},
+                {"test_result_sink", "", [](Parameters &) { return std::function<void()>(test_result_sink); }},
+                {"test_scene_generator", "", [](Parameters &) { return std::function<void()>(test_scene_generator); }},
+                {"test_common_random_numbers", "", [](Parameters &) { return std::function<void()>(test_common_random_numbers); }},
+                {"test_shared_diac_coefficients", "", [](Parameters &) { return std::function<void()>(test_shared_diac_coefficients); }},
+                {"test_constraint_policies", "", [](Parameters &) { return std::function<void()>(test_constraint_policies); }},
+                {"test_sharded_sweep", "", [](Parameters &) { return std::function<void()>(test_sharded_sweep); }},
+            };
+            return types;
+        }
+
+        std::string Describe(const ExperimentConfig &experiment) {
+            return "[" + experiment.name + "] of " + experiment.source;
+        }
+    }
+
+    bool ParseExperimentConfig(std::istream &in, const std::string &source, std::vector<ExperimentConfig> *experiments,
+                               SchedulerOptions *options) {
+        bool in_section = false;
+        std::string line;
+        for (size_t line_number = 1; std::getline(in, line); ++line_number) {
+            if (!ParseConfigLine(line, LineSource(source, line_number), &in_section, experiments, options)) return false;
+        }
+        return true;
+    }
+
+    bool ParseCommandLine(int argc, const char *const *argv, std::vector<ExperimentConfig> *experiments, SchedulerOptions *options) {
+        bool in_section = false;
+        for (int arg = 1; arg < argc; ++arg) {
+            const std::string argument = argv[arg];
+            const std::string source = "argument " + std::to_string(arg);
+            if (argument.find('=') != std::string::npos || argument.front() == '[') {
+                if (!ParseConfigLine(argument, source, &in_section, experiments, options)) return false;
+                continue;
+            }
+            std::ifstream file(argument);
+            if (file) {
+                if (!ParseExperimentConfig(file, argument, experiments, options)) return false;
+                in_section = false;
+            } else if (!ParseConfigLine("[" + argument + "]", source, &in_section, experiments, options)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string ExperimentUsage() {
+        std::stringstream usage;
+        usage << "Usage : autocalibration <configuration file | key=value | [experiment] | experiment> ...\n\n"
+              << "Scheduler options, before the first experiment :\n"
+              << "  concurrent_experiments (2), progress_interval (30 s)\n\n"
+              << "Experiments, and their parameters (default) :\n";
+        for (const ExperimentType &type : ExperimentTypes()) {
+            if (*type.usage) usage << "  " << type.name << " = " << type.usage << "\n";
+        }
+        usage << "  stopping : min_reconstructions (32), ci_width (0, every reconstruction), ci_z (1.96)\n"
+              << "  refinement : refine_points (0, regular grid), refine_initial_intervals (16), refine_intervals (256), refine_tolerance (0.1)\n"
+              << "  strata : strata_min (0), strata_max (0, not stratified), strata_target (16)\n"
+              << "  shard : shard_index (0), shard_count (1, not sharded)\n"
+              << "  settings : width (36), height (24),\n"
+              << "             min_focal_length (10), max_focal_length (300), of iac_vs_qr and detailed_losses,\n"
+              << "             center (3.7), stddev (0.6), log_normal (1), of the varying experiments,\n"
+              << "             translation_range_min (0.001), translation_range_max (10000), translation_steps (200), of the translation range sweeps,\n"
+              << "             rotations (euler, three angles in [0, 3] as in the paper, or uniform over all the rotations),\n"
+              << "             common_random_numbers (0, or 1 for the same scenes at every point of the sweeps),\n"
+              << "             results_format (text, or columnar for .acol files read by read_columns of python_plots/utils.py)\n\n"
+              << "Tests :\n ";
+        for (const ExperimentType &type : ExperimentTypes()) {
+            if (!*type.usage) usage << " " << type.name;
+        }
+        usage << "\n";
+        return usage.str();
+    }
+
+    bool RunExperiments(const std::vector<ExperimentConfig> &experiments, const SchedulerOptions &options) {
+        struct Job {
+            const ExperimentConfig *experiment;
+            std::function<void()> run;
+        };
+        std::vector<Job> jobs;
+        std::set<std::string> used_keys;
+        std::map<std::string, const ExperimentConfig *> first_of;   // Of every Parameters::signature.
+        std::map<std::string, const ExperimentConfig *> writer_of;  // Of every result file.
+        bool valid = true;
+        for (const ExperimentConfig &experiment : experiments) {
+            auto type = std::find_if(ExperimentTypes().begin(), ExperimentTypes().end(),
+                                     [&](const ExperimentType &type) { return experiment.name == type.name; });
+            if (type == ExperimentTypes().end()) {
+                std::cerr << experiment.source << " : unknown experiment " << experiment.name << std::endl;
+                valid = false;
+                continue;
+            }
+            Parameters parameters(experiment);
+            std::function<void()> run = type->bind(parameters);
+            if (!parameters.check()) {
+                valid = false;
+                continue;
+            }
+            used_keys.insert(parameters.used().begin(), parameters.used().end());
+
+            auto first = first_of.emplace(parameters.signature(), &experiment);
+            if (!first.second) {
+                std::cout << "Skipping " << Describe(experiment) << ", the same as " << Describe(*first.first->second) << std::endl;
+                continue;
+            }
+            // Two experiments differing in a parameter missing from the name of the file, as seed, would overwrite it.
+            if (!parameters.output().empty()) {
+                auto writer = writer_of.emplace(parameters.output(), &experiment);
+                if (!writer.second) {
+                    std::cerr << Describe(experiment) << " and " << Describe(*writer.first->second) << " both write " << parameters.output() << std::endl;
+                    valid = false;
+                    continue;
+                }
+            }
+            jobs.push_back({&experiment, run});
+        }
+        for (const auto &parameter : options.defaults) {
+            if (used_keys.count(parameter.first) == 0) {
+                std::cerr << "Default " << parameter.first << " is not a parameter of any experiment" << std::endl;
+                valid = false;
+            }
+        }
+        if (!valid) return false;
+        if (jobs.empty()) {
+            std::cerr << "No experiment to run" << std::endl;
+            return false;
+        }
+
+        // Every running experiment has its own thread, its reconstructions going to the threads of the pool, so that
+        // the pool stays busy while an experiment writes its files or reduces its losses.
+        const size_t num_threads = std::min(jobs.size(), options.concurrent_experiments == 0 ? jobs.size() : options.concurrent_experiments);
+        std::cout << "Running " << jobs.size() << " experiments, " << num_threads << " at once on "
+                  << ThreadPool::global().num_threads() << " threads" << std::endl;
+
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+        auto seconds_since = [](Clock::time_point time) { return std::chrono::duration<double>(Clock::now() - time).count(); };
+        std::mutex mutex;
+        std::condition_variable job_done;
+        size_t next_job = 0, num_done = 0, num_failed = 0;
+        std::map<size_t, Clock::time_point> running;  // Start of every running job.
+
+        auto run_jobs = [&]() {
+            for (;;) {
+                size_t job;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (next_job == jobs.size()) return;
+                    job = next_job++;
+                    running[job] = Clock::now();
+                    std::cout << "Starting " << Describe(*jobs[job].experiment) << std::endl;
+                }
+                std::string failure;
+                try {
+                    jobs[job].run();
+                } catch (const std::exception &exception) {
+                    failure = exception.what();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++num_done;
+                    if (!failure.empty()) {
+                        ++num_failed;
+                        std::cerr << "Failed " << Describe(*jobs[job].experiment) << " : " << failure << std::endl;
+                    }
+                    std::cout << "Finished " << Describe(*jobs[job].experiment) << " in " << seconds_since(running[job]) << " s, "
+                              << num_done << "/" << jobs.size() << " experiments done" << std::endl;
+                    running.erase(job);
+                }
+                job_done.notify_all();
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t thread = 0; thread < num_threads; ++thread) threads.emplace_back(run_jobs);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (num_done < jobs.size()) {
+                if (options.progress_interval <= 0) {
+                    job_done.wait(lock);
+                    continue;
+                }
+                if (job_done.wait_for(lock, std::chrono::duration<double>(options.progress_interval)) == std::cv_status::no_timeout) continue;
+                std::cout << "[" << seconds_since(start) << " s] " << num_done << "/" << jobs.size() << " experiments done, running :";
+                for (const auto &job : running) {
+                    std::cout << " " << Describe(*jobs[job.first].experiment) << " for " << seconds_since(job.second) << " s;";
+                }
+                std::cout << std::endl;
+            }
+        }
+        for (std::thread &thread : threads) thread.join();
+        std::cout << "All " << jobs.size() << " experiments done in " << seconds_since(start) << " s" << std::endl;
+        if (num_failed > 0) {
+            std::cerr << num_failed << " of " << jobs.size() << " experiments failed" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
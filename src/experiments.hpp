@@ -0,0 +1,64 @@
+// Experiments chosen by a configuration instead of calls in main : a configuration lists experiments with their
+// parameters, and RunExperiments runs several of them at once on the threads of ThreadPool::global().
+//
+// A configuration is a file, or the arguments of the command line, of lines :
+//   # A comment
+//   key = value            Before the first section, a default for all the experiments, or an option of the scheduler.
+//   [experiment]           Starts an experiment, or a test, of ExperimentUsage().
+//   key = value            A parameter of the experiment.
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rootba_povar {
+
+    /** \brief One experiment of a configuration, its parameters as written. */
+    struct ExperimentConfig {
+        std::string name;
+        std::map<std::string, std::string> parameters;  // Including the defaults given before the first section.
+        std::map<std::string, std::string> own_parameters;  // Given in the section itself.
+        std::string source;  // File and line of the section, for the messages.
+    };
+
+    /** \brief The keys before the first section of a configuration. */
+    struct SchedulerOptions {
+        size_t concurrent_experiments = 2;  // Experiments run at once, sharing the threads of the pool.
+        double progress_interval = 30;      // Seconds between reports of the running experiments, 0 for none.
+        std::map<std::string, std::string> defaults;  // Parameters of all the experiments.
+    };
+
+    /** \brief Appends the experiments of the configuration in in to experiments.
+     *
+     *  Defaults and options set by options are updated, so that configurations
+     *  can be read one after the other.  False, with a message naming the line,
+     *  on a syntax error.
+     */
+    bool ParseExperimentConfig(std::istream &in, const std::string &source, std::vector<ExperimentConfig> *experiments,
+                               SchedulerOptions *options);
+
+    /** \brief ParseExperimentConfig on the arguments : each is a configuration
+     *         file, a line ("key=value", "[experiment]"), or the name of an
+     *         experiment starting its section.
+     */
+    bool ParseCommandLine(int argc, const char *const *argv, std::vector<ExperimentConfig> *experiments, SchedulerOptions *options);
+
+    /** \brief How to run the program, with the experiments and their parameters. */
+    std::string ExperimentUsage();
+
+    /** \brief Runs the experiments, options.concurrent_experiments at once,
+     *         reporting the running ones every options.progress_interval.
+     *
+     *  Every experiment is checked before any runs : unknown experiments,
+     *  parameters the experiment does not read and values that cannot be read
+     *  fail with a message, as do two different experiments writing the same
+     *  file.  Experiments with the same name and parameter values, however
+     *  written, run once.  False if the configuration is wrong or if an
+     *  experiment failed, by throwing, the others still running.
+     */
+    bool RunExperiments(const std::vector<ExperimentConfig> &experiments, const SchedulerOptions &options);
+}
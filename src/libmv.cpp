@@ -3,78 +3,70 @@
 //
 
 #include "libmv.hpp"
+#include "batched_kernels.hpp"
 #include <iostream>
+#include <limits>
 
 namespace rootba_povar {
 
 
     // Nicolas
     template <typename Scalar>
-    void K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K) {
-        // Does the same thing as K_From_AbsoluteConic but is properly named and stays in the dual space : no need to dualize (=take an inverse).
-        // Use an upper triangular Choleski to uncover K from KKt
-
-
-        Eigen::Matrix<Scalar, 3, 3> flipped_KKt;
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                flipped_KKt(i,j) = KKt(2 - i, 2 - j);
-            }
+    bool UpperCholesky3(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K) {
+        // Identify K K^T = KKt entry by entry, starting from the bottom right :
+        //   KKt(2,2) = K22^2,            KKt(1,2) = K12 K22,            KKt(0,2) = K02 K22,
+        //   KKt(1,1) = K11^2 + K12^2,    KKt(0,1) = K01 K11 + K02 K12,  KKt(0,0) = K00^2 + K01^2 + K02^2.
+        // KKt is positive definite iff the three squared diagonal elements are positive.
+        K->setZero();
+        const Scalar d2 = KKt(2,2);
+        if (!(d2 > 0)) {
+            K->setConstant(std::numeric_limits<Scalar>::quiet_NaN());
+            return false;
         }
+        const Scalar k22 = std::sqrt(d2);
+        const Scalar k12 = KKt(1,2) / k22, k02 = KKt(0,2) / k22;
 
-        Eigen::LLT<Eigen::Matrix<Scalar, 3, 3>> llt(flipped_KKt);
-        Eigen::Matrix<Scalar, 3, 3> L = llt.matrixL();
-
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                (*K)(i,j) = L(2 - i, 2 - j);
-            }
+        const Scalar d1 = KKt(1,1) - k12 * k12;
+        if (!(d1 > 0)) {
+            K->setConstant(std::numeric_limits<Scalar>::quiet_NaN());
+            return false;
         }
+        const Scalar k11 = std::sqrt(d1);
+        const Scalar k01 = (KKt(0,1) - k02 * k12) / k11;
 
-        // Resolve sign ambiguities assuming positive diagonal.
-        for (int j = 0; j < 3; ++j) {
-            if ((*K)(j, j) < 0) {
-                for (int i = 0; i < 3; ++i) {
-                    (*K)(i, j) = -(*K)(i, j);
-                }
-            }
+        const Scalar d0 = KKt(0,0) - k01 * k01 - k02 * k02;
+        if (!(d0 > 0)) {
+            K->setConstant(std::numeric_limits<Scalar>::quiet_NaN());
+            return false;
         }
+
+        (*K)(0,0) = std::sqrt(d0);
+        (*K)(0,1) = k01;
+        (*K)(0,2) = k02;
+        (*K)(1,1) = k11;
+        (*K)(1,2) = k12;
+        (*K)(2,2) = k22;
+        return true;
+    }
+
+    // Nicolas
+    template <typename Scalar>
+    bool K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K) {
+        // Does the same thing as K_From_AbsoluteConic but is properly named and stays in the dual space : no need to dualize (=take an inverse).
+        // Use an upper triangular Choleski to uncover K from KKt, which directly has a positive diagonal.
+        return UpperCholesky3(KKt, K);
     }
 
 
     //@Simon: from llvm library: https://github.com/libmv/libmv/blob/master/src/libmv/multiview/autocalibration.cc
 
     template <typename Scalar>
-    void K_From_AbsoluteConic(const Eigen::Matrix<Scalar, 3, 3> &W, Eigen::Matrix<Scalar, 3, 3> *K) {
-        // To compute upper-triangular Cholesky, we flip the indices of the input
-        // matrix, compute lower-triangular Cholesky, and then unflip the result.
-        // Nicolas : K is not recovered from the absolute conic here but from the projection of the absolute quadric
-
+    bool K_From_AbsoluteConic(const Eigen::Matrix<Scalar, 3, 3> &W, Eigen::Matrix<Scalar, 3, 3> *K) {
+        // Nicolas : K is not recovered from the absolute conic here but from the projection of the absolute quadric.
+        // The flipped lower triangular Cholesky followed by the sign fixes of libmv is the closed form upper triangular
+        // one of UpperCholesky3.
         Eigen::Matrix<Scalar, 3, 3> dual = W.inverse();
-        Eigen::Matrix<Scalar, 3, 3> flipped_dual;
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                flipped_dual(i,j) = dual(2 - i, 2 - j);
-            }
-        }
-
-        Eigen::LLT<Eigen::Matrix<Scalar, 3, 3>> llt(flipped_dual);
-        Eigen::Matrix<Scalar, 3, 3> L = llt.matrixL();
-
-        for (int i = 0; i < 3; ++i) {
-            for (int j = 0; j < 3; ++j) {
-                (*K)(i,j) = L(2 - i, 2 - j);
-            }
-        }
-
-        // Resolve sign ambiguities assuming positive diagonal.
-        for (int j = 0; j < 3; ++j) {
-            if ((*K)(j, j) < 0) {
-                for (int i = 0; i < 3; ++i) {
-                    (*K)(i, j) = -(*K)(i, j);
-                }
-            }
-        }
+        return UpperCholesky3(dual, K);
     }
 
     // llvm library, see https://github.com/libmv/libmv/blob/master/src/libmv/multiview/projection.cc
@@ -170,241 +162,110 @@ namespace rootba_povar {
     }
 
     template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::NormalizeProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
-                             Scalar width,
-                             Scalar height,
-                             Eigen::Matrix<Scalar, 3, 4> *P_new) {
-        Eigen::Matrix<Scalar, 3, 3> T;
-        T << width + height,              0,  width / 2,
-                0, width + height, height / 2,
-                0,              0,                1;
-        *P_new = T.inverse() * P;
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::get_rid_of_principal_point(const Eigen::Matrix<Scalar, 3, 4> &P,
-                            Scalar width,
-                            Scalar height,
-                            Eigen::Matrix<Scalar, 3, 4> *P_new){
-        // Nicolas : premultiply the projection matrix to get rid of the principal point assuming that it is dead center.
-        Eigen::Matrix<Scalar, 3, 3> T;
-        T << 1, 0, - width / 2,
-             0, 1,  -height / 2,
-             0, 0, 1;
-        *P_new = T * P;                        
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::get_back_principal_point(const Eigen::Matrix<Scalar, 3, 4> &P,
-                                                      Scalar width,
-                                                      Scalar height,
-                                                      Eigen::Matrix<Scalar, 3, 4> *P_new) {
-        // Nicolas : postmultiply the projection matrix to recover the original principal point after the calculation
-        Eigen::Matrix<Scalar, 3, 3> T;
-        T << 1, 0, width / 2,
-             0, 1, height / 2,
-             0, 0, 1;
-        *P_new = T * P;
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::DenormalizeProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
-                                                      Scalar width,
-                                                      Scalar height,
-                                                      Eigen::Matrix<Scalar, 3, 4> *P_new) {
-        Eigen::Matrix<Scalar, 3, 3> T;
-        T << width + height,              0,  width / 2,
-                0, width + height, height / 2,
-                0,              0,                1;
-        *P_new = T * P;
-    }
-
-    template <typename Scalar>
-    Eigen::Matrix<Scalar, 4, 4> AutoCalibrationLinear<Scalar>::AbsoluteQuadricMatFromVec(const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> &q) {
-        Eigen::Matrix<Scalar, 4, 4> Q;
-        Q << q(0), q(1), q(2), q(3),
-                q(1), q(4), q(5), q(6),
-                q(2), q(5), q(7), q(8),
-                q(3), q(6), q(8), q(9);
-        return Q;
-    }
-
-    template <typename Scalar>
-    Scalar AutoCalibrationLinear<Scalar>::Nullspace(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *A, Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *nullspace) {
-        Eigen::JacobiSVD<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> svd(*A, Eigen::ComputeFullV);
-        (*nullspace) = svd.matrixV().col(A->cols()-1);
-        if (A->rows() >= A->cols())
-            return svd.singularValues()(A->cols()-1);
-        else
-            return 0.0;
-    }
-
-    template <typename Scalar>
-    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> AutoCalibrationLinear<Scalar>::wc(const Eigen::Matrix<Scalar, 3, 4> &P, int i, int j) {
-        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> constraint(10);
-        for (int k = 0; k < 10; ++k) {
-            Eigen::Matrix<Scalar, Eigen::Dynamic, 1> q = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>::Zero(10);
-            q(k) = 1;
-            Eigen::Matrix<Scalar, 4, 4> Q = AbsoluteQuadricMatFromVec(q);
-
-            Eigen::Matrix<Scalar, 3, 3> w = P * Q * P.transpose();
-
-            constraint(k) = w(i, j);
+    void AddProjections(const std::vector<Eigen::Matrix<Scalar, 3, 4>> &projections,
+                        Scalar width,
+                        Scalar height,
+                        AutoCalibrationLinear<Scalar, Pollefeys2004Constraints> *paper2004,
+                        AutoCalibrationLinear<Scalar, Pollefeys1997Constraints> *paper1997) {
+        for (const Eigen::Matrix<Scalar, 3, 4> &P : projections) {
+            const DiacCoefficients<Scalar> coefficients = AutoCalibrationLinear<Scalar>::ComputeDiacCoefficients(P, width, height);
+            if (paper2004) paper2004->AddProjection(coefficients);
+            if (paper1997) paper1997->AddProjection(coefficients);
         }
-        return constraint;
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::AddProjectionConstraints(const Eigen::Matrix<Scalar, 3, 4> &P) {
-        Scalar nu = 1.0;
-
-        // Non-extreme focal lenght.
-        constraints_.push_back((wc(P, 0, 0) - wc(P, 2, 2)) / 9 / nu);
-        constraints_.push_back((wc(P, 1, 1) - wc(P, 2, 2)) / 9 / nu);
-
-        // Aspect ratio is near 1.
-        constraints_.push_back((wc(P, 0, 0) - wc(P, 1, 1)) / 0.2 / nu);
-
-        // No skew and principal point near 0,0.
-        // Note that there is a typo in the Pollefeys' paper: the 0.01 is not at the
-        // correct equation.
-        constraints_.push_back(wc(P, 0, 1) / 0.01 / nu);
-        constraints_.push_back(wc(P, 0, 2) / 0.1 / nu);
-        constraints_.push_back(wc(P, 1, 2) / 0.1 / nu);
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::AddProjectionConstraints_1997paper(const Eigen::Matrix<Scalar, 3, 4> &P) {
-        Scalar nu = 1.0;
-
-        // Aspect ratio is near 1.
-        constraints_.push_back((wc(P, 0, 0) - wc(P, 1, 1)) / nu);
-
-        // No skew and principal point near 0,0.
-        // Note that there is a typo in the Pollefeys' paper: the 0.01 is not at the
-        // correct equation.
-        constraints_.push_back(wc(P, 0, 1) / nu);
-        constraints_.push_back(wc(P, 0, 2) / nu);
-        constraints_.push_back(wc(P, 1, 2) / nu);
-    }
-
-    template <typename Scalar>
-    void AutoCalibrationLinear<Scalar>::SortEigenVectors(const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> &values,
-                                 const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &vectors,
-                                 Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *sorted_values,
-                                 Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *sorted_vectors) {
-        // Compute eigenvalues order.
-        std::pair<Scalar, int> order[4];
-        for (int i = 0; i < 4; ++i) {
-            order[i].first = -values(i);
-            order[i].second = i;
-        }
-        std::sort(order, order + 4);
-
-        sorted_values->resize(4);
-        sorted_vectors->resize(4,4);
-        for (int i = 0; i < 4; ++i) {
-            (*sorted_values)(i) = values[order[i].second];
-            sorted_vectors->col(i) = vectors.col(order[i].second);
-        }
-    }
-
-    template <typename Scalar>
-    int AutoCalibrationLinear<Scalar>::AddProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
-                                                     Scalar width, Scalar height) {
-        Eigen::Matrix<Scalar, 3, 4> P_normalized;
-        //P_normalized = P;
-        NormalizeProjection(P, width, height, &P_normalized);
-
-        AddProjectionConstraints(P_normalized);
-
-        // Store input
-        projections_.push_back(P_normalized);
-        widths_.push_back(width);
-        heights_.push_back(height);
-
-        return projections_.size() - 1;
-    }
-
-    template <typename Scalar>
-    int AutoCalibrationLinear<Scalar>::AddProjection_1997paper(const Eigen::Matrix<Scalar, 3, 4> &P,
-                                                     Scalar width, Scalar height) {
-        Eigen::Matrix<Scalar, 3, 4> P_normalized;
-        //P_normalized = P;
-        get_rid_of_principal_point(P, width, height, &P_normalized);
-
-        AddProjectionConstraints_1997paper(P_normalized);
-
-        // Store input
-        projections_.push_back(P_normalized);
-        widths_.push_back(width);
-        heights_.push_back(height);
-
-        return projections_.size() - 1;
     }
 
 
     template <typename Scalar>
-    Eigen::Matrix<Scalar, 4, 4> AutoCalibrationLinear<Scalar>::MetricTransformation(Eigen::Matrix<Scalar, 4, 4> *Q_final, int* rank) {
-        // Compute the dual absolute quadric, Q.
-        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> A(constraints_.size(), 10);
-        for (int i = 0; i < A.rows(); ++i) {
-            A.row(i) = constraints_[i];
-        }
-        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> q;
-        Nullspace(&A, &q);
-        Eigen::Matrix<Scalar, 4, 4> Q = AbsoluteQuadricMatFromVec(q);
-        if (Q_final){
-            *Q_final = Q;
-        }
-        // TODO(pau) force rank 3.
-
-        // Compute a transformation to a metric frame by decomposing Q.
-        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 4, 4> > eigen_solver(Q);
-
-        // Eigen values should be possitive,
-        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> temp_values = eigen_solver.eigenvalues();
-        if (temp_values.sum() < 0) {
-            temp_values = -temp_values;
+    void AutoCalibrationBatch(const std::vector<Eigen::Matrix<Scalar, 3, 4>> &projections,
+                              const std::vector<size_t> &offsets,
+                              Scalar width,
+                              Scalar height,
+                              std::vector<AutoCalibrationResult<Scalar>> *results,
+                              bool use_normal_equations,
+                              ThreadPool *pool) {
+        if (!pool) pool = &ThreadPool::global();
+        const size_t num_reconstructions = offsets.empty() ? 0 : offsets.size() - 1;
+        results->resize(num_reconstructions);
+
+        // A few chunks per thread : small enough to balance the load, large enough to amortize the queues.
+        const size_t grain = std::max<size_t>(1, num_reconstructions / (8 * pool->num_threads()));
+        if (!use_normal_equations) {
+            pool->parallel_for(0, num_reconstructions, grain, [&](size_t r) {
+                AutoCalibrationLinear<Scalar> a;
+                for (size_t i = offsets[r]; i < offsets[r + 1]; ++i) {
+                    a.AddProjection(projections[i], width, height);
+                }
+                AutoCalibrationResult<Scalar> &result = (*results)[r];
+                result.H = a.MetricTransformation(&result.Q, &result.rank);
+            });
+            return;
         }
 
-        // and sorted, so that last one is 0.
-        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> eigenvalues;
-        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> eigenvectors;
-        SortEigenVectors(temp_values, eigen_solver.eigenvectors(),
-                         &eigenvalues, &eigenvectors);
-
-        if (rank) {
-            double relative_eps = 1e-3;
-            double threshold = relative_eps * eigenvalues(0);
-            *rank = 0;
-            for (int i = 0; i < 4; ++i) {
-                if (eigenvalues(i) > threshold) (*rank)++;
+        // Nicolas : with the normal equations, every reconstruction boils down to the same two small eigen problems
+        // (10x10 for q, 4x4 for Q), so a chunk of reconstructions is solved together by the lane-packed Jacobi kernels.
+        // Chunks hold at least 16 reconstructions to fill the widest registers.
+        const size_t chunk_size = std::max<size_t>(grain, 16);
+        const size_t num_chunks = (num_reconstructions + chunk_size - 1) / chunk_size;
+        pool->parallel_for(0, num_chunks, 1, [&](size_t chunk) {
+            const size_t first = chunk * chunk_size;
+            const size_t count = std::min(num_reconstructions, first + chunk_size) - first;
+
+            std::vector<Eigen::Matrix<Scalar, 10, 10>> AtA(count), AtA_vectors(count);
+            std::vector<Eigen::Matrix<Scalar, 10, 1>> AtA_values(count);
+            for (size_t k = 0; k < count; ++k) {
+                AutoCalibrationLinear<Scalar> a(true);
+                for (size_t i = offsets[first + k]; i < offsets[first + k + 1]; ++i) {
+                    a.AddProjection(projections[i], width, height);
+                }
+                AtA[k] = a.NormalEquations();
             }
-            // if (*rank !=3){
-            //     std::cout << "Rank : " << *rank << "Eigenvalues : " << eigenvalues.transpose() << std::endl;
-            // }
-        }
+            SymmetricEigenBatch(AtA.data(), count, AtA_values.data(), AtA_vectors.data());
+
+            // The absolute quadric is the eigenvector of the smallest eigenvalue of A^T A.
+            std::vector<Eigen::Matrix<Scalar, 4, 4>> Q(count), Q_vectors(count);
+            std::vector<Eigen::Matrix<Scalar, 4, 1>> Q_values(count);
+            for (size_t k = 0; k < count; ++k) {
+                int smallest;
+                AtA_values[k].minCoeff(&smallest);
+                Q[k] = AutoCalibrationLinear<Scalar>::AbsoluteQuadricMatFromVec(AtA_vectors[k].col(smallest));
+            }
+            SymmetricEigenBatch(Q.data(), count, Q_values.data(), Q_vectors.data());
 
-        // Compute the transformation from the eigen descomposition.  See last
-        // paragraph of page 3 in
-        //   "Autocalibration and the absolute quadric" by B. Triggs.
-        eigenvalues(3) = 1;
-        eigenvalues = eigenvalues.array().sqrt();
-        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> H = eigenvectors * eigenvalues.asDiagonal();
-        return H;
+            for (size_t k = 0; k < count; ++k) {
+                AutoCalibrationResult<Scalar> &result = (*results)[first + k];
+                result.Q = Q[k];
+                result.H = AutoCalibrationLinear<Scalar>::MetricTransformationFromEigen(Q_values[k], Q_vectors[k], &result.rank);
+            }
+        });
     }
+
 #ifdef ROOTBA_INSTANTIATIONS_FLOAT
-    template void K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<float, 3, 3> &KKt, Eigen::Matrix<float, 3, 3> *K);
-    template void K_From_AbsoluteConic(const Eigen::Matrix<float, 3, 3> &W, Eigen::Matrix<float, 3, 3> *K);
+    template bool UpperCholesky3(const Eigen::Matrix<float, 3, 3> &KKt, Eigen::Matrix<float, 3, 3> *K);
+    template bool K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<float, 3, 3> &KKt, Eigen::Matrix<float, 3, 3> *K);
+    template bool K_From_AbsoluteConic(const Eigen::Matrix<float, 3, 3> &W, Eigen::Matrix<float, 3, 3> *K);
     template void KRt_From_P(const Eigen::Matrix<float, 3, 4> &P, Eigen::Matrix<float, 3, 3> *Kp, Eigen::Matrix<float, 3, 3> *Rp, Eigen::Matrix<float, 3, 1> *tp);
-    template class AutoCalibrationLinear<float>;
+    template class AutoCalibrationLinear<float, Pollefeys2004Constraints>;
+    template class AutoCalibrationLinear<float, Pollefeys1997Constraints>;
+    template class AutoCalibrationLinear<float, KnownPrincipalPointConstraints>;
+    template void AddProjections(const std::vector<Eigen::Matrix<float, 3, 4>> &projections, float width, float height,
+                                 AutoCalibrationLinear<float, Pollefeys2004Constraints> *paper2004,
+                                 AutoCalibrationLinear<float, Pollefeys1997Constraints> *paper1997);
+    template void AutoCalibrationBatch(const std::vector<Eigen::Matrix<float, 3, 4>> &projections, const std::vector<size_t> &offsets, float width, float height,
+                                       std::vector<AutoCalibrationResult<float>> *results, bool use_normal_equations, ThreadPool *pool);
 #endif
 
 #ifdef ROOTBA_INSTANTIATIONS_DOUBLE
-    template void K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<double, 3, 3> &KKt, Eigen::Matrix<double, 3, 3> *K);
-    template void K_From_AbsoluteConic(const Eigen::Matrix<double, 3, 3> &W, Eigen::Matrix<double, 3, 3> *K);
+    template bool UpperCholesky3(const Eigen::Matrix<double, 3, 3> &KKt, Eigen::Matrix<double, 3, 3> *K);
+    template bool K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<double, 3, 3> &KKt, Eigen::Matrix<double, 3, 3> *K);
+    template bool K_From_AbsoluteConic(const Eigen::Matrix<double, 3, 3> &W, Eigen::Matrix<double, 3, 3> *K);
     template void KRt_From_P(const Eigen::Matrix<double, 3, 4> &P, Eigen::Matrix<double, 3, 3> *Kp, Eigen::Matrix<double, 3, 3> *Rp, Eigen::Matrix<double, 3, 1> *tp);
-    template class AutoCalibrationLinear<double>;
+    template class AutoCalibrationLinear<double, Pollefeys2004Constraints>;
+    template class AutoCalibrationLinear<double, Pollefeys1997Constraints>;
+    template class AutoCalibrationLinear<double, KnownPrincipalPointConstraints>;
+    template void AddProjections(const std::vector<Eigen::Matrix<double, 3, 4>> &projections, double width, double height,
+                                 AutoCalibrationLinear<double, Pollefeys2004Constraints> *paper2004,
+                                 AutoCalibrationLinear<double, Pollefeys1997Constraints> *paper1997);
+    template void AutoCalibrationBatch(const std::vector<Eigen::Matrix<double, 3, 4>> &projections, const std::vector<size_t> &offsets, double width, double height,
+                                       std::vector<AutoCalibrationResult<double>> *results, bool use_normal_equations, ThreadPool *pool);
 #endif
 }
\ No newline at end of file
@@ -2,6 +2,11 @@
 
 #include <Eigen/QR>
 #include <Eigen/Eigenvalues>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.hpp"
 
 namespace rootba_povar {
 
@@ -13,15 +18,130 @@ namespace rootba_povar {
     template <typename Scalar>
     void KRt_From_P(const Eigen::Matrix<Scalar, 3, 4> &P, Eigen::Matrix<Scalar, 3, 3> *K, Eigen::Matrix<Scalar, 3, 3> *R, Eigen::Matrix<Scalar, 3, 1> *t);
 
+    /** \brief Upper triangular Cholesky factorization of a 3x3 matrix, in closed form.
+     *
+     *  \param KKt A symmetric matrix.
+     *  \param K The upper triangular matrix with a positive diagonal such that
+     *         K K^T = KKt.
+     *  \return False if KKt is not positive definite, K being filled with NaN.
+     */
+    template <typename Scalar>
+    bool UpperCholesky3(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K);
+
+    /** \return False if KKt is not positive definite, see UpperCholesky3. */
     template <typename Scalar>
-    void K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K);
+    bool K_From_ImageOfTheDualAbsoluteQuadric(const Eigen::Matrix<Scalar, 3, 3> &KKt, Eigen::Matrix<Scalar, 3, 3> *K);
 
+    /** \return False if the inverse of W is not positive definite, see UpperCholesky3. */
     template <typename Scalar>
-    void K_From_AbsoluteConic(const Eigen::Matrix<Scalar, 3, 3> &W, Eigen::Matrix<Scalar, 3, 3> *K);
+    bool K_From_AbsoluteConic(const Eigen::Matrix<Scalar, 3, 3> &W, Eigen::Matrix<Scalar, 3, 3> *K);
+
+    /** \brief The six distinct elements of the DIAC of a projection, in the
+     *         order of the rows of DiacCoefficients.
+     */
+    enum class DiacElement { W00, W11, W22, W01, W02, W12, None };
+
+    /** \brief One linear constraint on the absolute quadric :
+     *
+     *    (w(element) - subtracted_coefficient w(subtracted)) scale^scale_power / divisor = 0
+     *
+     *  where w is the DIAC of the projection normalized as by AddProjection and
+     *  scale is width + height.  subtracted is None for a single element, and
+     *  scale_power (0, 1 or 2) undoes the normalization of the first two rows
+     *  of the projection.  The smaller the divisor, the stronger the prior.
+     */
+    struct ConstraintRow {
+        DiacElement element;
+        DiacElement subtracted;
+        double subtracted_coefficient;
+        int scale_power;
+        double divisor;
+    };
+
+    /** \brief The constraints of Pollefeys et al. 2004, the default policy of
+     *         AutoCalibrationLinear.
+     *
+     *  A constraint policy is a type with a constexpr array of ConstraintRow
+     *  named kRows, read at compile time : the constraints of one projection
+     *  are a fixed-size block of that many rows.  The members of
+     *  AutoCalibrationLinear are defined in libmv_impl.hpp, so that a new
+     *  policy only needs to be declared.
+     */
+    struct Pollefeys2004Constraints {
+        static constexpr ConstraintRow kRows[] = {
+            // Non-extreme focal lenght.
+            {DiacElement::W00, DiacElement::W22, 1, 0, 9},
+            {DiacElement::W11, DiacElement::W22, 1, 0, 9},
+            // Aspect ratio is near 1.
+            {DiacElement::W00, DiacElement::W11, 1, 0, 0.2},
+            // No skew and principal point near 0,0.
+            // Note that there is a typo in the Pollefeys' paper: the 0.01 is not at the
+            // correct equation.
+            {DiacElement::W01, DiacElement::None, 1, 0, 0.01},
+            {DiacElement::W02, DiacElement::None, 1, 0, 0.1},
+            {DiacElement::W12, DiacElement::None, 1, 0, 0.1},
+        };
+    };
 
+    /** \brief The constraints of Pollefeys et al. 1997, unweighted, on the
+     *         projection from which only the principal point is removed.
+     */
+    struct Pollefeys1997Constraints {
+        static constexpr ConstraintRow kRows[] = {
+            // Aspect ratio is near 1.
+            {DiacElement::W00, DiacElement::W11, 1, 2, 1},
+            // No skew and principal point near 0,0.
+            {DiacElement::W01, DiacElement::None, 1, 2, 1},
+            {DiacElement::W02, DiacElement::None, 1, 1, 1},
+            {DiacElement::W12, DiacElement::None, 1, 1, 1},
+        };
+    };
+
+    /** \brief The 2004 constraints for cameras known to have square pixels,
+     *         no skew and their principal point at the centre of the image :
+     *         those three priors are 10 to 20 times stronger.
+     */
+    struct KnownPrincipalPointConstraints {
+        static constexpr ConstraintRow kRows[] = {
+            {DiacElement::W00, DiacElement::W22, 1, 0, 9},
+            {DiacElement::W11, DiacElement::W22, 1, 0, 9},
+            {DiacElement::W00, DiacElement::W11, 1, 0, 0.01},
+            {DiacElement::W01, DiacElement::None, 1, 0, 0.001},
+            {DiacElement::W02, DiacElement::None, 1, 0, 0.01},
+            {DiacElement::W12, DiacElement::None, 1, 0, 0.01},
+        };
+    };
+
+    /** \brief The coefficients of the six distinct elements of the DIAC of a
+     *         normalized projection, see AutoCalibrationLinear::wc.
+     *
+     *  Rows are the elements of DiacElement : the constraints of every policy
+     *  are linear combinations of them, so that a camera used by several
+     *  policies is only expanded once.
+     */
     template <typename Scalar>
+    struct DiacCoefficients {
+        Eigen::Matrix<Scalar, 6, 10, Eigen::RowMajor> rows;
+        Scalar scale;  // width + height, by which NormalizeProjection divides the first two rows of P.
+    };
+
+    /** \brief Linear autocalibration from the constraints of Policy on the
+     *         DIAC of every projection, see Pollefeys2004Constraints.
+     */
+    template <typename Scalar, typename Policy = Pollefeys2004Constraints>
     class AutoCalibrationLinear {
     public:
+        /** \brief Constructor.
+         *
+         *  \param use_normal_equations If true, the constraints of each projection
+         *         are folded into the 10x10 matrix A^T A as soon as they are added,
+         *         and the absolute quadric is computed from its eigen decomposition
+         *         instead of the SVD of the full constraint matrix A.  Memory no
+         *         longer grows with the number of projections, but the condition
+         *         number is squared (see NullspaceErrorBounds).
+         */
+        explicit AutoCalibrationLinear(bool use_normal_equations = false);
+
         /** \brief Add a projection to be used for autocalibration.
          *
          *  \param P The projection matrix.
@@ -33,7 +153,30 @@ namespace rootba_povar {
          */
         int AddProjection(const Eigen::Matrix<Scalar, 3, 4> &P, Scalar width, Scalar height);
 
-        int AddProjection_1997paper(const Eigen::Matrix<Scalar, 3, 4> &P, Scalar width, Scalar height);
+        /** \brief Removes the constraints of a projection from the estimate.
+         *
+         *  \param index The index returned by AddProjection when the projection
+         *         was added.
+         *  \return False if the projection is not part of the estimate anymore, or
+         *          if its constraints were not kept (normal equations mode without
+         *          a sliding window).
+         *
+         *  In normal equations mode, A^T A is downdated in O(1).
+         */
+        bool RemoveProjection(int index);
+
+        /** \brief Only keeps the last window_size projections in the estimate.
+         *
+         *  \param window_size Maximum number of projections, 0 for no limit.
+         *
+         *  Each AddProjection then removes the oldest projection once the window is
+         *  full, so that the cost of AddProjection and MetricTransformation stays
+         *  bounded for a stream of projections.  In normal equations mode, A^T A is
+         *  periodically replaced by a sum accumulated since the last replacement to
+         *  keep downdating errors from building up.  Call it before adding the
+         *  first projection.
+         */
+        void SetSlidingWindow(int window_size);
 
         /** \brief Computes the metric updating transformation.
          *
@@ -42,15 +185,24 @@ namespace rootba_povar {
          *          a metric reconstruction.  Note that this follows the notation of
          *          HZ section 19.1 page 459, and not the notation of Pollefeys'
          *          paper [1].
+         *
+         *  The result is cached until the next AddProjection or RemoveProjection.
          */
         Eigen::Matrix<Scalar, 4, 4> MetricTransformation(Eigen::Matrix<Scalar, 4, 4> *Q_final = nullptr, int *rank = nullptr);
 
-    private:
-        /** \brief Add constraints on the absolute quadric based assumptions on the
-         *         parameters of one camera.
+        /** \brief Estimates how far the computed absolute quadric can be from the
+         *         exact nullspace of the constraints.
          *
-         *  \param P The projection matrix of the camera in projective coordinates.
+         *  \param svd_bound First order bound on the angle between the exact and
+         *         the computed absolute quadric when solving with the SVD of A,
+         *         eps * s_1 / (s_9 - s_10), where s_i are the singular values of A.
+         *  \param normal_equations_bound The same bound when solving with the
+         *         eigen decomposition of A^T A, eps * s_1^2 / (s_9^2 - s_10^2).
+         *
+         *  The ratio of both bounds is how much accuracy the normal equations mode
+         *  gives up with respect to the SVD path on the current constraints.
          */
+        void NullspaceErrorBounds(Scalar *svd_bound, Scalar *normal_equations_bound) const;
 
         /** \brief Computes the constraint associated to elements of the DIAC.
          *
@@ -61,21 +213,71 @@ namespace rootba_povar {
          *          absolute conic when written as a linear combination of the
          *          elements of the absolute quadric.  There are 10 coeficients since
          *          the absolute quadric is represented by 10 numbers.
+         *
+         *  The coefficients are computed in closed form from rows i and j of P,
+         *  without allocating.
          */
+        static Eigen::Matrix<Scalar, 10, 1> wc(const Eigen::Matrix<Scalar, 3, 4> &P, int i, int j);
 
-        void AddProjectionConstraints(const Eigen::Matrix<Scalar, 3, 4> &P);
-        void AddProjectionConstraints_1997paper(const Eigen::Matrix<Scalar, 3, 4> &P);
+        /** \brief The DIAC coefficients of P, normalized as by AddProjection. */
+        static DiacCoefficients<Scalar> ComputeDiacCoefficients(const Eigen::Matrix<Scalar, 3, 4> &P, Scalar width, Scalar height);
 
-        Scalar Nullspace(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *A, Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *nullspace);
+        /** \brief AddProjection, from the coefficients of ComputeDiacCoefficients. */
+        int AddProjection(const DiacCoefficients<Scalar> &coefficients);
 
-        void SortEigenVectors(const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> &values,
-                                     const Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> &vectors,
-                                     Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *sorted_values,
-                                     Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *sorted_vectors);
+        static constexpr int kNumConstraints = static_cast<int>(std::extent<decltype(Policy::kRows)>::value);
 
-        static Eigen::Matrix<Scalar, Eigen::Dynamic, 1> wc(const Eigen::Matrix<Scalar, 3, 4> &P, int i, int j);
+        /** \brief The constraints of one projection, a row per ConstraintRow of the policy. */
+        using ConstraintBlock = Eigen::Matrix<Scalar, kNumConstraints, 10, Eigen::RowMajor>;
 
-        static Eigen::Matrix<Scalar, 4, 4> AbsoluteQuadricMatFromVec(const Eigen::Matrix<Scalar, Eigen::Dynamic, 1> &q);
+        /** \brief The constraints of Policy on the projection of coefficients. */
+        static ConstraintBlock ComputeConstraints(const DiacCoefficients<Scalar> &coefficients);
+
+        /** \brief Computes the metric updating transformation from the eigen
+         *         decomposition of the absolute quadric.
+         *
+         *  \param values The eigenvalues of Q, in any order.
+         *  \param vectors The corresponding eigenvectors, as columns.
+         *  \param rank If not null, the numerical rank of Q.
+         *
+         *  This is the second half of MetricTransformation, for callers that
+         *  decompose Q themselves.
+         */
+        static Eigen::Matrix<Scalar, 4, 4> MetricTransformationFromEigen(const Eigen::Matrix<Scalar, 4, 1> &values,
+                                                                         const Eigen::Matrix<Scalar, 4, 4> &vectors,
+                                                                         int *rank = nullptr);
+
+        /** \brief The matrix A^T A accumulated in normal equations mode. */
+        const Eigen::Matrix<Scalar, 10, 10> &NormalEquations() const { return AtA_; }
+
+        static Eigen::Matrix<Scalar, 4, 4> AbsoluteQuadricMatFromVec(const Eigen::Matrix<Scalar, 10, 1> &q);
+
+    private:
+        /** \brief Add constraints on the absolute quadric based assumptions on the
+         *         parameters of one camera.
+         *
+         *  \param coefficients The DIAC coefficients of the normalized projection
+         *         of the camera, see ComputeDiacCoefficients.
+         */
+        int AddProjectionConstraints(const DiacCoefficients<Scalar> &coefficients);
+
+        struct ProjectionConstraints {
+            int index;
+            ConstraintBlock constraints;
+        };
+
+        int AddConstraints(const ConstraintBlock &constraints);
+
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> ConstraintMatrix() const;
+
+        Scalar Nullspace(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *A, Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *nullspace);
+
+        static Scalar NullspaceFromNormalEquations(const Eigen::Matrix<Scalar, 10, 10> &AtA, Eigen::Matrix<Scalar, 10, 1> *nullspace);
+
+        static void SortEigenVectors(const Eigen::Matrix<Scalar, 4, 1> &values,
+                                     const Eigen::Matrix<Scalar, 4, 4> &vectors,
+                                     Eigen::Matrix<Scalar, 4, 1> *sorted_values,
+                                     Eigen::Matrix<Scalar, 4, 4> *sorted_vectors);
 
         static void NormalizeProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
                                         Scalar width,
@@ -98,9 +300,76 @@ namespace rootba_povar {
                                           Eigen::Matrix<Scalar, 3, 4> *P_new);
 
     private:
-        std::vector<Eigen::Matrix<Scalar, 3, 4>> projections_; // The *normalized* projection matrices.
-        std::vector<Scalar> widths_;
-        std::vector<Scalar> heights_;
-        std::vector<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> constraints_;  // Linear constraints on q.
+        std::deque<ProjectionConstraints> constraints_;  // Linear constraints on q, by increasing projection index.
+
+        bool use_normal_equations_;
+        int num_projections_ = 0;
+        int window_size_ = 0;
+        Eigen::Matrix<Scalar, 10, 10> AtA_;  // Sum of the outer products of the constraints, in normal equations mode.
+
+        // With a sliding window, A^T A of the projections added since fresh_start_ : once all older projections
+        // have left the window, it replaces the downdated AtA_.
+        Eigen::Matrix<Scalar, 10, 10> fresh_AtA_;
+        int fresh_start_ = 0;
+
+        bool cache_valid_ = false;
+        Eigen::Matrix<Scalar, 4, 4> cached_H_;
+        Eigen::Matrix<Scalar, 4, 4> cached_Q_;
+        int cached_rank_ = 0;
     };
+
+    template <typename Scalar>
+    struct AutoCalibrationResult {
+        Eigen::Matrix<Scalar, 4, 4> H;  // Metric updating transformation.
+        Eigen::Matrix<Scalar, 4, 4> Q;  // Absolute quadric.
+        int rank;                       // Rank of Q.
+    };
+
+    /** \brief Adds every projection to the estimates of both papers, from one
+     *         pass over the cameras.
+     *
+     *  \param paper2004 Gets the projections, unless null.
+     *  \param paper1997 Gets the projections, unless null.
+     *
+     *  The DIAC coefficients of each projection are computed once, both sets of
+     *  constraints being combinations of them.
+     */
+    template <typename Scalar>
+    void AddProjections(const std::vector<Eigen::Matrix<Scalar, 3, 4>> &projections,
+                        Scalar width,
+                        Scalar height,
+                        AutoCalibrationLinear<Scalar, Pollefeys2004Constraints> *paper2004,
+                        AutoCalibrationLinear<Scalar, Pollefeys1997Constraints> *paper1997);
+
+    /** \brief Autocalibrates many independent reconstructions in parallel.
+     *
+     *  \param projections The projections of all the reconstructions, stored one
+     *         reconstruction after the other.
+     *  \param offsets Reconstruction r is made of projections[offsets[r]] to
+     *         projections[offsets[r + 1] - 1], so there is one more offset than
+     *         reconstructions.
+     *  \param width  The width of the image plane.
+     *  \param height The height of the image plane.
+     *  \param results One result per reconstruction, as MetricTransformation
+     *         would return it for an AutoCalibrationLinear built from the same
+     *         projections.
+     *  \param use_normal_equations See the AutoCalibrationLinear constructor.
+     *  \param pool The threads to use, ThreadPool::global() if null.
+     *
+     *  Reconstructions are handed out in small chunks that idle threads steal
+     *  from each other, so uneven reconstruction sizes still keep all the cores
+     *  busy.  In normal equations mode, the eigen decompositions of a chunk are
+     *  run together by SymmetricEigenBatch, several reconstructions per SIMD
+     *  register.
+     */
+    template <typename Scalar>
+    void AutoCalibrationBatch(const std::vector<Eigen::Matrix<Scalar, 3, 4>> &projections,
+                              const std::vector<size_t> &offsets,
+                              Scalar width,
+                              Scalar height,
+                              std::vector<AutoCalibrationResult<Scalar>> *results,
+                              bool use_normal_equations = false,
+                              ThreadPool *pool = nullptr);
 }
+
+#include "libmv_impl.hpp"
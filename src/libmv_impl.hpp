@@ -0,0 +1,374 @@
+// Definitions of the members of AutoCalibrationLinear, included by libmv.hpp so that AutoCalibrationLinear can be
+// instantiated with any constraint policy.  The policies of libmv.hpp are instantiated once, by libmv.cpp.
+
+#pragma once
+
+#include <Eigen/SVD>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace rootba_povar {
+
+    template <typename Scalar, typename Policy>
+    AutoCalibrationLinear<Scalar, Policy>::AutoCalibrationLinear(bool use_normal_equations)
+        : use_normal_equations_(use_normal_equations) {
+        AtA_.setZero();
+        fresh_AtA_.setZero();
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::NormalizeProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
+                             Scalar width,
+                             Scalar height,
+                             Eigen::Matrix<Scalar, 3, 4> *P_new) {
+        Eigen::Matrix<Scalar, 3, 3> T;
+        T << width + height,              0,  width / 2,
+                0, width + height, height / 2,
+                0,              0,                1;
+        *P_new = T.inverse() * P;
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::get_rid_of_principal_point(const Eigen::Matrix<Scalar, 3, 4> &P,
+                            Scalar width,
+                            Scalar height,
+                            Eigen::Matrix<Scalar, 3, 4> *P_new){
+        // Nicolas : premultiply the projection matrix to get rid of the principal point assuming that it is dead center.
+        Eigen::Matrix<Scalar, 3, 3> T;
+        T << 1, 0, - width / 2,
+             0, 1,  -height / 2,
+             0, 0, 1;
+        *P_new = T * P;                        
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::get_back_principal_point(const Eigen::Matrix<Scalar, 3, 4> &P,
+                                                      Scalar width,
+                                                      Scalar height,
+                                                      Eigen::Matrix<Scalar, 3, 4> *P_new) {
+        // Nicolas : postmultiply the projection matrix to recover the original principal point after the calculation
+        Eigen::Matrix<Scalar, 3, 3> T;
+        T << 1, 0, width / 2,
+             0, 1, height / 2,
+             0, 0, 1;
+        *P_new = T * P;
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::DenormalizeProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
+                                                      Scalar width,
+                                                      Scalar height,
+                                                      Eigen::Matrix<Scalar, 3, 4> *P_new) {
+        Eigen::Matrix<Scalar, 3, 3> T;
+        T << width + height,              0,  width / 2,
+                0, width + height, height / 2,
+                0,              0,                1;
+        *P_new = T * P;
+    }
+
+    template <typename Scalar, typename Policy>
+    Eigen::Matrix<Scalar, 4, 4> AutoCalibrationLinear<Scalar, Policy>::AbsoluteQuadricMatFromVec(const Eigen::Matrix<Scalar, 10, 1> &q) {
+        Eigen::Matrix<Scalar, 4, 4> Q;
+        Q << q(0), q(1), q(2), q(3),
+                q(1), q(4), q(5), q(6),
+                q(2), q(5), q(7), q(8),
+                q(3), q(6), q(8), q(9);
+        return Q;
+    }
+
+    template <typename Scalar, typename Policy>
+    Scalar AutoCalibrationLinear<Scalar, Policy>::Nullspace(Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> *A, Eigen::Matrix<Scalar, Eigen::Dynamic, 1> *nullspace) {
+        Eigen::JacobiSVD<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> svd(*A, Eigen::ComputeFullV);
+        (*nullspace) = svd.matrixV().col(A->cols()-1);
+        if (A->rows() >= A->cols())
+            return svd.singularValues()(A->cols()-1);
+        else
+            return 0.0;
+    }
+
+    template <typename Scalar, typename Policy>
+    Scalar AutoCalibrationLinear<Scalar, Policy>::NullspaceFromNormalEquations(const Eigen::Matrix<Scalar, 10, 10> &AtA, Eigen::Matrix<Scalar, 10, 1> *nullspace) {
+        // Nicolas : the eigenvectors of A^T A are the right singular vectors of A, and its eigenvalues the squared singular values.
+        // Eigenvalues come sorted in increasing order, so the nullspace is the first eigenvector.
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 10, 10>> eigen_solver(AtA);
+        (*nullspace) = eigen_solver.eigenvectors().col(0);
+        return std::sqrt(std::max(eigen_solver.eigenvalues()(0), Scalar(0)));
+    }
+
+    template <typename Scalar, typename Policy>
+    Eigen::Matrix<Scalar, 10, 1> AutoCalibrationLinear<Scalar, Policy>::wc(const Eigen::Matrix<Scalar, 3, 4> &P, int i, int j) {
+        // Nicolas : w = P * Q * P^T is linear in the 10 entries of Q, so the coefficients are read directly from rows i and j of P
+        // instead of projecting the 10 unit quadrics. The coefficient of Q(a,b) in w(i,j) is P(i,a) P(j,a) on the diagonal
+        // and P(i,a) P(j,b) + P(i,b) P(j,a) off the diagonal, which are exactly the (only non-zero) terms summed by P * Q * P^T.
+        const Scalar i0 = P(i, 0), i1 = P(i, 1), i2 = P(i, 2), i3 = P(i, 3);
+        const Scalar j0 = P(j, 0), j1 = P(j, 1), j2 = P(j, 2), j3 = P(j, 3);
+
+        // Same ordering of q as in AbsoluteQuadricMatFromVec.
+        Eigen::Matrix<Scalar, 10, 1> constraint;
+        constraint << i0 * j0,
+                      i0 * j1 + i1 * j0,
+                      i0 * j2 + i2 * j0,
+                      i0 * j3 + i3 * j0,
+                      i1 * j1,
+                      i1 * j2 + i2 * j1,
+                      i1 * j3 + i3 * j1,
+                      i2 * j2,
+                      i2 * j3 + i3 * j2,
+                      i3 * j3;
+        return constraint;
+    }
+
+    template <typename Scalar, typename Policy>
+    DiacCoefficients<Scalar> AutoCalibrationLinear<Scalar, Policy>::ComputeDiacCoefficients(const Eigen::Matrix<Scalar, 3, 4> &P, Scalar width, Scalar height) {
+        Eigen::Matrix<Scalar, 3, 4> P_normalized;
+        NormalizeProjection(P, width, height, &P_normalized);
+
+        DiacCoefficients<Scalar> coefficients;
+        coefficients.rows.row(0) = wc(P_normalized, 0, 0);
+        coefficients.rows.row(1) = wc(P_normalized, 1, 1);
+        coefficients.rows.row(2) = wc(P_normalized, 2, 2);
+        coefficients.rows.row(3) = wc(P_normalized, 0, 1);
+        coefficients.rows.row(4) = wc(P_normalized, 0, 2);
+        coefficients.rows.row(5) = wc(P_normalized, 1, 2);
+        coefficients.scale = width + height;
+        return coefficients;
+    }
+
+    template <typename Scalar, typename Policy>
+    int AutoCalibrationLinear<Scalar, Policy>::AddConstraints(const ConstraintBlock &constraints) {
+        const int index = num_projections_++;
+        cache_valid_ = false;
+
+        if (use_normal_equations_) {
+            // Nicolas : only A^T A is needed to solve the normal equations, so the constraints are only kept
+            // when they will have to be downdated again.
+            AtA_.noalias() += constraints.transpose() * constraints;
+            if (window_size_ > 0) {
+                fresh_AtA_.noalias() += constraints.transpose() * constraints;
+                constraints_.push_back({index, constraints});
+            }
+        } else {
+            constraints_.push_back({index, constraints});
+        }
+
+        if (window_size_ > 0 && static_cast<int>(constraints_.size()) > window_size_) {
+            RemoveProjection(constraints_.front().index);
+        }
+        return index;
+    }
+
+    template <typename Scalar, typename Policy>
+    bool AutoCalibrationLinear<Scalar, Policy>::RemoveProjection(int index) {
+        auto it = std::lower_bound(constraints_.begin(), constraints_.end(), index,
+                                   [](const ProjectionConstraints &c, int i) { return c.index < i; });
+        if (it == constraints_.end() || it->index != index) {
+            return false;
+        }
+
+        if (use_normal_equations_) {
+            AtA_.noalias() -= it->constraints.transpose() * it->constraints;
+            if (index >= fresh_start_) {
+                fresh_AtA_.noalias() -= it->constraints.transpose() * it->constraints;
+            }
+        }
+        constraints_.erase(it);
+        cache_valid_ = false;
+
+        // Once every projection older than fresh_AtA_ has left the window, fresh_AtA_ is A^T A without the
+        // rounding errors of the downdates : swap it in and start accumulating a new one.
+        if (use_normal_equations_ && window_size_ > 0 && (constraints_.empty() || constraints_.front().index >= fresh_start_)) {
+            AtA_ = fresh_AtA_;
+            fresh_AtA_.setZero();
+            fresh_start_ = num_projections_;
+        }
+        return true;
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::SetSlidingWindow(int window_size) {
+        window_size_ = window_size;
+        fresh_AtA_.setZero();
+        fresh_start_ = num_projections_;
+    }
+
+    template <typename Scalar, typename Policy>
+    typename AutoCalibrationLinear<Scalar, Policy>::ConstraintBlock
+    AutoCalibrationLinear<Scalar, Policy>::ComputeConstraints(const DiacCoefficients<Scalar> &coefficients) {
+        // Nicolas : the rows of the policy are constants, so that this loop unrolls into the same arithmetic as the
+        // constraints written out by hand. Multiplying by a power of scale of 1 and subtracting 1 times an element
+        // are exact, the constraints are those of the hand-written ones to the bit.
+        const Scalar scale_powers[3] = {1, coefficients.scale, coefficients.scale * coefficients.scale};
+        ConstraintBlock constraints;
+        for (int k = 0; k < kNumConstraints; ++k) {
+            const ConstraintRow &row = Policy::kRows[k];
+            const auto element = coefficients.rows.row(static_cast<int>(row.element));
+            if (row.subtracted == DiacElement::None) {
+                constraints.row(k) = element * scale_powers[row.scale_power] / Scalar(row.divisor);
+            } else {
+                const auto subtracted = coefficients.rows.row(static_cast<int>(row.subtracted));
+                constraints.row(k) = (element - Scalar(row.subtracted_coefficient) * subtracted) * scale_powers[row.scale_power] / Scalar(row.divisor);
+            }
+        }
+        return constraints;
+    }
+
+    template <typename Scalar, typename Policy>
+    int AutoCalibrationLinear<Scalar, Policy>::AddProjectionConstraints(const DiacCoefficients<Scalar> &coefficients) {
+        return AddConstraints(ComputeConstraints(coefficients));
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::SortEigenVectors(const Eigen::Matrix<Scalar, 4, 1> &values,
+                                 const Eigen::Matrix<Scalar, 4, 4> &vectors,
+                                 Eigen::Matrix<Scalar, 4, 1> *sorted_values,
+                                 Eigen::Matrix<Scalar, 4, 4> *sorted_vectors) {
+        // Compute eigenvalues order.
+        std::pair<Scalar, int> order[4];
+        for (int i = 0; i < 4; ++i) {
+            order[i].first = -values(i);
+            order[i].second = i;
+        }
+        std::sort(order, order + 4);
+
+        for (int i = 0; i < 4; ++i) {
+            (*sorted_values)(i) = values[order[i].second];
+            sorted_vectors->col(i) = vectors.col(order[i].second);
+        }
+    }
+
+    template <typename Scalar, typename Policy>
+    int AutoCalibrationLinear<Scalar, Policy>::AddProjection(const Eigen::Matrix<Scalar, 3, 4> &P,
+                                                             Scalar width, Scalar height) {
+        return AddProjectionConstraints(ComputeDiacCoefficients(P, width, height));
+    }
+
+    template <typename Scalar, typename Policy>
+    int AutoCalibrationLinear<Scalar, Policy>::AddProjection(const DiacCoefficients<Scalar> &coefficients) {
+        return AddProjectionConstraints(coefficients);
+    }
+
+    template <typename Scalar, typename Policy>
+    Eigen::Matrix<Scalar, 4, 4> AutoCalibrationLinear<Scalar, Policy>::MetricTransformation(Eigen::Matrix<Scalar, 4, 4> *Q_final, int* rank) {
+        if (cache_valid_) {
+            if (Q_final) *Q_final = cached_Q_;
+            if (rank) *rank = cached_rank_;
+            return cached_H_;
+        }
+
+        // Compute the dual absolute quadric, Q.
+        Eigen::Matrix<Scalar, 10, 1> q;
+        if (use_normal_equations_) {
+            NullspaceFromNormalEquations(AtA_, &q);
+        } else {
+            Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> A = ConstraintMatrix();
+            Eigen::Matrix<Scalar, Eigen::Dynamic, 1> nullspace;
+            Nullspace(&A, &nullspace);
+            q = nullspace;
+        }
+        Eigen::Matrix<Scalar, 4, 4> Q = AbsoluteQuadricMatFromVec(q);
+        // TODO(pau) force rank 3.
+
+        // Compute a transformation to a metric frame by decomposing Q.
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 4, 4> > eigen_solver(Q);
+        Eigen::Matrix<Scalar, 4, 4> H = MetricTransformationFromEigen(eigen_solver.eigenvalues(), eigen_solver.eigenvectors(), &cached_rank_);
+
+        cached_H_ = H;
+        cached_Q_ = Q;
+        cache_valid_ = true;
+        if (Q_final) *Q_final = cached_Q_;
+        if (rank) *rank = cached_rank_;
+        return cached_H_;
+    }
+
+    template <typename Scalar, typename Policy>
+    Eigen::Matrix<Scalar, 4, 4> AutoCalibrationLinear<Scalar, Policy>::MetricTransformationFromEigen(const Eigen::Matrix<Scalar, 4, 1> &values,
+                                                                                              const Eigen::Matrix<Scalar, 4, 4> &vectors,
+                                                                                              int *rank) {
+        // Eigen values should be possitive,
+        Eigen::Matrix<Scalar, 4, 1> temp_values = values;
+        if (temp_values.sum() < 0) {
+            temp_values = -temp_values;
+        }
+
+        // and sorted, so that last one is 0.
+        Eigen::Matrix<Scalar, 4, 1> eigenvalues;
+        Eigen::Matrix<Scalar, 4, 4> eigenvectors;
+        SortEigenVectors(temp_values, vectors,
+                         &eigenvalues, &eigenvectors);
+
+        if (rank) {
+            double relative_eps = 1e-3;
+            double threshold = relative_eps * eigenvalues(0);
+            *rank = 0;
+            for (int i = 0; i < 4; ++i) {
+                if (eigenvalues(i) > threshold) (*rank)++;
+            }
+            // if (*rank !=3){
+            //     std::cout << "Rank : " << *rank << "Eigenvalues : " << eigenvalues.transpose() << std::endl;
+            // }
+        }
+
+        // Compute the transformation from the eigen descomposition.  See last
+        // paragraph of page 3 in
+        //   "Autocalibration and the absolute quadric" by B. Triggs.
+        eigenvalues(3) = 1;
+        eigenvalues = eigenvalues.array().sqrt();
+        Eigen::Matrix<Scalar, 4, 4> H = eigenvectors * eigenvalues.asDiagonal();
+        return H;
+    }
+
+    template <typename Scalar, typename Policy>
+    Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> AutoCalibrationLinear<Scalar, Policy>::ConstraintMatrix() const {
+        int num_rows = 0;
+        for (const ProjectionConstraints &c : constraints_) {
+            num_rows += c.constraints.rows();
+        }
+        Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic> A(num_rows, 10);
+        int row = 0;
+        for (const ProjectionConstraints &c : constraints_) {
+            A.middleRows(row, c.constraints.rows()) = c.constraints;
+            row += c.constraints.rows();
+        }
+        return A;
+    }
+
+    template <typename Scalar, typename Policy>
+    void AutoCalibrationLinear<Scalar, Policy>::NullspaceErrorBounds(Scalar *svd_bound, Scalar *normal_equations_bound) const {
+        // Singular values of A, in decreasing order.
+        Eigen::Matrix<Scalar, 10, 1> singular_values;
+        if (use_normal_equations_) {
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix<Scalar, 10, 10>> eigen_solver(AtA_, Eigen::EigenvaluesOnly);
+            for (int i = 0; i < 10; ++i) {
+                singular_values(i) = std::sqrt(std::max(eigen_solver.eigenvalues()(9 - i), Scalar(0)));
+            }
+        } else {
+            singular_values.setZero();
+            Eigen::JacobiSVD<Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>> svd(ConstraintMatrix());
+            singular_values.head(svd.singularValues().size()) = svd.singularValues();
+        }
+
+        // Perturbation bounds on the smallest singular subspace (Wedin for the SVD, Davis-Kahan for A^T A),
+        // for a backward error of eps relative to the largest singular value.
+        const Scalar eps = Eigen::NumTraits<Scalar>::epsilon();
+        const Scalar s_1 = singular_values(0), s_9 = singular_values(8), s_10 = singular_values(9);
+        if (svd_bound) {
+            *svd_bound = eps * s_1 / (s_9 - s_10);
+        }
+        if (normal_equations_bound) {
+            *normal_equations_bound = eps * s_1 * s_1 / ((s_9 - s_10) * (s_9 + s_10));
+        }
+    }
+
+#ifdef ROOTBA_INSTANTIATIONS_FLOAT
+    extern template class AutoCalibrationLinear<float, Pollefeys2004Constraints>;
+    extern template class AutoCalibrationLinear<float, Pollefeys1997Constraints>;
+    extern template class AutoCalibrationLinear<float, KnownPrincipalPointConstraints>;
+#endif
+
+#ifdef ROOTBA_INSTANTIATIONS_DOUBLE
+    extern template class AutoCalibrationLinear<double, Pollefeys2004Constraints>;
+    extern template class AutoCalibrationLinear<double, Pollefeys1997Constraints>;
+    extern template class AutoCalibrationLinear<double, KnownPrincipalPointConstraints>;
+#endif
+}
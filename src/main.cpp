@@ -1,52 +1,19 @@
-#include "libmv.hpp"
-#include "testing_functions.hpp"
+#include "experiments.hpp"
 #include <iostream>
-
-
-int main(){
-//   rootba_povar::test_K_From_AbsoluteConic();
-//   rootba_povar::test_with_metric_input();
-  // rootba_povar::recoverK_IACvsQR(10,100,1);
-  // rootba_povar::recoverK_IACvsQR(50,100,1);
-  // rootba_povar::recoverK_IACvsQR(10,100,10);
-  // rootba_povar::recoverK_IACvsQR(10,100,10);
-  // rootba_povar::recoverK_IACvsQR(50,100,10);
-  // rootba_povar::recoverK_IACvsQR(10,100,100);
-  // rootba_povar::recoverK_IACvsQR(50,100,100);
-  // rootba_povar::recoverK_IACvsQR(10,100,1000);
-  // rootba_povar::recoverK_IACvsQR(50,100,1000);
-  // rootba_povar::recoverK_IACvsQR(10,100,10000);
-  // rootba_povar::recoverK_IACvsQR(50,100,10000);
-
-// rootba_povar::recoverK_detailed_losses(10, 50, 1);
-
-// rootba_povar::recoverK_detailed_losses(10, 50, 100);
-// rootba_povar::recoverK_detailed_losses(50, 50, 1);
-
-// rootba_povar::recoverK_detailed_losses(50, 50, 100);
-
-  // rootba_povar::recoverK_varying_focal_length(10, 5000, 1);
-  // rootba_povar::recoverK_varying_focal_length(50, 5000, 1);
-
-  // rootba_povar::recoverK_varying_focal_length(10, 5000, 100);
-
-  // rootba_povar::recoverK_varying_focal_length(50, 5000, 100);
-
-  // rootba_povar::recoverK_varying_focal_length(10, 5000, 1000);
-  // rootba_povar::recoverK_varying_focal_length(50, 5000, 1000);
-
-  // rootba_povar::recoverK_FIXED_IACvsQR_effect_of_translation_range(10, 50, 40);
-  // rootba_povar::recoverK_FIXED_IACvsQR_effect_of_translation_range(50, 50, 40);
-
-  // rootba_povar::recoverK_FIXED_IACvsQR_effect_of_translation_range(10, 50, 30);
-  // rootba_povar::recoverK_FIXED_IACvsQR_effect_of_translation_range(50, 50, 30);
-
-  // rootba_povar::recoverK_VARYING_IACvsQR_effect_of_translation_range(10, 50);
-  // rootba_povar::recoverK_VARYING_IACvsQR_effect_of_translation_range(50, 50);
-
-  // rootba_povar::recoverK_VARYING_IACvsQR_effect_of_translation_range(10, 500);
-  rootba_povar::recoverK_VARYING_IACvsQR_effect_of_translation_range(50, 500);
-
-
-  return 0;
+#include <vector>
+
+
+// The experiments and tests to run are given on the command line or in configuration files (see experiments.hpp and
+// the files of /configs/), for example :
+//   autocalibration ../configs/paper_experiments.cfg
+//   autocalibration fixed_translation_range num_cams=10 num_reconstructions=50 focal_length=40
+int main(int argc, char **argv){
+  std::vector<rootba_povar::ExperimentConfig> experiments;
+  rootba_povar::SchedulerOptions options;
+  if (argc < 2) {
+    std::cerr << rootba_povar::ExperimentUsage();
+    return 1;
+  }
+  if (!rootba_povar::ParseCommandLine(argc, argv, &experiments, &options)) return 1;
+  return rootba_povar::RunExperiments(experiments, options) ? 0 : 1;
 }
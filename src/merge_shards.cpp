@@ -0,0 +1,18 @@
+// Writes the result file of a sweep run in shards from the partial files of all its shards :
+//   merge_shards <path>.shard0of<n> ... <path>.shard<n-1>of<n>
+// The result file is written at <path>, as the unsharded sweep would have.
+
+#include "testing_functions.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage : " << argv[0] << " <partial file> ..." << std::endl;
+        return 1;
+    }
+    const std::vector<std::string> paths(argv + 1, argv + argc);
+    return rootba_povar::MergeTranslationRangeShards(paths) ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Counter-based random numbers : the n-th number of a stream is computed directly from (key, stream, n).
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+
+namespace rootba_povar {
+
+    /** \brief The Philox4x32-10 generator of Salmon et al., "Parallel random
+     *         numbers: as easy as 1, 2, 3", SC 2011.
+     *
+     *  A 64 bit key and a 128 bit counter are turned into 4 random 32 bit words
+     *  by 10 rounds of multiplications and xors.  The first word of the counter
+     *  numbers the blocks of a stream, the three others select the stream, so
+     *  that jumping to any stream or to any position in it is O(1).  It is a
+     *  UniformRandomBitGenerator, usable with the std distributions.
+     */
+    class Philox4x32 {
+    public:
+        using result_type = uint32_t;
+        using Counter = std::array<uint32_t, 4>;
+        using Key = std::array<uint32_t, 2>;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        explicit Philox4x32(uint64_t seed = 0) : key_{uint32_t(seed), uint32_t(seed >> 32)} {}
+
+        /** \brief The 4 words of block counter under key. */
+        static Counter Block(Counter counter, Key key) {
+            for (int round = 0; round < 10; ++round) {
+                const uint64_t product0 = uint64_t(0xD2511F53u) * counter[0];
+                const uint64_t product1 = uint64_t(0xCD9E8D57u) * counter[2];
+                counter = {uint32_t(product1 >> 32) ^ counter[1] ^ key[0], uint32_t(product1),
+                           uint32_t(product0 >> 32) ^ counter[3] ^ key[1], uint32_t(product0)};
+                key[0] += 0x9E3779B9u;
+                key[1] += 0xBB67AE85u;
+            }
+            return counter;
+        }
+
+        void seed(uint64_t seed) {
+            key_ = {uint32_t(seed), uint32_t(seed >> 32)};
+            set_stream(0, 0, 0);
+        }
+
+        /** \brief Restarts the generator at the beginning of stream (a, b, c). */
+        void set_stream(uint32_t a, uint32_t b, uint32_t c) {
+            counter_ = {0, a, b, c};
+            position_ = 4;
+        }
+
+        result_type operator()() {
+            if (position_ == 4) {
+                block_ = Block(counter_, key_);
+                ++counter_[0];
+                position_ = 0;
+            }
+            return block_[position_++];
+        }
+
+        void discard(unsigned long long n) {
+            // Whole blocks are skipped by moving the counter.
+            const unsigned long long buffered = 4 - position_;
+            if (n <= buffered) {
+                position_ += n;
+                return;
+            }
+            n -= buffered;
+            counter_[0] += uint32_t(n / 4);
+            position_ = 4;
+            for (unsigned long long i = 0; i < n % 4; ++i) (*this)();
+        }
+
+    private:
+        Key key_;
+        Counter counter_ = {0, 0, 0, 0};  // Counter of the next block.
+        Counter block_ = {0, 0, 0, 0};
+        unsigned position_ = 4;           // Next word of block_, 4 once it is used up.
+    };
+}
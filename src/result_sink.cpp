@@ -0,0 +1,113 @@
+#include "result_sink.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+namespace rootba_povar {
+
+    struct ResultSink::File {
+        std::string path;
+        std::FILE *out = nullptr;
+        std::string error;  // Of the first failed write, set by the writer thread.
+
+        ~File() {
+            if (out) std::fclose(out);  // Of a writer destroyed without closing it.
+        }
+    };
+
+    // A block to append to file, or with closed the end of the file.
+    struct ResultSink::Message {
+        std::shared_ptr<File> file;
+        std::string block;
+        std::promise<void> *closed = nullptr;
+    };
+
+    ResultSink::ResultSink(size_t capacity) : queue_(new BoundedQueue<Message>(capacity)) {
+        writer_ = std::thread([this] { writer_loop(); });
+    }
+
+    ResultSink::~ResultSink() {
+        stop_.store(true);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            wake_up_.notify_one();
+        }
+        writer_.join();
+    }
+
+    ResultSink &ResultSink::global() {
+        static ResultSink sink;
+        return sink;
+    }
+
+    std::shared_ptr<ResultSink::File> ResultSink::open(const std::string &path) {
+        auto file = std::make_shared<File>();
+        file->path = path;
+        file->out = std::fopen(path.c_str(), "wb");
+        if (!file->out) {
+            std::cerr << "Errors opening file for writing : " << path << " (" << std::strerror(errno) << ")" << std::endl;
+            return nullptr;
+        }
+        // The blocks are already large, they go to the disk as they are.
+        std::setvbuf(file->out, nullptr, _IONBF, 0);
+        return file;
+    }
+
+    void ResultSink::write(const std::shared_ptr<File> &file, std::string block) {
+        if (!block.empty()) push(Message{file, std::move(block), nullptr});
+    }
+
+    bool ResultSink::close(const std::shared_ptr<File> &file) {
+        std::promise<void> closed;
+        std::future<void> written = closed.get_future();
+        push(Message{file, std::string(), &closed});
+        written.wait();
+        if (!file->error.empty()) {
+            std::cerr << "Errors writing " << file->path << " : " << file->error << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void ResultSink::push(Message message) {
+        while (!queue_->try_push(std::move(message))) std::this_thread::yield();  // The disk is far behind.
+        // Pairs with the fence of the writer : either it sees the message, or this sees it sleeping.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer_sleeping_.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            wake_up_.notify_one();
+        }
+    }
+
+    void ResultSink::writer_loop() {
+        Message message;
+        for (;;) {
+            if (!queue_->try_pop(&message)) {
+                if (stop_.load()) return;
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                writer_sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                const bool popped = queue_->try_pop(&message);
+                if (!popped && !stop_.load()) wake_up_.wait_for(lock, std::chrono::milliseconds(100));
+                writer_sleeping_.store(false, std::memory_order_relaxed);
+                if (!popped) continue;
+            }
+
+            File &file = *message.file;
+            if (!message.block.empty() && file.error.empty()
+                && std::fwrite(message.block.data(), 1, message.block.size(), file.out) != message.block.size()) {
+                file.error = std::strerror(errno);
+            }
+            if (message.closed) {
+                if (std::fclose(file.out) != 0 && file.error.empty()) file.error = std::strerror(errno);
+                file.out = nullptr;
+                message.closed->set_value();
+            }
+            message = Message();
+        }
+    }
+}
@@ -0,0 +1,141 @@
+// Writing of the result files on a background thread : the experiments format their rows into large blocks, handed
+// to the writer thread through a lock-free queue, so that the threads running the sweeps never wait for the disk.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace rootba_povar {
+
+    /** \brief Bounded queue of several producers and consumers without locks
+     *         (Vyukov's) : every cell holds a sequence number telling whether
+     *         it is free to push or ready to pop at the current position.
+     */
+    template <typename T>
+    class BoundedQueue {
+    public:
+        /** \brief \param capacity Rounded up to a power of 2, of at least 2. */
+        explicit BoundedQueue(size_t capacity) : mask_(PowerOf2(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+            for (size_t i = 0; i <= mask_; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+        /** \brief False, leaving value, if the queue is full. */
+        bool try_push(T &&value) {
+            Cell *cell;
+            size_t position = enqueue_position_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+                if (difference == 0) {
+                    if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = enqueue_position_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(value);
+            cell->sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** \brief False if the queue is empty. */
+        bool try_pop(T *value) {
+            Cell *cell;
+            size_t position = dequeue_position_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[position & mask_];
+                const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+                if (difference == 0) {
+                    if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+                } else if (difference < 0) {
+                    return false;
+                } else {
+                    position = dequeue_position_.load(std::memory_order_relaxed);
+                }
+            }
+            *value = std::move(cell->value);
+            cell->sequence.store(position + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        // The positions index the cells modulo their number, and a cell of a single one would be pushed twice.
+        static size_t PowerOf2(size_t capacity) {
+            size_t power = 2;
+            while (power < capacity) power *= 2;
+            return power;
+        }
+
+        const size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+        alignas(64) std::atomic<size_t> enqueue_position_{0};
+        alignas(64) std::atomic<size_t> dequeue_position_{0};
+    };
+
+    /** \brief Writes the blocks of several files on its own thread, in the
+     *         order each file was given them.
+     *
+     *  The files are opened by the calling thread, so that a file that cannot
+     *  be created fails at once, then only the writer thread touches them :
+     *  write() only queues the block, waiting for room if the disk is far
+     *  behind, and close() waits for the blocks of the file to be written.
+     */
+    class ResultSink {
+    public:
+        struct File;  // A file being written, shared by its writer and the queued blocks.
+
+        /** \brief Starts the writer thread.  \param capacity Queued blocks, see BoundedQueue. */
+        explicit ResultSink(size_t capacity = 256);
+
+        /** \brief Writes the queued blocks and stops the writer thread. */
+        ~ResultSink();
+
+        ResultSink(const ResultSink &) = delete;
+        ResultSink &operator=(const ResultSink &) = delete;
+
+        /** \brief Creates the file at path.  Null, with a message, if it cannot. */
+        std::shared_ptr<File> open(const std::string &path);
+
+        /** \brief Queues block, to be appended to file. */
+        void write(const std::shared_ptr<File> &file, std::string block);
+
+        /** \brief Waits for the blocks of file to be written and closes it.
+         *         False, with a message, on the first I/O error of the file.
+         */
+        bool close(const std::shared_ptr<File> &file);
+
+        /** \brief The sink shared by all the experiments of the program. */
+        static ResultSink &global();
+
+    private:
+        struct Message;
+
+        void push(Message message);
+        void writer_loop();
+
+        std::unique_ptr<BoundedQueue<Message>> queue_;
+
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_up_;
+        std::atomic<bool> writer_sleeping_{false};
+        std::atomic<bool> stop_{false};
+        std::thread writer_;
+    };
+}
@@ -0,0 +1,141 @@
+#include "result_writer.hpp"
+#include "binary_io.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace rootba_povar {
+
+    namespace {
+        const char kColumnarMagic[8] = {'A', 'C', 'O', 'L', 'S', '0', '0', '2'};
+        const uint64_t kByteOrderMark = 0x0102030405060708;
+        const std::string kColumnarExtension = ".acol";
+    }
+
+    const char *ResultExtension(ResultFormat format) {
+        return format == ResultFormat::Columnar ? ".acol" : ".txt";
+    }
+
+    ResultFormat ResultFormatOfPath(const std::string &path) {
+        const bool columnar = path.size() >= kColumnarExtension.size()
+                              && path.compare(path.size() - kColumnarExtension.size(), kColumnarExtension.size(), kColumnarExtension) == 0;
+        return columnar ? ResultFormat::Columnar : ResultFormat::Text;
+    }
+
+    bool ResultWriter::open(const std::string &path, const std::string &columns) {
+        if (open_) close();
+        path_ = path;
+        format_ = ResultFormatOfPath(path);
+        rows_valid_ = true;
+        column_ = 0;
+        names_.clear();
+        std::stringstream header(columns);
+        for (std::string name; std::getline(header, name, '\t');) {
+            if (!name.empty() && name.back() == '\n') name.pop_back();
+            names_.push_back(name);
+        }
+        values_.assign(format_ == ResultFormat::Columnar ? names_.size() : 0, std::vector<double>());
+
+        file_ = sink_->open(path);
+        if (!file_) return open_ = false;
+        block_.clear();
+        if (format_ == ResultFormat::Text) {
+            block_.reserve(kBlockSize + 4096);
+            block_ += columns;
+        }
+        return open_ = true;
+    }
+
+    // As operator<< of the streams, that is printf's "%g".
+    void ResultWriter::append_real(double value) {
+        char text[32];
+        block_.append(text, std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6).ptr);
+    }
+
+    void ResultWriter::append_integer(long long value) {
+        char text[24];
+        block_.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+    }
+
+    void ResultWriter::append_integer(unsigned long long value) {
+        char text[24];
+        block_.append(text, std::to_chars(text, text + sizeof(text), value).ptr);
+    }
+
+    void ResultWriter::end_row() {
+        if (column_ != names_.size() && rows_valid_) {
+            std::cerr << path_ << " : a row has " << column_ << " values for " << names_.size() << " columns" << std::endl;
+            rows_valid_ = false;
+        }
+        if (format_ == ResultFormat::Text) {
+            block_ += '\n';
+            if (block_.size() >= kBlockSize) {
+                sink_->write(file_, std::move(block_));
+                block_ = std::string();
+                block_.reserve(kBlockSize + 4096);
+            }
+        } else {
+            // Keep the columns the same length, whatever the row.
+            for (size_t column = column_; column < values_.size(); ++column) values_[column].push_back(0);
+        }
+        column_ = 0;
+    }
+
+    bool ResultWriter::close() {
+        if (!open_) return false;
+        open_ = false;
+        if (format_ == ResultFormat::Columnar) {
+            const uint64_t num_rows = values_.empty() ? 0 : values_.front().size();
+            std::ostringstream header;
+            header.write(kColumnarMagic, sizeof(kColumnarMagic));
+            WriteBinary(header, kByteOrderMark);
+            WriteBinary(header, uint64_t(names_.size()));
+            WriteBinary(header, num_rows);
+            for (const std::string &name : names_) WriteBinary(header, name);
+            block_ = header.str();
+            block_.resize((block_.size() + 7) / 8 * 8, '\0');
+            block_.reserve(block_.size() + names_.size() * num_rows * sizeof(double));
+            for (const std::vector<double> &column : values_) {
+                block_.append(reinterpret_cast<const char *>(column.data()), column.size() * sizeof(double));
+            }
+            values_.clear();
+        }
+        sink_->write(file_, std::move(block_));
+        block_ = std::string();
+        const bool written = sink_->close(file_);
+        file_.reset();
+        return written && rows_valid_;
+    }
+
+    bool ReadColumnarResults(const std::string &path, std::vector<std::string> *names, std::vector<std::vector<double>> *columns) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(kColumnarMagic)] = {};
+        uint64_t byte_order = 0, num_columns = 0, num_rows = 0;
+        in.read(magic, sizeof(magic));
+        ReadBinary(in, &byte_order);
+        ReadBinary(in, &num_columns);
+        ReadBinary(in, &num_rows);
+        if (!in || !std::equal(magic, magic + sizeof(magic), kColumnarMagic)) {
+            std::cerr << path << " is not a columnar result file" << std::endl;
+            return false;
+        }
+        if (byte_order != kByteOrderMark) {
+            std::cerr << path << " was written in another byte order" << std::endl;
+            return false;
+        }
+        names->resize(num_columns);
+        for (std::string &name : *names) ReadBinary(in, &name);
+        in.seekg((8 - in.tellg() % 8) % 8, std::ios::cur);
+        columns->assign(num_columns, std::vector<double>(num_rows));
+        for (std::vector<double> &column : *columns) {
+            in.read(reinterpret_cast<char *>(column.data()), num_rows * sizeof(double));
+        }
+        if (!in) {
+            std::cerr << "Truncated columnar result file " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
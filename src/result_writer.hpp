@@ -0,0 +1,114 @@
+// Result files of the experiments : tab-separated text, or binary columns,
+// memory-mapped by read_columns of python_plots/utils.py without parsing any text.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "result_sink.hpp"
+
+namespace rootba_povar {
+
+    /** \brief Format of a result file, given by the extension of its path.
+     *
+     *  Columnar files (".acol") are, in the byte order of the machine writing
+     *  them (little-endian on x86 and ARM) :
+     *    - the magic "ACOLS002" (8 bytes),
+     *    - the uint64 0x0102030405060708, whose bytes tell the byte order,
+     *    - the number of columns and the number of rows (2 uint64),
+     *    - for every column, the length of its name (uint64) then its name,
+     *    - zeros up to a multiple of 8 bytes from the start of the file,
+     *    - the values, as float64, one column after the other.
+     *  Integers are written as float64, NaN where a loss has no camera.
+     */
+    enum class ResultFormat { Text, Columnar };
+
+    /** \brief ".txt" or ".acol". */
+    const char *ResultExtension(ResultFormat format);
+
+    /** \brief Columnar for the paths ending with ".acol", text otherwise. */
+    ResultFormat ResultFormatOfPath(const std::string &path);
+
+    /** \brief Writes the rows of a result file, value by value.
+     *
+     *  Text files are written as the experiments always wrote them, values
+     *  formatted as by operator<< of the streams and separated by tabs.  The
+     *  rows are gathered in blocks of kBlockSize bytes, written by the writer
+     *  thread of a ResultSink.  Columnar files are written by close(), once
+     *  all the rows are known.
+     */
+    class ResultWriter {
+    public:
+        static constexpr size_t kBlockSize = size_t(1) << 20;
+
+        explicit ResultWriter(ResultSink &sink = ResultSink::global()) : sink_(&sink) {}
+        ~ResultWriter() { close(); }
+
+        ResultWriter(const ResultWriter &) = delete;
+        ResultWriter &operator=(const ResultWriter &) = delete;
+
+        /** \brief Opens the file at path, in the format of its extension.
+         *
+         *  \param columns The header of the text file, the names of the columns
+         *         separated by tabs and ending with a newline.
+         *  False, with a message, if the file cannot be created.
+         */
+        bool open(const std::string &path, const std::string &columns);
+
+        bool is_open() const { return open_; }
+
+        /** \brief Next value of the current row. */
+        template <typename T>
+        ResultWriter &operator<<(T value) {
+            static_assert(std::is_arithmetic<T>::value, "Result files only hold numbers.");
+            if (format_ == ResultFormat::Text) {
+                if (column_ > 0) block_ += '\t';
+                append(value);
+            } else if (column_ < values_.size()) {
+                values_[column_].push_back(static_cast<double>(value));
+            }
+            ++column_;
+            return *this;
+        }
+
+        /** \brief Ends the current row, which must have a value for every column. */
+        void end_row();
+
+        /** \brief Writes what remains and waits for the file to be written.
+         *         False, with a message, if a row had a wrong number of values
+         *         or the file could not be written.
+         */
+        bool close();
+
+    private:
+        template <typename T>
+        void append(T value) {
+            if (std::is_floating_point<T>::value) append_real(static_cast<double>(value));
+            else if (std::is_signed<T>::value) append_integer(static_cast<long long>(value));
+            else append_integer(static_cast<unsigned long long>(value));
+        }
+        void append_real(double value);
+        void append_integer(long long value);
+        void append_integer(unsigned long long value);
+
+        ResultSink *sink_;
+        std::shared_ptr<ResultSink::File> file_;
+        std::string path_;
+        ResultFormat format_ = ResultFormat::Text;
+        bool open_ = false, rows_valid_ = true;
+        std::string block_;  // Of the text file, not handed to the sink yet.
+        std::vector<std::string> names_;
+        std::vector<std::vector<double>> values_;  // Of the columnar file, column by column.
+        size_t column_ = 0;  // Of the next value of the current row.
+    };
+
+    /** \brief Reads a columnar file written by ResultWriter.  False, with a
+     *         message, if it is not one.
+     */
+    bool ReadColumnarResults(const std::string &path, std::vector<std::string> *names, std::vector<std::vector<double>> *columns);
+}
@@ -0,0 +1,74 @@
+#include "shards.hpp"
+
+#include <sstream>
+
+namespace rootba_povar {
+
+    namespace {
+        const char kShardMagic[8] = {'A', 'C', 'S', 'H', 'A', 'R', 'D', '2'};  // 2 since the seed is in the header.
+    }
+
+    std::vector<size_t> ShardPoints(size_t num_points, const Shard &shard) {
+        std::vector<size_t> points;
+        for (size_t point = shard.index; point < num_points; point += shard.count) points.push_back(point);
+        return points;
+    }
+
+    std::string ShardPath(const std::string &path, const Shard &shard) {
+        std::stringstream shard_path;
+        shard_path << path << ".shard" << shard.index << "of" << shard.count;
+        return shard_path.str();
+    }
+
+    void WriteShardHeader(std::ostream &out, const ShardHeader &header) {
+        out.write(kShardMagic, sizeof(kShardMagic));
+        WriteBinary(out, header.experiment);
+        WriteBinary(out, header.path);
+        WriteBinary(out, header.columns);
+        WriteBinary(out, header.num_cams);
+        WriteBinary(out, header.seed);
+        WriteBinary(out, header.index);
+        WriteBinary(out, header.count);
+    }
+
+    bool ReadShardHeader(std::istream &in, ShardHeader *header) {
+        char magic[sizeof(kShardMagic)] = {};
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(magic, magic + sizeof(magic), kShardMagic)) {
+            std::cerr << "Not a partial file of a sharded sweep" << std::endl;
+            return false;
+        }
+        ReadBinary(in, &header->experiment);
+        ReadBinary(in, &header->path);
+        ReadBinary(in, &header->columns);
+        ReadBinary(in, &header->num_cams);
+        ReadBinary(in, &header->seed);
+        ReadBinary(in, &header->index);
+        ReadBinary(in, &header->count);
+        return bool(in);
+    }
+
+    bool OpenSweepFile(ResultWriter *results, std::ofstream *partial, ShardHeader header, const Shard &shard) {
+        if (!shard.enabled()) return results->open(header.path, header.columns);
+        const std::string path = ShardPath(header.path, shard);
+        partial->open(path, std::ios::binary);
+        if (!*partial) {
+            std::cerr << "Errors opening file for writing : " << path << std::endl;
+            return false;
+        }
+        header.index = shard.index;
+        header.count = shard.count;
+        WriteShardHeader(*partial, header);
+        return true;
+    }
+
+    bool CloseSweepFile(ResultWriter *results, std::ofstream *partial, const std::string &path, const Shard &shard) {
+        if (!shard.enabled()) return results->close();
+        partial->close();
+        if (!*partial) {
+            std::cerr << "Errors writing file : " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
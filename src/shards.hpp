@@ -0,0 +1,147 @@
+// Sharded sweeps : each process runs the points of one shard of a sweep and writes their accumulators in a partial
+// file, then merge_shards writes the result file of the whole sweep from the partial files of all the shards.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "binary_io.hpp"
+#include "result_writer.hpp"
+
+namespace rootba_povar {
+
+    /** \brief The part of a sweep run by one process : the points whose index
+     *         is index modulo count, so that every shard gets cheap and costly
+     *         points alike.  A count of 1, the default, is the whole sweep.
+     */
+    struct Shard {
+        size_t index = 0, count = 1;
+
+        bool enabled() const { return count > 1; }
+    };
+
+    /** \brief The points of 0 to num_points - 1 run by shard. */
+    std::vector<size_t> ShardPoints(size_t num_points, const Shard &shard);
+
+    /** \brief path followed by ".shard<index>of<count>", the partial file of shard. */
+    std::string ShardPath(const std::string &path, const Shard &shard);
+
+    /** \brief What a partial file holds, before its records. */
+    struct ShardHeader {
+        std::string experiment;  // Names the accumulator of the records and how to write them.
+        std::string path;        // Of the result file.
+        std::string columns;     // First line of the result file.
+        uint64_t num_cams = 0;
+        uint64_t seed = 0;       // Of the random streams of the reconstructions.
+        uint64_t index = 0, count = 1;
+    };
+
+    void WriteShardHeader(std::ostream &out, const ShardHeader &header);
+
+    /** \brief False, with a message, if in is not a partial file. */
+    bool ReadShardHeader(std::istream &in, ShardHeader *header);
+
+    /** \brief Opens the file of a sweep : its result file results, with the
+     *         columns header.columns, or with shard the partial file of the
+     *         shard, starting with header.  False, with a message, if it cannot.
+     */
+    bool OpenSweepFile(ResultWriter *results, std::ofstream *partial, ShardHeader header, const Shard &shard);
+
+    /** \brief Closes the file opened by OpenSweepFile, at path with shard.
+     *         False, with a message, if it was not entirely written.
+     */
+    bool CloseSweepFile(ResultWriter *results, std::ofstream *partial, const std::string &path, const Shard &shard);
+
+    /** \brief Writes the total of the num_reconstructions reconstructions run at
+     *         point, whose parameter (the translation range, ...) is parameter.
+     *         Accumulator has a save(std::ostream &) member.
+     */
+    template <typename Accumulator>
+    void WriteShardRecord(std::ostream &out, size_t point, double parameter, size_t num_reconstructions, const Accumulator &total) {
+        WriteBinary(out, uint64_t(point));
+        WriteBinary(out, parameter);
+        WriteBinary(out, uint64_t(num_reconstructions));
+        total.save(out);
+    }
+
+    /** \brief Writes the result file of a sharded sweep from the partial files
+     *         of all its shards.
+     *
+     *  \param empty An accumulator of the records, whose load(std::istream &)
+     *         member reads one written by its save.
+     *  \param write_row Called as write_row(out, header, parameter, total,
+     *         num_reconstructions), out being the ResultWriter of the result
+     *         file, for every point, in increasing point order.
+     *
+     *  The points are written as the unsharded sweep would : the result file is
+     *  the same.  Fails, with a message, if the files are not the partial files
+     *  of all the shards of one sweep, with the same seed.
+     */
+    template <typename Accumulator, typename WriteRow>
+    bool MergeShards(const std::vector<std::string> &paths, const Accumulator &empty, const WriteRow &write_row) {
+        struct Record {
+            uint64_t point;
+            double parameter;
+            uint64_t num_reconstructions;
+            Accumulator total;
+        };
+        std::vector<Record> records;
+        std::vector<bool> shard_found;
+        ShardHeader header;
+        for (const std::string &path : paths) {
+            std::ifstream in(path, std::ios::binary);
+            ShardHeader shard_header;
+            if (!in || !ReadShardHeader(in, &shard_header)) {
+                std::cerr << "Cannot read the partial file " << path << std::endl;
+                return false;
+            }
+            if (shard_found.empty()) {
+                header = shard_header;
+                shard_found.assign(header.count, false);
+            } else if (shard_header.experiment != header.experiment || shard_header.path != header.path
+                       || shard_header.columns != header.columns || shard_header.num_cams != header.num_cams
+                       || shard_header.seed != header.seed || shard_header.count != header.count) {
+                std::cerr << path << " is not a shard of the same sweep as " << paths.front() << std::endl;
+                return false;
+            }
+            if (shard_header.index >= header.count || shard_found[shard_header.index]) {
+                std::cerr << path << " : shard " << shard_header.index << " of " << header.count << " is repeated" << std::endl;
+                return false;
+            }
+            shard_found[shard_header.index] = true;
+
+            while (in.peek() != std::ifstream::traits_type::eof()) {
+                Record record{0, 0, 0, empty};
+                ReadBinary(in, &record.point);
+                ReadBinary(in, &record.parameter);
+                ReadBinary(in, &record.num_reconstructions);
+                record.total.load(in);
+                if (!in) {
+                    std::cerr << "Truncated partial file " << path << std::endl;
+                    return false;
+                }
+                records.push_back(record);
+            }
+        }
+        if (std::find(shard_found.begin(), shard_found.end(), false) != shard_found.end()) {
+            std::cerr << "Missing shards of " << header.path << std::endl;
+            return false;
+        }
+
+        std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) { return a.point < b.point; });
+        ResultWriter out;
+        if (!out.open(header.path, header.columns)) return false;
+        for (const Record &record : records) {
+            write_row(out, header, record.parameter, record.total, size_t(record.num_reconstructions));
+        }
+        if (!out.close()) return false;
+        std::cout << "Merged " << paths.size() << " shards, " << records.size() << " points, into " << header.path << std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,139 @@
+#include "streaming_statistics.hpp"
+#include "binary_io.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rootba_povar {
+
+    namespace {
+        const double kGamma = (1 + StreamingStatistics::kRelativeAccuracy) / (1 - StreamingStatistics::kRelativeAccuracy);
+        const double kLogGamma = std::log(kGamma);
+
+        // Bucket i holds the losses in (kGamma^(i - 1), kGamma^i].
+        int Bucket(double loss) {
+            return static_cast<int>(std::ceil(std::log(loss) / kLogGamma));
+        }
+    }
+
+    void StreamingStatistics::add(double loss) {
+        if (!std::isfinite(loss)) {
+            ++non_finite_count_;
+            return;
+        }
+
+        ++count_;
+        const double delta = loss - mean_;
+        mean_ += delta / count_;
+        m2_ += delta * (loss - mean_);
+
+        if (loss < std::numeric_limits<double>::min()) {
+            ++zero_count_;
+            return;
+        }
+        const int bucket = Bucket(loss);
+        if (buckets_.empty()) {
+            first_bucket_ = bucket;
+            buckets_.assign(1, 0);
+        } else if (bucket < first_bucket_) {
+            buckets_.insert(buckets_.begin(), first_bucket_ - bucket, 0);
+            first_bucket_ = bucket;
+        } else if (bucket - first_bucket_ >= static_cast<int>(buckets_.size())) {
+            buckets_.resize(bucket - first_bucket_ + 1, 0);
+        }
+        ++buckets_[bucket - first_bucket_];
+    }
+
+    void StreamingStatistics::merge(const StreamingStatistics &other) {
+        non_finite_count_ += other.non_finite_count_;
+        zero_count_ += other.zero_count_;
+
+        if (other.count_ > 0) {
+            if (count_ == 0) {
+                mean_ = other.mean_;
+                m2_ = other.m2_;
+            } else {
+                const double count = double(count_) + double(other.count_);
+                const double delta = other.mean_ - mean_;
+                mean_ += delta * other.count_ / count;
+                m2_ += other.m2_ + delta * delta * count_ * other.count_ / count;
+            }
+            count_ += other.count_;
+        }
+
+        if (other.buckets_.empty()) return;
+        if (buckets_.empty()) {
+            first_bucket_ = other.first_bucket_;
+            buckets_ = other.buckets_;
+            return;
+        }
+        const int first_bucket = std::min(first_bucket_, other.first_bucket_);
+        const int end_bucket = std::max(first_bucket_ + static_cast<int>(buckets_.size()),
+                                        other.first_bucket_ + static_cast<int>(other.buckets_.size()));
+        if (first_bucket < first_bucket_) {
+            buckets_.insert(buckets_.begin(), first_bucket_ - first_bucket, 0);
+            first_bucket_ = first_bucket;
+        }
+        buckets_.resize(end_bucket - first_bucket_, 0);
+        for (size_t i = 0; i < other.buckets_.size(); ++i) {
+            buckets_[other.first_bucket_ - first_bucket_ + i] += other.buckets_[i];
+        }
+    }
+
+    double StreamingStatistics::stddev() const {
+        return std::sqrt(variance());
+    }
+
+    double StreamingStatistics::quantile(double q) const {
+        if (count_ == 0) return std::numeric_limits<double>::quiet_NaN();
+
+        const double rank = q * (count_ - 1);
+        double cumulative = zero_count_;
+        if (cumulative > rank) return 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            cumulative += buckets_[i];
+            if (cumulative > rank) {
+                // The value of the bucket within a relative error kRelativeAccuracy of all its losses.
+                return 2 * std::pow(kGamma, first_bucket_ + static_cast<int>(i)) / (kGamma + 1);
+            }
+        }
+        return 2 * std::pow(kGamma, first_bucket_ + static_cast<int>(buckets_.size()) - 1) / (kGamma + 1);
+    }
+
+    void StreamingStatistics::save(std::ostream &out) const {
+        WriteBinary(out, uint64_t(count_));
+        WriteBinary(out, uint64_t(non_finite_count_));
+        WriteBinary(out, mean_);
+        WriteBinary(out, m2_);
+        WriteBinary(out, uint64_t(zero_count_));
+        WriteBinary(out, int32_t(first_bucket_));
+        WriteBinary(out, buckets_);
+    }
+
+    void StreamingStatistics::load(std::istream &in) {
+        uint64_t count = 0, non_finite_count = 0, zero_count = 0;
+        int32_t first_bucket = 0;
+        ReadBinary(in, &count);
+        ReadBinary(in, &non_finite_count);
+        ReadBinary(in, &mean_);
+        ReadBinary(in, &m2_);
+        ReadBinary(in, &zero_count);
+        ReadBinary(in, &first_bucket);
+        ReadBinary(in, &buckets_);
+        count_ = count;
+        non_finite_count_ = non_finite_count;
+        zero_count_ = zero_count;
+        first_bucket_ = first_bucket;
+    }
+
+    std::string StatisticsColumns(const std::string &name) {
+        return "\t" + name + "_std\t" + name + "_p50\t" + name + "_p90";
+    }
+
+    void WriteStatistics(ResultWriter &out, const StreamingStatistics &statistics) {
+        out << statistics.stddev()
+            << statistics.quantile(0.5)
+            << statistics.quantile(0.9);
+    }
+}
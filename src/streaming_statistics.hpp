@@ -0,0 +1,76 @@
+// Statistics of a stream of losses in constant memory, mergeable across threads and shards.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "result_writer.hpp"
+
+namespace rootba_povar {
+
+    /** \brief Mean, variance and quantiles of a stream of non negative losses.
+     *
+     *  The mean and variance are updated with Welford's algorithm and merged with
+     *  the pairwise formula of Chan et al.  The quantiles come from a histogram
+     *  with logarithmic buckets, (1 + a) / (1 - a) wide, a being the relative
+     *  accuracy, as in DDSketch (Masson et al., VLDB 2019) : any quantile is
+     *  within a relative error a of an actual loss of the stream.  Only the range
+     *  of buckets between the smallest and the largest loss is stored, about
+     *  1200 buckets for losses spread over 10 orders of magnitude.
+     *
+     *  Unlike P² or t-digest, merging two histograms is exact, so the statistics
+     *  of a sweep do not depend on how it was split over threads or shards.
+     *  NaN and infinite losses, from degenerate reconstructions, are only
+     *  counted.
+     */
+    class StreamingStatistics {
+    public:
+        static constexpr double kRelativeAccuracy = 0.01;
+
+        void add(double loss);
+
+        /** \brief Adds the losses of other, as if they had been added to this one. */
+        void merge(const StreamingStatistics &other);
+
+        size_t count() const { return count_; }  // Number of finite losses.
+        size_t non_finite_count() const { return non_finite_count_; }
+        double mean() const { return mean_; }
+        double variance() const { return count_ > 1 ? m2_ / (count_ - 1) : 0; }  // Unbiased.
+        double stddev() const;
+
+        /** \brief The q quantile of the finite losses, q in [0, 1], NaN if there are none. */
+        double quantile(double q) const;
+
+        /** \brief The histogram : bucket i counts the losses in
+         *         (gamma^(i - 1), gamma^i], for i from first_bucket().
+         */
+        int first_bucket() const { return first_bucket_; }
+        const std::vector<uint32_t> &buckets() const { return buckets_; }
+        size_t zero_count() const { return zero_count_; }
+
+        /** \brief Writes the statistics with WriteBinary, read back by load. */
+        void save(std::ostream &out) const;
+        void load(std::istream &in);
+
+    private:
+        size_t count_ = 0;
+        size_t non_finite_count_ = 0;
+        double mean_ = 0;
+        double m2_ = 0;  // Sum of the squared differences to the mean.
+
+        size_t zero_count_ = 0;  // Losses too small for the buckets.
+        int first_bucket_ = 0;
+        std::vector<uint32_t> buckets_;
+    };
+
+    /** \brief Header of the columns written by WriteStatistics, "\tname_std\tname_p50\tname_p90". */
+    std::string StatisticsColumns(const std::string &name);
+
+    /** \brief Writes the standard deviation, median and 90th percentile of statistics, the columns of StatisticsColumns. */
+    void WriteStatistics(ResultWriter &out, const StreamingStatistics &statistics);
+}
@@ -0,0 +1,63 @@
+#include "sweep.hpp"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace rootba_povar {
+
+    namespace {
+        // Stream of the reconstruction run by this thread.  The first word of the stream is 0 for the draws of the
+        // reconstruction itself and camera + 1 for the draws of a camera.
+        thread_local Philox4x32 experiment_rng;
+        thread_local uint32_t current_point = 0, current_reconstruction = 0;
+    }
+
+    Philox4x32 &ExperimentRng() {
+        return experiment_rng;
+    }
+
+    void SeedExperimentRng(uint64_t seed, uint64_t point, uint64_t reconstruction) {
+        current_point = uint32_t(point);
+        current_reconstruction = uint32_t(reconstruction);
+        experiment_rng.seed(seed);
+        experiment_rng.set_stream(0, current_reconstruction, current_point);
+    }
+
+    void UseCameraStream(size_t camera) {
+        experiment_rng.set_stream(uint32_t(camera) + 1, current_reconstruction, current_point);
+    }
+
+    double UniformRandom() {
+        return std::uniform_real_distribution<double>(0, 1)(experiment_rng);
+    }
+
+    bool ConfidenceReached(const StreamingStatistics &statistics, const AdaptiveStopping &stopping) {
+        if (statistics.count() < 2) return false;
+        return stopping.z * statistics.stddev() / std::sqrt(double(statistics.count()))
+               <= stopping.relative_half_width * std::abs(statistics.mean());
+    }
+
+    std::string AdaptiveStoppingTag(const AdaptiveStopping &stopping) {
+        if (!stopping.enabled()) return "";
+        std::stringstream tag;
+        tag << "_CI" << stopping.relative_half_width;
+        return tag.str();
+    }
+
+    std::string GridRefinementTag(const GridRefinement &refinement) {
+        if (!refinement.enabled()) return "";
+        std::stringstream tag;
+        tag << "_Refined" << refinement.max_points;
+        return tag.str();
+    }
+
+    double LogChange(double a, double b) {
+        const bool a_positive = a > 0 && std::isfinite(a), b_positive = b > 0 && std::isfinite(b);
+        if (!a_positive || !b_positive) {
+            return a_positive != b_positive ? std::numeric_limits<double>::infinity() : 0;
+        }
+        return std::abs(std::log10(a / b));
+    }
+}
@@ -0,0 +1,371 @@
+// Monte Carlo sweeps of the experiments : many random reconstructions at each point of a grid of parameters,
+// spread over all the cores.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+#include "philox.hpp"
+#include "streaming_statistics.hpp"
+#include "thread_pool.hpp"
+
+namespace rootba_povar {
+
+    /** \brief The generator behind the random helpers of utils_for_testing, one per thread. */
+    Philox4x32 &ExperimentRng();
+
+    /** \brief Moves the generator of the calling thread to the stream of one
+     *         reconstruction of a sweep.
+     *
+     *  The draws of a reconstruction only depend on (seed, point, reconstruction),
+     *  not on the thread running it or on the reconstructions it ran before.
+     */
+    void SeedExperimentRng(uint64_t seed, uint64_t point, uint64_t reconstruction);
+
+    /** \brief Moves the generator of the calling thread to the stream of one
+     *         camera of the current reconstruction.
+     *
+     *  Each camera can then be regenerated alone, whatever the number of numbers
+     *  drawn for the cameras before it.  The draws of the reconstruction itself
+     *  (projective distortion, focal lengths) come before the first call.
+     */
+    void UseCameraStream(size_t camera);
+
+    /** \brief Uniform random number in [0, 1) from ExperimentRng(). */
+    double UniformRandom();
+
+    /** \brief When a sweep may stop drawing reconstructions at a point before
+     *         its maximum number of reconstructions.
+     *
+     *  A point stops once it has min_reconstructions and the confidence
+     *  intervals of its mean K costs are narrow enough : z * std / sqrt(n) at
+     *  most relative_half_width * mean.  With relative_half_width 0, the
+     *  default, every point runs the maximum number of reconstructions.
+     */
+    struct AdaptiveStopping {
+        size_t min_reconstructions = 32;
+        double relative_half_width = 0;
+        double z = 1.96;  // 95% confidence.
+
+        bool enabled() const { return relative_half_width > 0; }
+
+        /** \brief Number of reconstructions every point runs, out of max_reconstructions. */
+        size_t min_reconstructions_of(size_t max_reconstructions) const {
+            return enabled() ? std::max<size_t>(1, std::min(min_reconstructions, max_reconstructions)) : max_reconstructions;
+        }
+    };
+
+    /** \brief Whether the confidence interval on the mean of statistics is
+     *         within the relative half width of stopping.  False with less than
+     *         2 finite losses.
+     */
+    bool ConfidenceReached(const StreamingStatistics &statistics, const AdaptiveStopping &stopping);
+
+    /** \brief "_CI<relative_half_width>" for the names of the files of an adaptive sweep, empty otherwise. */
+    std::string AdaptiveStoppingTag(const AdaptiveStopping &stopping);
+
+    /** \brief Runs random reconstructions at each of the parameter points of
+     *         points, on all the threads of pool, until each point has converged.
+     *
+     *  Points are identified by their index in a grid of parameters, the
+     *  random streams of their reconstructions only depend on it.
+     *  \param empty The accumulator of a work item before it runs.  Accumulator
+     *         is copyable and has a merge(const Accumulator &) member adding the
+     *         losses of another accumulator.
+     *  \param run_reconstruction Called as run_reconstruction(point, reconstruction,
+     *         &accumulator) for every work item, after seeding ExperimentRng for it.
+     *  \param converged Called as converged(total) on the calling thread, true
+     *         when the reconstructions merged in total are enough for the point.
+     *  \param write_point Called as write_point(point, total, num_reconstructions)
+     *         on the calling thread, in the order of points, total being the
+     *         merge of the accumulators of the num_reconstructions reconstructions
+     *         run at the point.
+     *  \param pool The threads to use, ThreadPool::global() if null.
+     *  \param checkpoint If not null, a SweepCheckpoint<Accumulator> : the points
+     *         it holds are not run again but written from their saved totals,
+     *         and every other point is saved to it once over.
+     *
+     *  A point first runs min_reconstructions reconstructions, then doubles them
+     *  until converged or max_reconstructions.  Every work item fills an
+     *  accumulator of the thread running it, starting from empty, merged into the
+     *  total of its point in reconstruction order, and converged is only asked at
+     *  these fixed counts, so the totals and the numbers of reconstructions, and
+     *  the files written from them, are the same whatever the number of threads.
+     *  The accumulators are reused, only a few per thread being alive at once
+     *  whatever the number of work items.  Points are run in groups holding
+     *  enough work items to keep all the threads busy, the unconverged points of
+     *  a group running their next reconstructions together.
+     */
+    template <typename Accumulator, typename RunReconstruction, typename Converged, typename WritePoint,
+              typename Checkpoint = NoCheckpoint>
+    void RunAdaptiveSweep(const std::vector<size_t> &points,
+                          size_t min_reconstructions,
+                          size_t max_reconstructions,
+                          uint64_t seed,
+                          const Accumulator &empty,
+                          const RunReconstruction &run_reconstruction,
+                          const Converged &converged,
+                          const WritePoint &write_point,
+                          ThreadPool *pool = nullptr,
+                          Checkpoint *checkpoint = nullptr) {
+        if (!pool) pool = &ThreadPool::global();
+        if (max_reconstructions == 0) return;
+
+        // Indices in points of the points to run, the others being resumed from the checkpoint.
+        std::vector<size_t> to_run;
+        for (size_t i = 0; i < points.size(); ++i) {
+            if (!checkpoint || !checkpoint->contains(points[i])) to_run.push_back(i);
+        }
+        size_t num_written = 0;  // Points are written in their order, the resumed ones before the next point run.
+        auto write_resumed_points = [&](size_t end) {
+            for (; num_written < end; ++num_written) {
+                Accumulator total = empty;
+                size_t num_reconstructions = 0;
+                if (checkpoint->take(points[num_written], &total, &num_reconstructions)) {
+                    write_point(points[num_written], total, num_reconstructions);
+                }
+            }
+        };
+
+        const size_t first_reconstructions = std::max<size_t>(1, std::min(min_reconstructions, max_reconstructions));
+        const size_t items_per_group = std::max<size_t>(first_reconstructions, 16 * pool->num_threads());
+        const size_t points_per_group = items_per_group / first_reconstructions;
+
+        struct WorkItem {
+            size_t point;  // In the group.
+            size_t reconstruction;
+        };
+        std::vector<WorkItem> items;
+        std::vector<Accumulator> totals;
+        std::vector<size_t> num_reconstructions, active_points;
+        for (size_t first_point = 0; first_point < to_run.size(); first_point += points_per_group) {
+            const size_t group_points = std::min(points_per_group, to_run.size() - first_point);
+            totals.assign(group_points, empty);
+            num_reconstructions.assign(group_points, 0);
+            active_points.resize(group_points);
+            for (size_t p = 0; p < group_points; ++p) active_points[p] = p;
+
+            while (!active_points.empty()) {
+                items.clear();
+                for (size_t p : active_points) {
+                    const size_t done = num_reconstructions[p];
+                    const size_t next = done == 0 ? first_reconstructions : std::min(2 * done, max_reconstructions);
+                    for (size_t r = done; r < next; ++r) items.push_back({p, r});
+                    num_reconstructions[p] = next;
+                }
+
+                // Each thread claims the items in increasing order and runs them into an accumulator of its own, merged
+                // into the total of its point once the items before it are.  Items are in point then reconstruction
+                // order, so the totals are merged in reconstruction order, and only the items finished while an
+                // earlier one still runs wait in finished.
+                std::atomic<size_t> next_item{0};
+                std::mutex merge_mutex;
+                size_t num_merged = 0;
+                std::map<size_t, std::unique_ptr<Accumulator>> finished;
+                std::vector<std::unique_ptr<Accumulator>> spare;  // Accumulators of the merged items, to reuse.
+                pool->parallel_for(0, std::min<size_t>(pool->num_threads() + 1, items.size()), 1, [&](size_t) {
+                    std::unique_ptr<Accumulator> accumulator;
+                    for (size_t item; (item = next_item++) < items.size();) {
+                        if (!accumulator) {
+                            std::lock_guard<std::mutex> lock(merge_mutex);
+                            if (!spare.empty()) {
+                                accumulator = std::move(spare.back());
+                                spare.pop_back();
+                            }
+                        }
+                        if (accumulator) *accumulator = empty;
+                        else accumulator = std::make_unique<Accumulator>(empty);
+
+                        const size_t point = points[to_run[first_point + items[item].point]];
+                        SeedExperimentRng(seed, point, items[item].reconstruction);
+                        run_reconstruction(point, items[item].reconstruction, accumulator.get());
+
+                        std::lock_guard<std::mutex> lock(merge_mutex);
+                        if (item != num_merged) {
+                            finished.emplace(item, std::move(accumulator));
+                            continue;
+                        }
+                        totals[items[item].point].merge(*accumulator);
+                        for (++num_merged; !finished.empty() && finished.begin()->first == num_merged; ++num_merged) {
+                            totals[items[num_merged].point].merge(*finished.begin()->second);
+                            spare.push_back(std::move(finished.begin()->second));
+                            finished.erase(finished.begin());
+                        }
+                    }
+                });
+                size_t num_active = 0;
+                for (size_t p : active_points) {
+                    if (num_reconstructions[p] < max_reconstructions && !converged(totals[p])) {
+                        active_points[num_active++] = p;
+                    }
+                }
+                active_points.resize(num_active);
+            }
+
+            for (size_t p = 0; p < group_points; ++p) {
+                const size_t i = to_run[first_point + p];
+                if (checkpoint) checkpoint->save(points[i], totals[p], num_reconstructions[p]);
+                write_resumed_points(i);
+                write_point(points[i], totals[p], num_reconstructions[p]);
+                num_written = i + 1;
+            }
+        }
+        write_resumed_points(points.size());
+    }
+
+    /** \brief RunAdaptiveSweep on the points 0 to num_points - 1. */
+    template <typename Accumulator, typename RunReconstruction, typename Converged, typename WritePoint,
+              typename Checkpoint = NoCheckpoint>
+    void RunAdaptiveSweep(size_t num_points,
+                          size_t min_reconstructions,
+                          size_t max_reconstructions,
+                          uint64_t seed,
+                          const Accumulator &empty,
+                          const RunReconstruction &run_reconstruction,
+                          const Converged &converged,
+                          const WritePoint &write_point,
+                          ThreadPool *pool = nullptr,
+                          Checkpoint *checkpoint = nullptr) {
+        std::vector<size_t> points(num_points);
+        for (size_t point = 0; point < num_points; ++point) points[point] = point;
+        RunAdaptiveSweep(points, min_reconstructions, max_reconstructions, seed, empty, run_reconstruction, converged,
+                         write_point, pool, checkpoint);
+    }
+
+    /** \brief How a sweep over a 1D parameter refines its grid where the losses
+     *         change quickly, instead of evaluating a regular grid.
+     *
+     *  The grid is a lattice of num_intervals + 1 points.  The sweep first
+     *  evaluates every num_intervals / initial_intervals points, then the
+     *  middles of the intervals whose ends differ by more than tolerance,
+     *  largest differences first, until max_points points are evaluated or
+     *  every interval is flat or a single lattice step.  With max_points 0, the
+     *  default, the sweep evaluates its regular grid.
+     */
+    struct GridRefinement {
+        size_t max_points = 0;
+        size_t initial_intervals = 16;
+        size_t num_intervals = 256;  // A power of 2 multiple of initial_intervals.
+        double tolerance = 0.1;
+
+        bool enabled() const { return max_points > 0; }
+    };
+
+    /** \brief "_Refined<max_points>" for the names of the files of a refined sweep, empty otherwise. */
+    std::string GridRefinementTag(const GridRefinement &refinement);
+
+    /** \brief |log10(a / b)| for two mean losses, infinite when only one of them
+     *         is a positive number, 0 when none is.
+     */
+    double LogChange(double a, double b);
+
+    /** \brief Runs RunAdaptiveSweep on the points of a lattice refined as set by
+     *         refinement.
+     *
+     *  \param change Called as change(total_a, num_reconstructions_a, total_b,
+     *         num_reconstructions_b) for the ends of an interval, the difference
+     *         of the losses between them compared with refinement.tolerance.
+     *  \param write_point Called as write_point(point, total, num_reconstructions)
+     *         for every evaluated lattice point, in increasing point order, once
+     *         the refinement is over.
+     *
+     *  The points evaluated in a round of refinement are run together, and the
+     *  intervals to refine only depend on the totals, so the points evaluated
+     *  and the files written are the same whatever the number of threads.  For
+     *  the same reason, a sweep resumed from checkpoint refines the same
+     *  intervals, its rounds taking the totals of the points already saved.
+     */
+    template <typename Accumulator, typename RunReconstruction, typename Converged, typename Change, typename WritePoint,
+              typename Checkpoint = NoCheckpoint>
+    void RunRefinedSweep(const GridRefinement &refinement,
+                         size_t min_reconstructions,
+                         size_t max_reconstructions,
+                         uint64_t seed,
+                         const Accumulator &empty,
+                         const RunReconstruction &run_reconstruction,
+                         const Converged &converged,
+                         const Change &change,
+                         const WritePoint &write_point,
+                         ThreadPool *pool = nullptr,
+                         Checkpoint *checkpoint = nullptr) {
+        struct EvaluatedPoint {
+            size_t point;
+            Accumulator total;
+            size_t num_reconstructions;
+        };
+        std::vector<EvaluatedPoint> evaluated;  // In increasing point order.
+        auto evaluate = [&](const std::vector<size_t> &points) {
+            RunAdaptiveSweep(points, min_reconstructions, max_reconstructions, seed, empty, run_reconstruction, converged,
+                             [&](size_t point, const Accumulator &total, size_t num_reconstructions) {
+                                 evaluated.push_back({point, total, num_reconstructions});
+                             }, pool, checkpoint);
+            std::sort(evaluated.begin(), evaluated.end(),
+                      [](const EvaluatedPoint &a, const EvaluatedPoint &b) { return a.point < b.point; });
+        };
+
+        const size_t initial_step = std::max<size_t>(1, refinement.num_intervals / std::max<size_t>(1, refinement.initial_intervals));
+        std::vector<size_t> points;
+        for (size_t point = 0; point <= refinement.num_intervals; point += initial_step) points.push_back(point);
+        evaluate(points);
+
+        struct Interval {
+            double change;
+            size_t first;  // Index in evaluated of the first end.
+        };
+        std::vector<Interval> intervals;
+        while (evaluated.size() < refinement.max_points) {
+            intervals.clear();
+            for (size_t i = 0; i + 1 < evaluated.size(); ++i) {
+                const EvaluatedPoint &a = evaluated[i], &b = evaluated[i + 1];
+                if (b.point - a.point < 2) continue;
+                const double interval_change = change(a.total, a.num_reconstructions, b.total, b.num_reconstructions);
+                if (interval_change > refinement.tolerance) intervals.push_back({interval_change, i});
+            }
+            if (intervals.empty()) break;
+
+            const size_t num_refined = std::min(intervals.size(), refinement.max_points - evaluated.size());
+            std::stable_sort(intervals.begin(), intervals.end(),
+                             [](const Interval &a, const Interval &b) { return a.change > b.change; });
+            points.clear();
+            for (size_t i = 0; i < num_refined; ++i) {
+                const size_t first = intervals[i].first;
+                points.push_back((evaluated[first].point + evaluated[first + 1].point) / 2);
+            }
+            std::sort(points.begin(), points.end());
+            evaluate(points);
+        }
+
+        for (const EvaluatedPoint &point : evaluated) {
+            write_point(point.point, point.total, point.num_reconstructions);
+        }
+    }
+
+    /** \brief Runs num_reconstructions random reconstructions at each of num_points
+     *         parameter points, on all the threads of pool.
+     *
+     *  RunAdaptiveSweep with num_reconstructions at every point, write_point
+     *  being called as write_point(point, total).
+     */
+    template <typename Accumulator, typename RunReconstruction, typename WritePoint>
+    void RunSweep(size_t num_points,
+                  size_t num_reconstructions,
+                  uint64_t seed,
+                  const Accumulator &empty,
+                  const RunReconstruction &run_reconstruction,
+                  const WritePoint &write_point,
+                  ThreadPool *pool = nullptr) {
+        RunAdaptiveSweep(num_points, num_reconstructions, num_reconstructions, seed, empty, run_reconstruction,
+                         [](const Accumulator &) { return true; },
+                         [&](size_t point, const Accumulator &total, size_t) { write_point(point, total); },
+                         pool);
+    }
+}
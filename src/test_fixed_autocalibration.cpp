@@ -0,0 +1,125 @@
+// Checks that AutoCalibrationFixed finds the quadric of AutoCalibrationLinear without any heap allocation :
+//   test_fixed_autocalibration
+// A program of its own, as the allocations of the whole process are counted while AutoCalibrationFixed runs : the
+// experiments of autocalibration, running concurrently, would be counted with them.
+
+#include "autocalibration_fixed.hpp"
+#include "sweep.hpp"
+#include "utils_for_testing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Eigen allocates with std::malloc rather than operator new, which itself goes through malloc : the count replaces
+// malloc, as glibc lets a program do, by one counting the calls of its thread between StartCounting and StopCounting.
+extern "C" void *__libc_malloc(size_t size);
+
+namespace {
+    thread_local bool counting = false;
+    thread_local size_t num_allocations = 0;
+
+    void StartCounting() {
+        num_allocations = 0;
+        counting = true;
+    }
+
+    // The number of allocations since StartCounting.
+    size_t StopCounting() {
+        counting = false;
+        return num_allocations;
+    }
+}
+
+extern "C" void *malloc(size_t size) {
+    if (counting) ++num_allocations;
+    return __libc_malloc(size);
+}
+
+namespace rootba_povar {
+
+    namespace {
+        // Fails the test with message if condition does not hold.
+        void Require(bool condition, const std::string &message) {
+            if (!condition) throw std::runtime_error(message);
+        }
+
+        // Autocalibrates scenes of N cameras with AutoCalibrationFixed, counting its heap allocations, and with
+        // AutoCalibrationLinear.
+        template <int N>
+        void CompareFixedAutoCalibration(size_t num_scenes) {
+            const double width = 36, height = 24;
+            Mat3 K;
+            K << 35, 0, width / 2,
+                 0, 35, height / 2,
+                 0, 0, 1;
+
+            std::vector<std::vector<Mat34>> scenes(num_scenes);
+            Scene scene;
+            for (size_t reconstruction = 0; reconstruction < num_scenes; ++reconstruction) {
+                SeedExperimentRng(23, N, reconstruction);
+                scene.draw(K, N, 1);
+                scenes[reconstruction] = scene.Ps;
+            }
+
+            double fixed_seconds = 0, linear_seconds = 0, max_quadric_distance = 0;
+            size_t fixed_allocations = 0;
+            for (const std::vector<Mat34> &Ps : scenes) {
+                Mat4 Q_fixed, Q_linear;
+                auto start = std::chrono::steady_clock::now();
+                StartCounting();
+                {
+                    AutoCalibrationFixed<double, N> fixed;
+                    for (const Mat34 &P : Ps) fixed.AddProjection(P, width, height);
+                    fixed.MetricTransformation(&Q_fixed);
+                }
+                fixed_allocations += StopCounting();
+                fixed_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                start = std::chrono::steady_clock::now();
+                {
+                    AutoCalibrationLinear<double> linear;
+                    for (const Mat34 &P : Ps) linear.AddProjection(P, width, height);
+                    linear.MetricTransformation(&Q_linear);
+                }
+                linear_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                // The quadric is only defined up to its scale and sign.
+                Q_fixed /= Q_fixed.norm();
+                Q_linear /= Q_linear.norm();
+                max_quadric_distance = std::max(max_quadric_distance, std::min((Q_fixed - Q_linear).norm(), (Q_fixed + Q_linear).norm()));
+            }
+
+            std::cout << N << " cameras : fixed " << fixed_seconds / num_scenes * 1e6 << " us vs linear " << linear_seconds / num_scenes * 1e6
+                      << " us, max distance of the quadrics " << max_quadric_distance << ", "
+                      << fixed_allocations << " allocations of AutoCalibrationFixed" << std::endl;
+            Require(fixed_allocations == 0, "AutoCalibrationFixed allocates");
+            Require(max_quadric_distance < 1e-9, "AutoCalibrationFixed does not find the quadric of AutoCalibrationLinear");
+        }
+    }
+}
+
+int main() {
+    try {
+        // The count must see the allocations of Eigen.
+        StartCounting();
+        {
+            Eigen::MatrixXd probe = Eigen::MatrixXd::Random(10, 10);
+            volatile double sum = probe.sum();
+            (void)sum;
+        }
+        rootba_povar::Require(StopCounting() > 0, "The allocations of Eigen are not counted");
+
+        rootba_povar::CompareFixedAutoCalibration<3>(2000);
+        rootba_povar::CompareFixedAutoCalibration<10>(2000);
+        rootba_povar::CompareFixedAutoCalibration<16>(2000);
+    } catch (const std::exception &e) {
+        std::cerr << "test_fixed_autocalibration failed : " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,12 +1,79 @@
 #include "testing_functions.hpp"
 #include "utils_for_testing.hpp"
+#include "batched_kernels.hpp"
+#include "sweep.hpp"
+#include "shards.hpp"
+#include "checkpoint.hpp"
 
+#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <cmath>
 #include <sstream>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <filesystem>
+#include <stdexcept>
+#include <fstream>
+#include <functional>
 
 namespace rootba_povar {
 
+    namespace {
+        // Fails the test with message if condition does not hold.
+        void Require(bool condition, const std::string &message) {
+            if (!condition) throw std::runtime_error(message);
+        }
+
+        // A file of the tests, in the temporary directory rather than among the results.
+        std::string TemporaryPath(const std::string &name) {
+            return (std::filesystem::temp_directory_path() / name).string();
+        }
+
+        // Whether the K costs are known within the confidence interval of stopping.
+        bool KCostsConverged(const FixedFocalLosses &losses, const AdaptiveStopping &stopping) {
+            return ConfidenceReached(losses.statistics[static_cast<size_t>(Loss::QR_Kcost)], stopping)
+                   && ConfidenceReached(losses.statistics[static_cast<size_t>(Loss::IAC_Kcost)], stopping);
+        }
+
+        // Largest change of the mean K costs, as a log10 ratio, and of Rank3Rate between two points of a sweep.
+        double KCostsChange(const FixedFocalLosses &a, size_t a_reconstructions, const FixedFocalLosses &b, size_t b_reconstructions) {
+            return std::max({LogChange(a.statistics[static_cast<size_t>(Loss::QR_Kcost)].mean(), b.statistics[static_cast<size_t>(Loss::QR_Kcost)].mean()),
+                             LogChange(a.statistics[static_cast<size_t>(Loss::IAC_Kcost)].mean(), b.statistics[static_cast<size_t>(Loss::IAC_Kcost)].mean()),
+                             std::abs(a.rank3_count / a_reconstructions - b.rank3_count / b_reconstructions)});
+        }
+
+        // Whether the K costs over all the focal lengths of fl are known within the confidence interval of stopping.
+        bool KCostsConverged(const FocalLengths_DistributionAndLosses &fl, const AdaptiveStopping &stopping) {
+            return ConfidenceReached(fl.statistics(Loss::QR_Kcost), stopping)
+                   && ConfidenceReached(fl.statistics(Loss::IAC_Kcost), stopping);
+        }
+
+        // Reconstructions a varying experiment runs first : the min_reconstructions of stopping, and with strata at
+        // least those expected to give target_count cameras to every focal length, out of num_reconstructions.
+        size_t FirstVaryingReconstructions(const AdaptiveStopping &stopping, const FocalLengthStrata &strata, size_t num_cams,
+                                           size_t num_reconstructions) {
+            const size_t first_reconstructions = stopping.min_reconstructions_of(num_reconstructions);
+            if (!strata.enabled()) return first_reconstructions;
+            const size_t stratified_reconstructions = (strata.target_count * strata.num_focal_lengths() + num_cams - 1) / num_cams;
+            return std::min<size_t>(stopping.enabled() ? std::max(first_reconstructions, stratified_reconstructions)
+                                                       : stratified_reconstructions,
+                                    num_reconstructions);
+        }
+
+        // Whether a varying experiment may stop drawing reconstructions : every focal length of the strata has
+        // target_count cameras, and the K costs have converged when stopping is enabled.
+        bool VaryingLossesConverged(const FocalLengths_DistributionAndLosses &fl, const AdaptiveStopping &stopping,
+                                    const FocalLengthStrata &strata) {
+            const bool enough_cameras = !strata.enabled() || fl.min_count() >= strata.target_count;
+            return enough_cameras && (!stopping.enabled() || KCostsConverged(fl, stopping));
+        }
+    }
+
     
     void test_K_From_AbsoluteConic(){
         Mat3 K, Kp;
@@ -47,187 +114,1484 @@ namespace rootba_povar {
         std::cout << RRt << std::endl;
     }
 
-    void recoverK_IACvsQR(int num_cams, int num_reconstructions, double translation_range){
-        // A FIXED focal_length for each reconstruction.
-        // We try to recover K from a random projective distortions by comparing IAC and QR to get K from the metric upgrade.
+    void test_wc_closed_form(){
+        // Checks the closed-form AutoCalibrationLinear::wc against projecting the 10 unit absolute quadrics with P * Q * P^T.
+        const double width = 36, height = 24;
+        const int num_projections = 10000;
+        Mat3 K;
+        K << 35, 0, width / 2,
+            0, 35, height / 2,
+            0, 0, 1;
 
-        // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
+        int num_mismatches = 0;
+        double max_difference = 0;
+        for (int n = 0; n < num_projections; ++n) {
+            Mat4 H_real;
+            random_Mat4(H_real);
+            Mat34 P = P_out_of_random_Rt(K, 100) * H_real.inverse();
+
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j) {
+                    Eigen::Matrix<double, 10, 1> closed_form = AutoCalibrationLinear<double>::wc(P, i, j);
+                    for (int k = 0; k < 10; ++k) {
+                        Eigen::VectorXd q = Eigen::VectorXd::Zero(10);
+                        q(k) = 1;
+                        Mat4 Q;
+                        Q << q(0), q(1), q(2), q(3),
+                            q(1), q(4), q(5), q(6),
+                            q(2), q(5), q(7), q(8),
+                            q(3), q(6), q(8), q(9);
+                        Mat3 w = P * Q * P.transpose();
+
+                        if (closed_form(k) != w(i, j)) ++num_mismatches;
+                        max_difference = std::max(max_difference, std::abs(closed_form(k) - w(i, j)));
+                    }
+                }
+            }
+        }
+        std::cout << "wc closed form : " << num_mismatches << " coefficients out of " << num_projections * 90
+                  << " differ from P * Q * P^T, max difference " << max_difference << std::endl;
+        Require(num_mismatches == 0, "The closed-form wc differs from P * Q * P^T");
+    }
+
+    void test_normal_equations_vs_svd(){
+        // Compares the normal equations mode of AutoCalibrationLinear with the SVD path on the same reconstructions,
+        // and the measured differences with the bounds reported by NullspaceErrorBounds.
         const double width = 36, height = 24;
+        const int num_reconstructions = 100;
+        Mat3 K;
+        K << 35, 0, width / 2,
+            0, 35, height / 2,
+            0, 0, 1;
 
-        std::stringstream path;
-        path << "../results/QRvsIAC_"
-            << num_cams << "Cams_"
-            << num_reconstructions << "Reconstr_"
-            << translation_range << "Transl.txt";
-        // path << "../results/QRvsIAC_focal_length_" << num_cams << "cams.txt";
-        std::cout << "writing : " << path.str() << std::endl;
-        std::ofstream outFile(path.str());
+        std::cout << "NumCams\tTranslationRange\tQuadricAngle\tSVDbound\tNormalEquationsBound\tIAC_Kdifference\tRankAgreement\tSkippedCameras\n";
+        for (int num_cams : {3, 10, 50, 1000}) {
+            for (double translation_range : {0.01, 1.0, 100.0}) {
+                double quadric_angle = 0, svd_bound = 0, normal_equations_bound = 0, K_difference = 0, rank_agreement = 0;
+                int num_compared_cams = 0, num_skipped_cams = 0;
+
+                for (int reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter) {
+                    Mat4 H_real;
+                    random_Mat4(H_real);
+                    AutoCalibrationLinear<double> a_svd;
+                    AutoCalibrationLinear<double> a_normal(true);
+
+                    std::vector<Mat34> Ps(num_cams);
+                    for (int i = 0; i < num_cams; ++i) {
+                        Ps[i] = P_out_of_random_Rt(K, translation_range) * H_real.inverse();  // Distort cameras.
+                        a_svd.AddProjection(Ps[i], width, height);
+                        a_normal.AddProjection(Ps[i], width, height);
+                    }
+
+                    Mat4 Q_svd, Q_normal;
+                    int rank_svd = 0, rank_normal = 0;
+                    a_svd.MetricTransformation(&Q_svd, &rank_svd);
+                    a_normal.MetricTransformation(&Q_normal, &rank_normal);
+
+                    double bound_svd, bound_normal;
+                    a_svd.NullspaceErrorBounds(&bound_svd, &bound_normal);
+
+                    // Both quadrics are unit norm and only defined up to sign.
+                    double cosine = std::min(1.0, std::abs((Q_svd.array() * Q_normal.array()).sum()) / (Q_svd.norm() * Q_normal.norm()));
+                    quadric_angle += std::acos(cosine);
+                    svd_bound += bound_svd;
+                    normal_equations_bound += bound_normal;
+                    rank_agreement += (rank_svd == rank_normal);
+
+                    for (int i = 0; i < num_cams; ++i) {
+                        // As in the sweeps, the cameras whose IAC is not positive definite have no K to compare.
+                        Mat3 K_svd, K_normal;
+                        const bool svd_positive_definite = K_From_ImageOfTheAbsoluteConic(Q_svd, Ps[i], &K_svd);
+                        const bool normal_positive_definite = K_From_ImageOfTheAbsoluteConic(Q_normal, Ps[i], &K_normal);
+                        if (!svd_positive_definite || !normal_positive_definite) {
+                            ++num_skipped_cams;
+                            continue;
+                        }
+                        K_difference += Mat3_distance(K_svd, K_normal);
+                        ++num_compared_cams;
+                    }
+                }
+                std::cout << num_cams << "\t" << translation_range << "\t"
+                          << quadric_angle / num_reconstructions << "\t"
+                          << svd_bound / num_reconstructions << "\t"
+                          << normal_equations_bound / num_reconstructions << "\t"
+                          << K_difference / num_compared_cams << "\t"
+                          << rank_agreement / num_reconstructions << "\t"
+                          << num_skipped_cams << "\n";
+            }
+        }
+    }
+
+    void test_sliding_window(){
+        // Streams projections through a sliding window, in normal equations mode, and compares the incremental estimate
+        // of the absolute quadric with one computed from scratch on the projections of the window.
+        const double width = 36, height = 24;
+        const int num_frames = 2000, window_size = 30;
+        Mat3 K;
+        K << 35, 0, width / 2,
+            0, 35, height / 2,
+            0, 0, 1;
+
+        Mat4 H_real;
+        random_Mat4(H_real);
+        AutoCalibrationLinear<double> incremental(true);
+        incremental.SetSlidingWindow(window_size);
+
+        std::deque<Mat34> window;
+        double max_quadric_distance = 0, incremental_time = 0, from_scratch_time = 0;
+        for (int frame = 0; frame < num_frames; ++frame) {
+            Mat34 P = P_out_of_random_Rt(K) * H_real.inverse();  // Distort cameras.
+            window.push_back(P);
+            if (window.size() > window_size) window.pop_front();
+
+            auto start = std::chrono::steady_clock::now();
+            Mat4 Q_incremental;
+            incremental.AddProjection(P, width, height);
+            incremental.MetricTransformation(&Q_incremental);
+            auto middle = std::chrono::steady_clock::now();
+
+            AutoCalibrationLinear<double> from_scratch(true);
+            for (const Mat34 &P_window : window) {
+                from_scratch.AddProjection(P_window, width, height);
+            }
+            Mat4 Q_from_scratch;
+            from_scratch.MetricTransformation(&Q_from_scratch);
+            auto end = std::chrono::steady_clock::now();
+
+            incremental_time += std::chrono::duration<double>(middle - start).count();
+            from_scratch_time += std::chrono::duration<double>(end - middle).count();
+
+            // Both quadrics are unit norm and only defined up to sign.
+            double distance = std::min((Q_incremental - Q_from_scratch).norm(), (Q_incremental + Q_from_scratch).norm());
+            max_quadric_distance = std::max(max_quadric_distance, distance);
+        }
+        std::cout << "Sliding window of " << window_size << " projections over " << num_frames << " frames : "
+                  << "max distance to the from-scratch quadric " << max_quadric_distance << ", "
+                  << incremental_time / num_frames * 1e6 << " us per frame incrementally vs "
+                  << from_scratch_time / num_frames * 1e6 << " us from scratch" << std::endl;
+        Require(max_quadric_distance < 1e-12, "The sliding window differs from the quadric computed from scratch by more than 1e-12");
+    }
+
+    void test_simd_jacobi(){
+        // Solves the normal equations of random reconstructions with the batched Jacobi kernel at every supported
+        // instruction set, and compares the nullspace and its metric upgrade with the ones of SelfAdjointEigenSolver.
+        const double width = 36, height = 24;
+        const int num_reconstructions = 4000, num_cams = 10;
+        Mat3 K;
+        K << 35, 0, width / 2,
+            0, 35, height / 2,
+            0, 0, 1;
 
-        if (!outFile){
-            std::cerr << "Erros opening file for writing!" << std::endl;
+        std::vector<Eigen::Matrix<double, 10, 10>> AtA(num_reconstructions);
+        std::vector<Mat4> Q(num_reconstructions);
+        for (int r = 0; r < num_reconstructions; ++r) {
+            Mat4 H_real;
+            random_Mat4(H_real);
+            AutoCalibrationLinear<double> a(true);
+            for (int i = 0; i < num_cams; ++i) {
+                a.AddProjection(P_out_of_random_Rt(K) * H_real.inverse(), width, height);
+            }
+            AtA[r] = a.NormalEquations();
+            Mat4 Q_final;
+            a.MetricTransformation(&Q_final);
+            Q[r] = Q_final;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Eigen::Matrix<double, 10, 1>> q_reference(num_reconstructions);
+        for (int r = 0; r < num_reconstructions; ++r) {
+            Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double, 10, 10>> eigen_solver(AtA[r]);
+            q_reference[r] = eigen_solver.eigenvectors().col(0);
+        }
+        double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // When the two smallest singular values of A are close, the nullspace itself is ill-determined and both
+        // solvers return different vectors with the same residual, so the residuals are what is compared.
+        double max_reference_residual = 0;
+        for (int r = 0; r < num_reconstructions; ++r) {
+            max_reference_residual = std::max(max_reference_residual, (AtA[r] * q_reference[r]).norm() / AtA[r].norm());
+        }
+        std::cout << "SelfAdjointEigenSolver : " << reference_time / num_reconstructions * 1e6 << " us per 10x10 matrix, "
+                  << "max relative residual " << max_reference_residual << std::endl;
+
+        const SimdLevel default_level = ActiveSimdLevel();
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > SupportedSimdLevel()) continue;
+            SetSimdLevel(level);
+
+            std::vector<Eigen::Matrix<double, 10, 1>> values(num_reconstructions);
+            std::vector<Eigen::Matrix<double, 10, 10>> vectors(num_reconstructions);
+            start = std::chrono::steady_clock::now();
+            SymmetricEigenBatch(AtA.data(), AtA.size(), values.data(), vectors.data());
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::vector<Eigen::Matrix<double, 4, 1>> Q_values(num_reconstructions);
+            std::vector<Mat4> Q_vectors(num_reconstructions);
+            SymmetricEigenBatch(Q.data(), Q.size(), Q_values.data(), Q_vectors.data());
+
+            double max_residual = 0, max_H_error = 0;
+            int num_different = 0;
+            for (int r = 0; r < num_reconstructions; ++r) {
+                int smallest;
+                values[r].minCoeff(&smallest);
+                Eigen::Matrix<double, 10, 1> q = vectors[r].col(smallest);
+                max_residual = std::max(max_residual, (AtA[r] * q).norm() / AtA[r].norm());
+                if (std::min((q - q_reference[r]).norm(), (q + q_reference[r]).norm()) > 1e-6) num_different++;
+
+                // H is only defined up to the signs of its columns, so compare H H^T.
+                Eigen::SelfAdjointEigenSolver<Mat4> eigen_solver(Q[r]);
+                Mat4 H_reference = AutoCalibrationLinear<double>::MetricTransformationFromEigen(eigen_solver.eigenvalues(), eigen_solver.eigenvectors());
+                Mat4 H = AutoCalibrationLinear<double>::MetricTransformationFromEigen(Q_values[r], Q_vectors[r]);
+                max_H_error = std::max(max_H_error, (H * H.transpose() - H_reference * H_reference.transpose()).norm() /
+                                                    (H_reference * H_reference.transpose()).norm());
+            }
+            std::cout << SimdLevelName(level) << " : " << time / num_reconstructions * 1e6 << " us per 10x10 matrix, "
+                      << "max relative residual " << max_residual << ", " << num_different << " nullspaces differing by more than 1e-6, "
+                      << "max relative H H^T error " << max_H_error << std::endl;
+        }
+        SetSimdLevel(default_level);
+    }
+
+    void test_KRt_batch(){
+        // Decomposes metric and projectively distorted cameras with KRt_From_P and KRt_From_P_Batch, at every supported
+        // instruction set, and compares K, R and t.
+        const double width = 36, height = 24;
+        const int num_projections = 100000;
+        Mat3 K;
+        K << 35, 0, width / 2,
+            0, 35, height / 2,
+            0, 0, 1;
+
+        std::vector<Mat34> Ps(num_projections);
+        for (int i = 0; i < num_projections; ++i) {
+            Mat4 H_real;
+            random_Mat4(H_real);
+            Ps[i] = P_out_of_random_Rt(K, 10);
+            if (i % 2) Ps[i] = Ps[i] * H_real.inverse();
         }
 
-        outFile << "FocalLength\tQRloss\tIACloss\n";
+        std::vector<Mat3> K_reference(num_projections, Mat3::Zero()), R_reference(num_projections, Mat3::Zero());  // Touch the pages before timing.
+        std::vector<Vec3> t_reference(num_projections, Vec3::Zero());
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_projections; ++i) {
+            KRt_From_P(Ps[i], &K_reference[i], &R_reference[i], &t_reference[i]);
+        }
+        double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "KRt_From_P : " << reference_time / num_projections * 1e9 << " ns per projection" << std::endl;
+
+        const SimdLevel default_level = ActiveSimdLevel();
+        bool accurate = true;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > SupportedSimdLevel()) continue;
+            SetSimdLevel(level);
+
+            std::vector<Mat3> Ks(num_projections, Mat3::Zero()), Rs(num_projections, Mat3::Zero());
+            std::vector<Vec3> ts(num_projections, Vec3::Zero());
+            start = std::chrono::steady_clock::now();
+            KRt_From_P_Batch(Ps.data(), Ps.size(), Ks.data(), Rs.data(), ts.data());
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double max_K_error = 0, max_R_error = 0, max_t_error = 0;
+            for (int i = 0; i < num_projections; ++i) {
+                max_K_error = std::max(max_K_error, (Ks[i] - K_reference[i]).norm() / K_reference[i].norm());
+                max_R_error = std::max(max_R_error, (Rs[i] - R_reference[i]).norm() / R_reference[i].norm());
+                max_t_error = std::max(max_t_error, (ts[i] - t_reference[i]).norm() / t_reference[i].norm());
+            }
+            std::cout << SimdLevelName(level) << " : " << time / num_projections * 1e9 << " ns per projection, "
+                      << "max relative errors K " << max_K_error << ", R " << max_R_error << ", t " << max_t_error << std::endl;
+            accurate = accurate && max_K_error < 1e-8 && max_R_error < 1e-8 && max_t_error < 1e-8;
+        }
+        SetSimdLevel(default_level);
+        Require(accurate, "KRt_From_P_Batch differs from KRt_From_P by more than 1e-8");
+    }
 
-        for (size_t equivalent_focal_length = 10; equivalent_focal_length < 300; ++equivalent_focal_length){
+    void test_upper_cholesky(){
+        // Compares the closed form UpperCholesky3 and its batched version with the flipped Eigen::LLT that
+        // K_From_ImageOfTheDualAbsoluteQuadric used to run, on K K^T matrices and on matrices that are not positive
+        // definite.
+        const int num_matrices = 100000;
+        std::vector<Mat3> KKts(num_matrices);
+        for (int i = 0; i < num_matrices; ++i) {
             Mat3 K;
-            K << equivalent_focal_length, 0, width / 2,
-                0, equivalent_focal_length, height / 2,
+            K << 10 + rand() % 300, double(rand()) / RAND_MAX, 18,
+                0, 10 + rand() % 300, 12,
                 0, 0, 1;
+            KKts[i] = K * K.transpose();
+            if (i % 4 == 0) KKts[i](0,0) = -KKts[i](0,0);  // Not positive definite.
+        }
 
-            double average_QR_cost = 0, average_iac_cost = 0;
+        double max_error = 0;
+        int num_flag_mismatches = 0;
+        std::vector<Mat3> Ks(num_matrices, Mat3::Zero());  // Touch the pages before timing.
+        std::unique_ptr<bool[]> positive_definite(new bool[num_matrices]);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_matrices; ++i) {
+            positive_definite[i] = UpperCholesky3(KKts[i], &Ks[i]);
+        }
+        double scalar_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_matrices; ++i) {
+            Mat3 flipped = KKts[i].reverse();
+            Eigen::LLT<Mat3> llt(flipped);
+            Mat3 K = Mat3(llt.matrixL()).reverse();
+            for (int j = 0; j < 3; ++j) {
+                if (K(j, j) < 0) K.col(j) = -K.col(j);
+            }
 
-            for (size_t reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter){
-                Mat4 H_real;
-                random_Mat4(H_real);
-                AutoCalibrationLinear<double> a;
+            bool llt_positive_definite = (llt.info() == Eigen::Success);
+            num_flag_mismatches += (llt_positive_definite != positive_definite[i]);
+            if (llt_positive_definite && positive_definite[i]) {
+                max_error = std::max(max_error, (K - Ks[i]).norm() / K.norm());
+            }
+        }
+        double llt_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "UpperCholesky3 : " << scalar_time / num_matrices * 1e9 << " ns per matrix, LLT : " << llt_time / num_matrices * 1e9
+                  << " ns, max relative difference " << max_error << ", " << num_flag_mismatches << " positive definiteness mismatches" << std::endl;
+        Require(num_flag_mismatches == 0 && max_error < 1e-12, "UpperCholesky3 differs from LLT");
+
+        const SimdLevel default_level = ActiveSimdLevel();
+        bool identical_batches = true;
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (level > SupportedSimdLevel()) continue;
+            SetSimdLevel(level);
+
+            std::vector<Mat3> Ks_batch(num_matrices, Mat3::Zero());
+            std::unique_ptr<bool[]> positive_definite_batch(new bool[num_matrices]);
+            start = std::chrono::steady_clock::now();
+            K_From_ImageOfTheDualAbsoluteQuadric_Batch(KKts.data(), KKts.size(), Ks_batch.data(), positive_definite_batch.get());
+            double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double max_batch_error = 0;
+            int num_batch_flag_mismatches = 0, num_nan_mismatches = 0;
+            for (int i = 0; i < num_matrices; ++i) {
+                num_batch_flag_mismatches += (positive_definite_batch[i] != positive_definite[i]);
+                num_nan_mismatches += (Ks_batch[i].hasNaN() == positive_definite_batch[i]);
+                if (positive_definite[i]) max_batch_error = std::max(max_batch_error, (Ks_batch[i] - Ks[i]).norm() / Ks[i].norm());
+            }
+            std::cout << SimdLevelName(level) << " : " << time / num_matrices * 1e9 << " ns per matrix, max relative difference "
+                      << max_batch_error << ", " << num_batch_flag_mismatches << " flag mismatches, "
+                      << num_nan_mismatches << " NaN mismatches" << std::endl;
+            identical_batches = identical_batches && num_batch_flag_mismatches == 0 && num_nan_mismatches == 0 && max_batch_error < 1e-12;
+        }
+        SetSimdLevel(default_level);
+        Require(identical_batches, "The batched Cholesky factorization differs from UpperCholesky3 by more than 1e-12");
+    }
 
-                // Add cameras with random rotation and translation.
-                Mat34 Ps[num_cams];
-                for (int i = 0; i < num_cams; ++i) {
-                    Ps[i] = P_out_of_random_Rt(K, translation_range) * H_real.inverse();  // Distort cameras.
-                    a.AddProjection(Ps[i], width, height);
+    void test_stacked_iac(){
+        // Compares the images of the absolute quadric computed for all the cameras of a reconstruction at once with
+        // the camera by camera P Q P^T of K_From_ImageOfTheAbsoluteConic.
+        const int num_cams = 50, num_reconstructions = 2000;
+        const double width = 36, height = 24;
+        Mat3 K;
+        K << 35, 0, width / 2,
+             0, 35, height / 2,
+             0, 0, 1;
+
+        std::vector<Mat4> Qs(num_reconstructions);
+        std::vector<Mat34> Ps(num_reconstructions * num_cams);
+        for (int r = 0; r < num_reconstructions; ++r) {
+            Mat4 H_real;
+            random_Mat4(H_real);
+            for (int i = 0; i < num_cams; ++i) {
+                Ps[r * num_cams + i] = P_out_of_random_Rt(K) * H_real.inverse();
+            }
+            Mat4 Q_metric = Mat4::Identity();
+            Q_metric(3,3) = 0;
+            Qs[r] = H_real * Q_metric * H_real.transpose();
+        }
+
+        std::vector<Mat3> KKt_reference(Ps.size(), Mat3::Zero()), KKt(Ps.size(), Mat3::Zero());  // Touch the pages before timing.
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < num_reconstructions; ++r) {
+            for (int i = 0; i < num_cams; ++i) {
+                const Mat34 &P = Ps[r * num_cams + i];
+                KKt_reference[r * num_cams + i] = P * Qs[r] * P.transpose();
+                KKt_reference[r * num_cams + i] /= KKt_reference[r * num_cams + i](2,2);
+            }
+        }
+        double reference_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < num_reconstructions; ++r) {
+            ImagesOfTheAbsoluteQuadric(Qs[r], &Ps[r * num_cams], num_cams, &KKt[r * num_cams]);
+        }
+        double batched_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double max_error = 0;
+        for (size_t i = 0; i < Ps.size(); ++i) {
+            max_error = std::max(max_error, (KKt[i] - KKt_reference[i]).norm() / KKt_reference[i].norm());
+        }
+        std::cout << "P Q P^T : " << reference_time / Ps.size() * 1e9 << " ns per camera, all cameras at once : "
+                  << batched_time / Ps.size() * 1e9 << " ns, max relative difference " << max_error << std::endl;
+
+        std::vector<Mat3> Ks(num_cams);
+        std::unique_ptr<bool[]> positive_definite(new bool[num_cams]);
+        K_From_ImageOfTheAbsoluteConic(Qs[0], Ps.data(), num_cams, Ks.data(), positive_definite.get());
+        double max_K_error = 0;
+        for (int i = 0; i < num_cams; ++i) {
+            Mat3 K_from_iac;
+            bool iac_positive_definite = K_From_ImageOfTheAbsoluteConic(Qs[0], Ps[i], &K_from_iac);
+            if (iac_positive_definite != positive_definite[i]) std::cout << "Positive definiteness mismatch for camera " << i << std::endl;
+            if (iac_positive_definite) max_K_error = std::max(max_K_error, Mat3_distance(K_from_iac, Ks[i]) / K_from_iac.norm());
+        }
+        std::cout << "Max relative difference of K from the images computed at once : " << max_K_error << std::endl;
+    }
+
+    void test_sweep_determinism(){
+        // Runs the same small sweep on one thread and on all the cores : the reduced losses must be bitwise identical,
+        // whatever the order in which the threads ran the reconstructions.
+        const int num_cams = 10;
+        const size_t num_points = 20, num_reconstructions = 50;
+        const double width = 36, height = 24;
+
+        struct Losses {
+            double QR_Kcost = 0, maxQR_Kcost = 0, rank3_count = 0;
+            StreamingStatistics QR_Kcost_statistics;
+
+            void merge(const Losses &other) {
+                QR_Kcost += other.QR_Kcost;
+                QR_Kcost_statistics.merge(other.QR_Kcost_statistics);
+                maxQR_Kcost = std::max(maxQR_Kcost, other.maxQR_Kcost);
+                rank3_count += other.rank3_count;
+            }
+        };
+
+        auto run_reconstruction = [&](size_t point, size_t, Losses *losses) {
+            Mat3 K;
+            K << 10 + 10 * point, 0, width / 2,
+                 0, 10 + 10 * point, height / 2,
+                 0, 0, 1;
+            thread_local Scene scene;
+            scene.draw(K, num_cams, 1);
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : scene.Ps) a.AddProjection(P, width, height);
+            int rank = 0;
+            Mat4 H_computed = a.MetricTransformation(nullptr, &rank);
+            losses->rank3_count += (rank == 3);
+            for (int i = 0; i < num_cams; ++i) {
+                Mat3 K_from_QR, R;
+                Vec3 t;
+                KRt_From_P(Mat34(scene.Ps[i] * H_computed), &K_from_QR, &R, &t);
+                losses->QR_Kcost += Mat3_distance(K, K_from_QR);
+                losses->maxQR_Kcost = std::max(losses->maxQR_Kcost, Mat3_distance(K, K_from_QR));
+                losses->QR_Kcost_statistics.add(Mat3_distance(K, K_from_QR));
+            }
+        };
+
+        std::vector<Losses> serial(num_points), parallel(num_points);
+        ThreadPool one_thread(1), many_threads(std::max(4, ThreadPool::global().num_threads()));
+        auto start = std::chrono::steady_clock::now();
+        RunSweep(num_points, num_reconstructions, 42, Losses(), run_reconstruction,
+                 [&](size_t point, const Losses &losses) { serial[point] = losses; }, &one_thread);
+        double serial_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        start = std::chrono::steady_clock::now();
+        RunSweep(num_points, num_reconstructions, 42, Losses(), run_reconstruction,
+                 [&](size_t point, const Losses &losses) { parallel[point] = losses; }, &many_threads);
+        double parallel_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int num_mismatches = 0;
+        for (size_t point = 0; point < num_points; ++point) {
+            num_mismatches += (serial[point].QR_Kcost != parallel[point].QR_Kcost)
+                              + (serial[point].maxQR_Kcost != parallel[point].maxQR_Kcost)
+                              + (serial[point].QR_Kcost_statistics.mean() != parallel[point].QR_Kcost_statistics.mean())
+                              + (serial[point].rank3_count != parallel[point].rank3_count);
+        }
+        std::cout << "1 thread : " << serial_time << " s, " << many_threads.num_threads() << " threads : "
+                  << parallel_time << " s, " << num_mismatches << " mismatches" << std::endl;
+        Require(num_mismatches == 0, "The losses of the sweep depend on the number of threads");
+
+        // Same with adaptive stopping, on the spread of the K costs : the points must also stop after the same number
+        // of reconstructions.
+        AdaptiveStopping stopping;
+        stopping.min_reconstructions = 4;
+        stopping.relative_half_width = 0.2;
+        auto converged = [&](const Losses &losses) {
+            return ConfidenceReached(losses.QR_Kcost_statistics, stopping);
+        };
+        std::vector<size_t> serial_reconstructions(num_points), parallel_reconstructions(num_points);
+        RunAdaptiveSweep(num_points, stopping.min_reconstructions, num_reconstructions, 42, Losses(), run_reconstruction, converged,
+                         [&](size_t point, const Losses &losses, size_t n) { serial[point] = losses; serial_reconstructions[point] = n; },
+                         &one_thread);
+        RunAdaptiveSweep(num_points, stopping.min_reconstructions, num_reconstructions, 42, Losses(), run_reconstruction, converged,
+                         [&](size_t point, const Losses &losses, size_t n) { parallel[point] = losses; parallel_reconstructions[point] = n; },
+                         &many_threads);
+        num_mismatches = 0;
+        size_t total_reconstructions = 0;
+        for (size_t point = 0; point < num_points; ++point) {
+            num_mismatches += (serial[point].QR_Kcost != parallel[point].QR_Kcost)
+                              + (serial_reconstructions[point] != parallel_reconstructions[point]);
+            total_reconstructions += serial_reconstructions[point];
+        }
+        std::cout << "Adaptive : " << total_reconstructions << " reconstructions out of " << num_points * num_reconstructions
+                  << ", " << num_mismatches << " mismatches" << std::endl;
+        Require(num_mismatches == 0, "The adaptive sweep depends on the number of threads");
+    }
+
+    void test_philox(){
+        // Known answers of Philox4x32-10 from the Random123 distribution, then regeneration of one camera of a scene
+        // without the ones before it.
+        struct KnownAnswer {
+            Philox4x32::Counter counter;
+            Philox4x32::Key key;
+            Philox4x32::Counter expected;
+        };
+        const KnownAnswer known_answers[] = {
+            {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+            {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}, {0xffffffff, 0xffffffff}, {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+            {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}, {0xa4093822, 0x299f31d0}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+        };
+        for (const KnownAnswer &known_answer : known_answers) {
+            const bool correct = Philox4x32::Block(known_answer.counter, known_answer.key) == known_answer.expected;
+            std::cout << (correct ? "Known answer OK" : "Known answer WRONG") << std::endl;
+            Require(correct, "Philox4x32 differs from a known answer of Random123");
+        }
+
+        Philox4x32 rng(7), skipped(7);
+        for (int i = 0; i < 11; ++i) rng();
+        skipped.discard(11);
+        const bool discarded = rng() == skipped();
+        std::cout << "discard : " << (discarded ? "OK" : "WRONG") << std::endl;
+        Require(discarded, "discard does not skip the values drawn");
+
+        // A whole scene, then its camera 7 alone.
+        const int num_cams = 10;
+        Mat3 K;
+        K << 35, 0, 18,
+             0, 35, 12,
+             0, 0, 1;
+        SeedExperimentRng(3, 5, 11);
+        Mat4 H_real;
+        random_Mat4(H_real);
+        Mat34 Ps[num_cams];
+        for (int i = 0; i < num_cams; ++i) {
+            UseCameraStream(i);
+            Ps[i] = P_out_of_random_Rt(K) * H_real.inverse();
+        }
+        SeedExperimentRng(3, 5, 11);
+        random_Mat4(H_real);
+        UseCameraStream(7);
+        Mat34 P7 = P_out_of_random_Rt(K) * H_real.inverse();
+        std::cout << "Camera regenerated alone : " << (P7 == Ps[7] ? "OK" : "WRONG") << std::endl;
+        Require(P7 == Ps[7], "A camera regenerated alone differs from the one of its scene");
+    }
+
+    void test_streaming_statistics(){
+        // Losses spread over several orders of magnitude, as the K costs of a sweep, split in 7 uneven parts merged
+        // afterwards.  The quantiles must be within the relative accuracy of the exact ones, the moments close to the
+        // two pass ones.
+        const size_t num_losses = 100000, num_parts = 7;
+        std::vector<double> losses(num_losses);
+        SeedExperimentRng(1, 0, 0);
+        for (double &loss : losses) loss = std::pow(10, 8 * UniformRandom() - 4) * UniformRandom();
+
+        StreamingStatistics sequential, parts[num_parts];
+        for (size_t i = 0; i < num_losses; ++i) {
+            sequential.add(losses[i]);
+            parts[(i * i) % num_parts].add(losses[i]);
+        }
+        sequential.add(std::numeric_limits<double>::quiet_NaN());
+        StreamingStatistics merged;
+        for (const StreamingStatistics &part : parts) merged.merge(part);
+
+        double mean = 0, m2 = 0;
+        for (double loss : losses) mean += loss;
+        mean /= num_losses;
+        for (double loss : losses) m2 += (loss - mean) * (loss - mean);
+        std::cout << "Mean relative error : " << std::abs(sequential.mean() - mean) / mean
+                  << ", std relative error : " << std::abs(sequential.stddev() - std::sqrt(m2 / (num_losses - 1))) / std::sqrt(m2 / (num_losses - 1))
+                  << ", merged std relative error : " << std::abs(merged.stddev() - sequential.stddev()) / sequential.stddev()
+                  << ", non finite : " << sequential.non_finite_count() << std::endl;
+
+        std::sort(losses.begin(), losses.end());
+        double max_quantile_error = 0;
+        bool same_quantiles = true;
+        for (double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99}) {
+            const double exact = losses[size_t(q * (num_losses - 1))];
+            max_quantile_error = std::max(max_quantile_error, std::abs(sequential.quantile(q) - exact) / exact);
+            same_quantiles &= (sequential.quantile(q) == merged.quantile(q));
+        }
+        std::cout << "Max quantile relative error : " << max_quantile_error << " (accuracy "
+                  << StreamingStatistics::kRelativeAccuracy << "), merged quantiles "
+                  << (same_quantiles ? "identical" : "DIFFERENT") << ", "
+                  << sequential.buckets().size() << " buckets" << std::endl;
+
+        // The mean columns of the result files keep summing every loss, as before the statistics : a non finite loss
+        // is carried into the sum, while the statistics only count it.
+        FixedFocalLosses fixed_losses;
+        for (double loss : {1.0, std::numeric_limits<double>::quiet_NaN(), 2.0, std::numeric_limits<double>::infinity(), 3.0}) {
+            fixed_losses.add(Loss::QR_Kcost, loss);
+        }
+        const StreamingStatistics &QR_Kcost_statistics = fixed_losses.statistics[static_cast<size_t>(Loss::QR_Kcost)];
+        std::cout << "Sum of all the losses : " << fixed_losses.sum(Loss::QR_Kcost) << ", mean of the finite ones : "
+                  << QR_Kcost_statistics.mean() << std::endl;
+        Require(std::isnan(fixed_losses.sum(Loss::QR_Kcost)) && QR_Kcost_statistics.mean() == 2 && QR_Kcost_statistics.non_finite_count() == 2,
+                "The sums or the statistics changed their handling of non finite losses");
+    }
+
+    void test_stratified_focal_lengths(){
+        // A loss known for every focal length, 1 / f, averaged over cameras drawn from the log-normal distribution of the
+        // varying experiments and over stratified cameras weighted back to it.  Both means must match the exact one.
+        const double center = 3.7, stddev = 0.6;
+        const size_t num_cams = 10, num_reconstructions = 20000;
+        FocalLengthStrata strata;
+        strata.min_focal_length = 1;
+        strata.max_focal_length = 1000;
+        FocalLengths_DistributionAndLosses natural(center, stddev, true), stratified(center, stddev, true, strata);
+
+        double total_probability = 0, exact_mean = 0;
+        for (size_t focal_length = 1; focal_length <= 1000; ++focal_length) {
+            total_probability += natural.probability(focal_length);
+            exact_mean += natural.probability(focal_length) / focal_length;
+        }
+        exact_mean /= total_probability;
+
+        for (size_t reconstruction = 0; reconstruction < num_reconstructions; ++reconstruction) {
+            SeedExperimentRng(7, 0, reconstruction);
+            natural.draw_random_fl(num_cams);
+            stratified.draw_random_fl(num_cams);
+            for (size_t i = 0; i < num_cams; ++i) {
+                natural.add_loss(i, Loss::QR_Kcost, 1.0 / natural.current_focal_lengths[i]);
+                stratified.add_loss(i, Loss::QR_Kcost, 1.0 / stratified.current_focal_lengths[i]);
+            }
+        }
+        std::cout << "Probability of [1, 1000] : " << total_probability << ", exact mean : " << exact_mean
+                  << ", sampled : " << natural.population_mean(Loss::QR_Kcost)
+                  << ", stratified : " << stratified.population_mean(Loss::QR_Kcost)
+                  << ", fewest cameras of a focal length : " << stratified.min_count() << std::endl;
+        Require(std::abs(natural.population_mean(Loss::QR_Kcost) - exact_mean) < 0.01 * exact_mean
+                && std::abs(stratified.population_mean(Loss::QR_Kcost) - exact_mean) < 0.001 * exact_mean,
+                "The mean over the focal lengths does not match the exact one");
+
+        // A sweep with strata runs each point until every focal length has target_count cameras, and only writes the
+        // focal lengths that have them.
+        FocalLengthStrata sweep_strata;
+        sweep_strata.min_focal_length = 20;
+        sweep_strata.max_focal_length = 60;
+        sweep_strata.target_count = 8;
+        const size_t max_reconstructions = 1000, num_points = 3;
+        const size_t first_reconstructions = FirstVaryingReconstructions(AdaptiveStopping(), sweep_strata, num_cams, max_reconstructions);
+        const VaryingFocalLosses empty{FocalLengths_DistributionAndLosses(center, stddev, true, sweep_strata)};
+        std::vector<double> fewest_cameras(num_points);
+        std::vector<size_t> point_reconstructions(num_points);
+        RunAdaptiveSweep(num_points, first_reconstructions, max_reconstructions, 7, empty,
+                         [&](size_t, size_t, VaryingFocalLosses *losses) {
+                             losses->fl.draw_random_fl(num_cams);
+                             for (size_t i = 0; i < num_cams; ++i) losses->fl.add_loss(i, Loss::QR_Kcost, 1.0 / losses->fl.current_focal_lengths[i]);
+                         },
+                         [&](const VaryingFocalLosses &losses) { return VaryingLossesConverged(losses.fl, AdaptiveStopping(), sweep_strata); },
+                         [&](size_t point, const VaryingFocalLosses &losses, size_t n) {
+                             fewest_cameras[point] = losses.fl.min_count();
+                             point_reconstructions[point] = n;
+                         });
+        for (size_t point = 0; point < num_points; ++point) {
+            std::cout << "Point " << point << " : " << point_reconstructions[point] << " reconstructions, fewest cameras of a focal length : "
+                      << fewest_cameras[point] << std::endl;
+            Require(fewest_cameras[point] >= sweep_strata.target_count, "A point of the sweep stopped before target_count cameras");
+        }
+    }
+
+    void test_sharded_sweep(){
+        // The translation range sweeps run whole, then in shards merged by MergeTranslationRangeShards : the merged file
+        // must be the file of the whole sweep, byte for byte.  The shards of two seeds must not merge.
+        const int num_cams = 5, num_reconstructions = 6;
+        const uint64_t seed = 11;
+        const size_t num_shards = 3;
+        ExperimentSettings settings;
+        settings.translation_steps = 7;
+
+        auto read_file = [](const std::string &path) {
+            std::ifstream in(path, std::ios::binary);
+            std::stringstream contents;
+            contents << in.rdbuf();
+            return contents.str();
+        };
+        auto check_merge = [&](const std::string &path, const std::function<void(const Shard &, uint64_t)> &run_sweep) {
+            run_sweep(Shard(), seed);
+            const std::string whole = read_file(path);
+            std::remove(path.c_str());
+
+            std::vector<std::string> partial_paths;
+            Shard shard;
+            shard.count = num_shards;
+            for (shard.index = 0; shard.index < num_shards; ++shard.index) {
+                run_sweep(shard, seed);
+                partial_paths.push_back(ShardPath(path, shard));
+            }
+            const bool identical = MergeTranslationRangeShards(partial_paths) && !whole.empty() && read_file(path) == whole;
+            std::remove(path.c_str());
+
+            shard.index = num_shards - 1;
+            run_sweep(shard, seed + 1);
+            const bool other_seed_rejected = !MergeTranslationRangeShards(partial_paths);
+            std::remove(path.c_str());
+            for (const std::string &partial_path : partial_paths) std::remove(partial_path.c_str());
+
+            std::cout << path << " : merged shards " << (identical ? "identical to" : "DIFFERENT from") << " the whole sweep, shards of another seed "
+                      << (other_seed_rejected ? "rejected" : "MERGED") << std::endl;
+            Require(identical, "The merged shards differ from the whole sweep");
+            Require(other_seed_rejected, "Shards of two seeds were merged");
+        };
+
+        check_merge(FixedTranslationRangePath(num_cams, num_reconstructions, 35, AdaptiveStopping(), GridRefinement(), settings),
+                    [&](const Shard &shard, uint64_t sweep_seed) {
+            recoverK_FIXED_IACvsQR_effect_of_translation_range(num_cams, num_reconstructions, 35, sweep_seed, AdaptiveStopping(),
+                                                               GridRefinement(), shard, settings);
+        });
+
+        check_merge(VaryingTranslationRangePath(num_cams, num_reconstructions, AdaptiveStopping(), GridRefinement(), FocalLengthStrata(), settings),
+                    [&](const Shard &shard, uint64_t sweep_seed) {
+            recoverK_VARYING_IACvsQR_effect_of_translation_range(num_cams, num_reconstructions, sweep_seed, AdaptiveStopping(),
+                                                                 GridRefinement(), FocalLengthStrata(), shard, settings);
+        });
+
+        // A corrupt size in a partial file fails its read instead of being allocated.
+        std::stringstream corrupt;
+        WriteBinary(corrupt, uint64_t(1) << 60);
+        WriteBinary(corrupt, 1.0);
+        std::vector<double> values;
+        ReadBinary(corrupt, &values);
+        std::cout << "Vector of 2^60 values in 16 bytes : " << (corrupt ? "READ" : "rejected") << std::endl;
+        Require(!corrupt && values.empty(), "A corrupt size was read");
+    }
+
+    void test_checkpoint_resume(){
+        // A sweep killed after its first points, with a torn record at the end of its checkpoint, then relaunched : the
+        // relaunch must only run the other points and write the same rows as an uninterrupted run.
+        const int num_cams = 10;
+        const size_t num_points = 12, num_killed_after = 5, num_reconstructions = 20;
+        const double width = 36, height = 24;
+        const std::string checkpoint_path = TemporaryPath("test_checkpoint_resume.checkpoint");
+        std::remove(checkpoint_path.c_str());
+
+        std::atomic<size_t> num_run(0);
+        auto run_reconstruction = [&](size_t point, size_t, FixedFocalLosses *losses) {
+            Mat3 K;
+            K << 10 + 10 * point, 0, width / 2,
+                 0, 10 + 10 * point, height / 2,
+                 0, 0, 1;
+            thread_local Scene scene;
+            scene.draw(K, num_cams, 1);
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : scene.Ps) a.AddProjection(P, width, height);
+            int rank = 0;
+            Mat4 H_computed = a.MetricTransformation(nullptr, &rank);
+            losses->rank3_count += (rank == 3);
+            for (int i = 0; i < num_cams; ++i) {
+                Mat3 K_from_QR, R;
+                Vec3 t;
+                KRt_From_P(Mat34(scene.Ps[i] * H_computed), &K_from_QR, &R, &t);
+                losses->add(Loss::QR_Kcost, Mat3_distance(K, K_from_QR));
+            }
+            ++num_run;
+        };
+        auto write_rows = [&](ResultWriter &out) {
+            return [&out, num_cams](size_t point, const FixedFocalLosses &losses, size_t n) {
+                losses.write_losses_for_a_given_translation_range(out, point, num_cams, n);
+            };
+        };
+        auto converged = [](const FixedFocalLosses &) { return false; };
+
+        const std::string rows_path = TemporaryPath("test_checkpoint_resume_");
+        ResultWriter uninterrupted, resumed, killed;
+        uninterrupted.open(rows_path + "uninterrupted.txt", FixedFocalLosses::translation_range_columns());
+        resumed.open(rows_path + "resumed.txt", FixedFocalLosses::translation_range_columns());
+        killed.open(rows_path + "killed.txt", FixedFocalLosses::translation_range_columns());
+        RunAdaptiveSweep(num_points, num_reconstructions, num_reconstructions, 42, FixedFocalLosses(), run_reconstruction, converged,
+                         write_rows(uninterrupted));
+
+        {
+            SweepCheckpoint<FixedFocalLosses> checkpoint(checkpoint_path, 42, FixedFocalLosses());
+            RunAdaptiveSweep(num_killed_after, num_reconstructions, num_reconstructions, 42, FixedFocalLosses(), run_reconstruction,
+                             converged, write_rows(killed), nullptr, &checkpoint);
+        }
+        std::ofstream(checkpoint_path, std::ios::binary | std::ios::app) << "torn";
+
+        num_run = 0;
+        SweepCheckpoint<FixedFocalLosses> checkpoint(checkpoint_path, 42, FixedFocalLosses());
+        const size_t num_resumed = checkpoint.num_resumed();
+        RunAdaptiveSweep(num_points, num_reconstructions, num_reconstructions, 42, FixedFocalLosses(), run_reconstruction, converged,
+                         write_rows(resumed), nullptr, &checkpoint);
+        checkpoint.remove();
+
+        auto read_and_remove = [&](ResultWriter &out, const std::string &name) {
+            out.close();
+            std::stringstream text;
+            text << std::ifstream(rows_path + name).rdbuf();
+            std::remove((rows_path + name).c_str());
+            return text.str();
+        };
+        read_and_remove(killed, "killed.txt");
+        const std::string uninterrupted_rows = read_and_remove(uninterrupted, "uninterrupted.txt");
+        const std::string resumed_rows = read_and_remove(resumed, "resumed.txt");
+
+        std::cout << "Resumed " << num_resumed << " points of " << num_killed_after << ", ran "
+                  << num_run / num_reconstructions << " points of " << num_points << ", rows "
+                  << (resumed_rows == uninterrupted_rows ? "identical" : "DIFFERENT") << " to an uninterrupted run" << std::endl;
+        Require(resumed_rows == uninterrupted_rows, "The resumed sweep differs from an uninterrupted one");
+    }
+
+    void test_columnar_results(){
+        // A table the size of a varying translation range sweep, written as text and as columns : the columns must read
+        // back exactly, NaN included, and be quicker to write and smaller than the text.
+        const size_t num_rows = 16000, num_columns = 48;
+        std::string columns = "Row";
+        for (size_t column = 1; column < num_columns; ++column) columns += "\tLoss" + std::to_string(column);
+        columns += "\n";
+
+        std::mt19937_64 generator(42);
+        std::lognormal_distribution<double> losses(0, 3);
+        std::vector<std::vector<double>> table(num_columns, std::vector<double>(num_rows));
+        for (size_t row = 0; row < num_rows; ++row) {
+            table[0][row] = row;
+            for (size_t column = 1; column < num_columns; ++column) table[column][row] = losses(generator);
+            if (row % 100 == 0) table[1][row] = std::numeric_limits<double>::quiet_NaN();  // A focal length without IAC.
+        }
+
+        const std::string path = TemporaryPath("test_columnar_results");
+        double seconds[2];
+        for (ResultFormat format : {ResultFormat::Text, ResultFormat::Columnar}) {
+            auto start = std::chrono::high_resolution_clock::now();
+            ResultWriter out;
+            out.open(path + ResultExtension(format), columns);
+            for (size_t row = 0; row < num_rows; ++row) {
+                out << size_t(table[0][row]);
+                for (size_t column = 1; column < num_columns; ++column) out << table[column][row];
+                out.end_row();
+            }
+            out.close();
+            seconds[format == ResultFormat::Columnar] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+
+        std::vector<std::string> names;
+        std::vector<std::vector<double>> read;
+        size_t num_different = 0;
+        if (!ReadColumnarResults(path + ".acol", &names, &read) || names.size() != num_columns || names[1] != "Loss1") {
+            num_different = num_rows * num_columns;
+        } else {
+            for (size_t column = 0; column < num_columns; ++column) {
+                for (size_t row = 0; row < num_rows; ++row) {
+                    const double a = table[column][row], b = read[column][row];
+                    num_different += !(a == b || (std::isnan(a) && std::isnan(b)));
                 }
-    
-                // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
-                Mat4 Q;
-                Mat4 H_computed = a.MetricTransformation(&Q);
-        
-                for (int i = 0; i < num_cams; ++i) {
-                    Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
-                    Mat3 K_from_QR, K_from_iac, R;
-                    Vec3 t;
+            }
+        }
+        std::ifstream text(path + ".txt", std::ios::binary | std::ios::ate), columnar(path + ".acol", std::ios::binary | std::ios::ate);
+        std::cout << num_rows << " rows of " << num_columns << " columns : text " << text.tellg() << " bytes in " << seconds[0]
+                  << " s, columnar " << columnar.tellg() << " bytes in " << seconds[1] << " s, "
+                  << num_different << " values read back differently" << std::endl;
+        std::remove((path + ".txt").c_str());
+        std::remove((path + ".acol").c_str());
+        Require(num_different == 0, "The columnar file does not read back as written");
+    }
+
+    void test_result_sink(){
+        // Several experiments writing their files through one sink at once : every file must hold its rows, formatted
+        // as by operator<< of the streams, and a disk that is full must fail the file instead of being only printed.
+        const size_t num_writers = 4, num_rows = 100000;
+        const std::string path = TemporaryPath("test_result_sink_");
+        ResultSink sink;
+
+        auto value_of = [](size_t writer, size_t row, size_t column) {
+            const double values[] = {0.1 * row, -1e-7 * row, 1e12 + row, std::numeric_limits<double>::quiet_NaN(),
+                                     std::numeric_limits<double>::infinity(), double(writer), 123456.5, 0};
+            return values[(row + column) % 8];
+        };
+
+        std::vector<std::thread> writers;
+        std::vector<char> written(num_writers);  // Not vector<bool>, written by several threads.
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t writer = 0; writer < num_writers; ++writer) {
+            writers.emplace_back([&, writer]() {
+                ResultWriter out(sink);
+                out.open(path + std::to_string(writer) + ".txt", "Row\tA\tB\tC\n");
+                for (size_t row = 0; row < num_rows; ++row) {
+                    out << row << value_of(writer, row, 0) << value_of(writer, row, 1) << float(value_of(writer, row, 2));
+                    out.end_row();
+                }
+                written[writer] = out.close();
+            });
+        }
+        for (std::thread &writer : writers) writer.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        size_t num_identical = 0;
+        for (size_t writer = 0; writer < num_writers; ++writer) {
+            std::stringstream expected, text;
+            expected << "Row\tA\tB\tC\n";
+            for (size_t row = 0; row < num_rows; ++row) {
+                expected << row << "\t" << value_of(writer, row, 0) << "\t" << value_of(writer, row, 1) << "\t"
+                         << float(value_of(writer, row, 2)) << "\n";
+            }
+            text << std::ifstream(path + std::to_string(writer) + ".txt").rdbuf();
+            num_identical += written[writer] && text.str() == expected.str();
+            std::remove((path + std::to_string(writer) + ".txt").c_str());
+        }
 
-                    KRt_From_P(P_metric, &K_from_QR, &R, &t);
-                    K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
+        bool full_disk_failed = true;
+        ResultWriter full(sink);
+        if (full.open("/dev/full", "A\n")) {
+            for (size_t row = 0; row < num_rows; ++row) {
+                full << row;
+                full.end_row();
+            }
+            full_disk_failed = !full.close();
+        }
+        // A capacity that is not a power of 2 is rounded up : a queue of 3 holds 4 values, popped in order.
+        BoundedQueue<size_t> queue(3);
+        size_t num_pushed = 0, num_popped_in_order = 0;
+        for (size_t value = 0; value < 8; ++value) num_pushed += queue.try_push(size_t(value));
+        for (size_t value = 0, popped; queue.try_pop(&popped); ++value) num_popped_in_order += (popped == value);
+
+        std::cout << num_identical << " of " << num_writers << " files of " << num_rows << " rows written as by std::ostream in "
+                  << seconds << " s, writing to a full disk " << (full_disk_failed ? "failed" : "DID NOT FAIL") << ", a queue of 3 held "
+                  << num_pushed << " values, " << num_popped_in_order << " popped in order" << std::endl;
+        Require(num_identical == num_writers, "A result file differs from its rows");
+        Require(full_disk_failed, "Writing to a full disk did not fail");
+        Require(queue.capacity() == 4 && num_pushed == 4 && num_popped_in_order == 4, "The queue of 3 does not hold 4 values");
+    }
 
-                    average_QR_cost += Mat3_distance(K, K_from_QR); 
-                    average_iac_cost += Mat3_distance(K, K_from_iac);
+    void test_scene_generator(){
+        // A scene of Euler angles must be the cameras the experiments drew one by one, a scene of uniform quaternions
+        // true rotations, uniform enough that their mean vanishes.
+        const size_t num_cams = 1000, num_scenes = 200;
+        Mat3 K;
+        K << 35, 0, 18,
+             0, 35, 12,
+             0, 0, 1;
+
+        double scene_seconds = 0, camera_seconds = 0;
+        bool identical = true;
+        Scene scene;
+        for (size_t reconstruction = 0; reconstruction < num_scenes; ++reconstruction) {
+            auto start = std::chrono::high_resolution_clock::now();
+            SeedExperimentRng(5, 0, reconstruction);
+            scene.draw(K, num_cams, 10);
+            scene_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            SeedExperimentRng(5, 0, reconstruction);
+            Mat4 H_real;
+            random_Mat4(H_real);
+            std::vector<Mat34> Ps(num_cams);
+            for (size_t i = 0; i < num_cams; ++i) {
+                UseCameraStream(i);
+                Ps[i] = P_out_of_random_Rt(K, 10) * H_real.inverse();
+            }
+            camera_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            identical = identical && Ps == scene.Ps;
+        }
+
+        Mat3 mean_euler = Mat3::Zero(), mean_quaternions = Mat3::Zero();
+        double max_orthogonality_error = 0;
+        for (size_t reconstruction = 0; reconstruction < num_scenes; ++reconstruction) {
+            // Undistorted cameras of calibration I and translation 0 : the rotations themselves.
+            SeedExperimentRng(5, 0, reconstruction);
+            scene.H_inverse.setIdentity();
+            scene.Ks.assign(num_cams, Mat3::Identity());
+            scene.draw_cameras(0, RotationSampling::UniformQuaternions);
+            for (const Mat34 &P : scene.Ps) {
+                const Mat3 R = P.leftCols<3>();
+                max_orthogonality_error = std::max({max_orthogonality_error, (R * R.transpose() - Mat3::Identity()).norm(),
+                                                    std::abs(R.determinant() - 1)});
+                mean_quaternions += R / double(num_cams * num_scenes);
+            }
+            scene.draw_cameras(0, RotationSampling::EulerAngles);
+            for (const Mat34 &P : scene.Ps) mean_euler += P.leftCols<3>() / double(num_cams * num_scenes);
+        }
+
+        std::cout << "Scenes of Euler angles " << (identical ? "identical" : "DIFFERENT") << " to the cameras drawn one by one, in "
+                  << scene_seconds << " s instead of " << camera_seconds << " s" << std::endl;
+        std::cout << "Uniform quaternions : largest error of R R^T = I and det R = 1 " << max_orthogonality_error
+                  << ", norm of the mean rotation " << mean_quaternions.norm() << " (Euler angles : " << mean_euler.norm() << ")" << std::endl;
+        Require(identical, "The scenes differ from the cameras drawn one by one");
+        Require(max_orthogonality_error < 1e-12, "The uniform quaternions do not give rotations within 1e-12");
+    }
+
+    void test_common_random_numbers(){
+        // The difference of the QR loss between two neighbouring translation ranges, over the same reconstructions, must vary much
+        // less with common random numbers than with independent scenes at every point : fewer reconstructions are
+        // needed to tell the two points apart.
+        const size_t num_cams = 10, num_reconstructions = 400;
+        const double width = 36, height = 24, translation_ranges[2] = {1, 1.1};
+        const uint64_t seed = 13;
+        Mat3 K;
+        K << 35, 0, width / 2,
+             0, 35, height / 2,
+             0, 0, 1;
+
+        auto qr_loss = [&](const Scene &scene) {
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : scene.Ps) a.AddProjection(P, width, height);
+            const Mat4 H_computed = a.MetricTransformation();
+            double loss = 0;
+            for (const Mat34 &P : scene.Ps) {
+                Mat3 K_from_QR, R;
+                Vec3 t;
+                KRt_From_P(Mat34(P * H_computed), &K_from_QR, &R, &t);
+                loss += Mat3_distance(K, K_from_QR) / num_cams;
+            }
+            return loss;
+        };
+
+        ExperimentSettings settings;
+        SceneCache &cache = SceneCache::global();
+        const size_t drawn_before = cache.num_drawn();
+        double variances[2];
+        Scene scene;
+        for (bool common : {false, true}) {
+            settings.common_random_numbers = common;
+            double sum = 0, sum_of_squares = 0;
+            for (size_t reconstruction = 0; reconstruction < num_reconstructions; ++reconstruction) {
+                double losses[2];
+                for (size_t point = 0; point < 2; ++point) {
+                    SeedExperimentRng(seed, point, reconstruction);
+                    DrawScene(K, num_cams, translation_ranges[point], seed, reconstruction, settings, &scene);
+                    losses[point] = qr_loss(scene);
+                }
+                sum += losses[1] - losses[0];
+                sum_of_squares += (losses[1] - losses[0]) * (losses[1] - losses[0]);
+            }
+            variances[common] = (sum_of_squares - sum * sum / num_reconstructions) / (num_reconstructions - 1);
+        }
+        const size_t drawn = cache.num_drawn() - drawn_before;
+
+        // The first cameras of a scene do not depend on the number of cameras.
+        const std::shared_ptr<const BaseScene> small = cache.get(seed + 1, 0, num_cams);
+        const std::shared_ptr<const BaseScene> large = cache.get(seed + 1, 0, 5 * num_cams);
+        bool prefix_shared = large->num_cams() >= 5 * num_cams && small->H_real == large->H_real;
+        for (size_t i = 0; i < num_cams; ++i) prefix_shared = prefix_shared && small->Rs[i] == large->Rs[i] && small->ts[i] == large->ts[i];
+
+        std::cout << "Variance of the paired differences : " << variances[0] << " independent, " << variances[1]
+                  << " common, " << variances[0] / variances[1] << " times fewer reconstructions needed" << std::endl;
+        std::cout << drawn << " scenes drawn for " << num_reconstructions << " reconstructions at 2 points"
+                  << (drawn == num_reconstructions ? "" : " : NOT REUSED") << std::endl;
+        std::cout << "First cameras " << (prefix_shared ? "shared" : "DIFFERENT") << " between 10 and 50 cameras" << std::endl;
+
+        // A cache too small for the reconstructions of a point keeps the first ones for the next point, and the scenes
+        // drawn by racing threads are counted once.
+        const size_t capacity = 4, num_small_reconstructions = 8;
+        SceneCache small_cache(capacity);
+        for (size_t point = 0; point < 2; ++point) {
+            for (uint64_t reconstruction = 0; reconstruction < num_small_reconstructions; ++reconstruction) {
+                small_cache.get(seed, reconstruction, num_cams);
+            }
+        }
+        SceneCache raced_cache;
+        std::vector<std::thread> threads;
+        for (size_t thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&] {
+                for (uint64_t reconstruction = 0; reconstruction < num_small_reconstructions; ++reconstruction) {
+                    raced_cache.get(seed, reconstruction, num_cams);
                 }
+            });
+        }
+        for (std::thread &thread : threads) thread.join();
+        std::cout << small_cache.num_drawn() << " scenes drawn for 2 points of " << num_small_reconstructions << " reconstructions in a cache of "
+                  << capacity << ", " << raced_cache.num_drawn() << " by 4 threads drawing the same " << num_small_reconstructions << std::endl;
+
+        Require(drawn == num_reconstructions, "The scenes are not reused between the points");
+        Require(prefix_shared, "The first cameras differ between 10 and 50 cameras");
+        Require(small_cache.num_drawn() == 2 * num_small_reconstructions - capacity, "The first scenes are not kept in a cache too small");
+        Require(raced_cache.num_drawn() == num_small_reconstructions, "The scenes drawn by several threads are counted several times");
+    }
+
+    void test_shared_diac_coefficients(){
+        // Both papers from one pass over the cameras : the 2004 constraints must be the ones of AddProjection, the 1997
+        // ones those of the projections without their principal point, as the paper writes them.
+        const double width = 36, height = 24;
+        const size_t num_cams = 10, num_scenes = 2000;
+        Mat3 K;
+        K << 35, 0, width / 2,
+             0, 35, height / 2,
+             0, 0, 1;
+        Mat3 T;
+        T << 1, 0, -width / 2,
+             0, 1, -height / 2,
+             0, 0, 1;
+
+        std::vector<std::vector<Mat34>> scenes(num_scenes);
+        Scene scene;
+        for (size_t reconstruction = 0; reconstruction < num_scenes; ++reconstruction) {
+            SeedExperimentRng(17, 0, reconstruction);
+            scene.draw(K, num_cams, 10);
+            scenes[reconstruction] = scene.Ps;
+        }
+
+        bool identical_2004 = true;
+        double max_1997_difference = 0;
+        for (const std::vector<Mat34> &Ps : scenes) {
+            AutoCalibrationLinear<double> alone(true), shared_2004(true);
+            AutoCalibrationLinear<double, Pollefeys1997Constraints> shared_1997(true);
+            for (const Mat34 &P : Ps) alone.AddProjection(P, width, height);
+            AddProjections(Ps, width, height, &shared_2004, &shared_1997);
+            identical_2004 = identical_2004 && alone.NormalEquations() == shared_2004.NormalEquations();
+
+            Eigen::Matrix<double, 10, 10> AtA = Eigen::Matrix<double, 10, 10>::Zero();
+            for (const Mat34 &P : Ps) {
+                const Mat34 P_centered = T * P;
+                Eigen::Matrix<double, 4, 10> constraints;
+                constraints.row(0) = AutoCalibrationLinear<double>::wc(P_centered, 0, 0) - AutoCalibrationLinear<double>::wc(P_centered, 1, 1);
+                constraints.row(1) = AutoCalibrationLinear<double>::wc(P_centered, 0, 1);
+                constraints.row(2) = AutoCalibrationLinear<double>::wc(P_centered, 0, 2);
+                constraints.row(3) = AutoCalibrationLinear<double>::wc(P_centered, 1, 2);
+                AtA += constraints.transpose() * constraints;
             }
-            average_QR_cost /= (num_reconstructions * num_cams);
-            average_iac_cost /= (num_reconstructions * num_cams);
+            max_1997_difference = std::max(max_1997_difference, (shared_1997.NormalEquations() - AtA).norm() / AtA.norm());
+        }
 
-            outFile << equivalent_focal_length << "\t" << average_QR_cost << "\t" << average_iac_cost << "\n";
+        auto start = std::chrono::steady_clock::now();
+        for (const std::vector<Mat34> &Ps : scenes) {
+            AutoCalibrationLinear<double> paper2004;
+            AutoCalibrationLinear<double, Pollefeys1997Constraints> paper1997;
+            for (const Mat34 &P : Ps) {
+                paper2004.AddProjection(P, width, height);
+                paper1997.AddProjection(P, width, height);
+            }
+        }
+        const double separate_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        for (const std::vector<Mat34> &Ps : scenes) {
+            AutoCalibrationLinear<double> paper2004;
+            AutoCalibrationLinear<double, Pollefeys1997Constraints> paper1997;
+            AddProjections(Ps, width, height, &paper2004, &paper1997);
         }
-        outFile.close();
-        std::cout << "Successfully wrote : " << path.str() << std::endl;
+        const double shared_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "2004 constraints from the shared coefficients " << (identical_2004 ? "identical" : "DIFFERENT")
+                  << " to AddProjection, 1997 ones at a relative distance of at most " << max_1997_difference << std::endl;
+        std::cout << "Both papers : " << separate_time / (num_scenes * num_cams) * 1e9 << " ns per camera separately, "
+                  << shared_time / (num_scenes * num_cams) * 1e9 << " ns from shared coefficients" << std::endl;
+        Require(identical_2004, "The 2004 constraints from the shared coefficients differ from AddProjection");
+        Require(max_1997_difference < 1e-15, "The 1997 constraints from the shared coefficients differ by more than 1e-15");
     }
 
-    void recoverK_detailed_losses(int num_cams, int num_reconstructions, double translation_range){
-        // A FIXED focal length for each reconstruction.
-        // Outputs detailed losses (in global, focal_length, principal point and skew) when recovering K through QR and IAC
+    namespace {
+        // A policy of the user, not instantiated by libmv.cpp : the rows of the 2004 policy under another name.
+        struct UserConstraints {
+            static constexpr ConstraintRow kRows[] = {
+                {DiacElement::W00, DiacElement::W22, 1, 0, 9},
+                {DiacElement::W11, DiacElement::W22, 1, 0, 9},
+                {DiacElement::W00, DiacElement::W11, 1, 0, 0.2},
+                {DiacElement::W01, DiacElement::None, 1, 0, 0.01},
+                {DiacElement::W02, DiacElement::None, 1, 0, 0.1},
+                {DiacElement::W12, DiacElement::None, 1, 0, 0.1},
+            };
+        };
+    }
+
+    void test_constraint_policies(){
+        // The 2004 policy must give the constraints written out by hand before the policies, to the bit, as must a
+        // policy of the user with the same rows, and a policy of stronger priors must recover K better when the cameras
+        // do satisfy them.
+        static_assert(std::extent<decltype(Pollefeys2004Constraints::kRows)>::value == 6, "6 constraints per camera in 2004");
+        static_assert(std::extent<decltype(Pollefeys1997Constraints::kRows)>::value == 4, "4 constraints per camera in 1997");
+        static_assert(Pollefeys2004Constraints::kRows[3].divisor == 0.01, "The skew is the constraint of 0.01");
 
-        // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
         const double width = 36, height = 24;
-        // Max range of camera_translation when picking a translation at random
+        const size_t num_cams = 10, num_scenes = 2000;
+        Mat3 K;
+        K << 35, 0, width / 2,
+             0, 35, height / 2,
+             0, 0, 1;
+        Mat3 T;
+        T << width + height, 0, width / 2,
+             0, width + height, height / 2,
+             0, 0, 1;
+
+        bool identical = true, user_identical = true;
+        double losses_2004 = 0, losses_known = 0;
+        size_t num_losses = 0, num_failures = 0;
+        Scene scene;
+        for (size_t reconstruction = 0; reconstruction < num_scenes; ++reconstruction) {
+            SeedExperimentRng(19, 0, reconstruction);
+            scene.draw(K, num_cams, 10);
+
+            AutoCalibrationLinear<double> paper2004(true);
+            AutoCalibrationLinear<double, KnownPrincipalPointConstraints> known(true);
+            AutoCalibrationLinear<double, UserConstraints> user(true);
+            Eigen::Matrix<double, 10, 10> AtA = Eigen::Matrix<double, 10, 10>::Zero();
+            for (const Mat34 &P : scene.Ps) {
+                paper2004.AddProjection(P, width, height);
+                known.AddProjection(P, width, height);
+                user.AddProjection(P, width, height);
+
+                const Mat34 P_normalized = T.inverse() * P;
+                auto w = [&](int i, int j) { return AutoCalibrationLinear<double>::wc(P_normalized, i, j); };
+                Eigen::Matrix<double, 6, 10, Eigen::RowMajor> constraints;
+                constraints.row(0) = (w(0, 0) - w(2, 2)) / 9;
+                constraints.row(1) = (w(1, 1) - w(2, 2)) / 9;
+                constraints.row(2) = (w(0, 0) - w(1, 1)) / 0.2;
+                constraints.row(3) = w(0, 1) / 0.01;
+                constraints.row(4) = w(0, 2) / 0.1;
+                constraints.row(5) = w(1, 2) / 0.1;
+                AtA.noalias() += constraints.transpose() * constraints;
+            }
+            identical = identical && paper2004.NormalEquations() == AtA;
+            const Mat4 H_user = user.MetricTransformation(), H_paper2004 = paper2004.MetricTransformation();
+            user_identical = user_identical && user.NormalEquations() == AtA
+                             && (H_user.array() == H_paper2004.array() || (H_user.array().isNaN() && H_paper2004.array().isNaN())).all();
+
+            // The losses with the SVD, the normal equations losing too much of the accuracy of either.
+            AutoCalibrationLinear<double> svd_2004;
+            AutoCalibrationLinear<double, KnownPrincipalPointConstraints> svd_known;
+            for (const Mat34 &P : scene.Ps) {
+                svd_2004.AddProjection(P, width, height);
+                svd_known.AddProjection(P, width, height);
+            }
+            const Mat4 H_2004 = svd_2004.MetricTransformation(), H_known = svd_known.MetricTransformation();
+            for (const Mat34 &P : scene.Ps) {
+                Mat3 K_2004, K_known, R;
+                Vec3 t;
+                KRt_From_P(Mat34(P * H_2004), &K_2004, &R, &t);
+                KRt_From_P(Mat34(P * H_known), &K_known, &R, &t);
+                const double loss_2004 = Mat3_distance(K, K_2004), loss_known = Mat3_distance(K, K_known);
+                if (!std::isfinite(loss_2004) || !std::isfinite(loss_known)) {
+                    ++num_failures;
+                    continue;
+                }
+                losses_2004 += loss_2004;
+                losses_known += loss_known;
+                ++num_losses;
+            }
+        }
+
+        std::cout << "2004 policy " << (identical ? "identical" : "DIFFERENT") << " to the hand-written constraints, policy of the user "
+                  << (user_identical ? "identical" : "DIFFERENT") << std::endl;
+        std::cout << "Mean QR loss : " << losses_2004 / num_losses << " with the 2004 priors, " << losses_known / num_losses
+                  << " knowing the principal point, square pixels and no skew (" << num_failures << " cameras without K)" << std::endl;
+        Require(identical, "The 2004 policy differs from the hand-written constraints");
+        Require(user_identical, "A policy of the user with the rows of 2004 differs from the 2004 policy");
+        Require(losses_known < losses_2004, "The stronger priors do not recover K better");
+    }
+
+    std::string IACvsQRPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping, const ExperimentSettings &settings){
+        std::stringstream path;
+        path << "../results/QRvsIAC_"
+            << num_cams << "Cams_"
+            << num_reconstructions << "Reconstr_"
+            << translation_range << "Transl" << AdaptiveStoppingTag(stopping) << ExperimentSettingsTag(settings) << ResultExtension(settings.results_format);
+        return path.str();
+    }
 
+    std::string DetailedLossesPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping, const ExperimentSettings &settings){
         std::stringstream path;
         path << "../results/RecoverK&R_detailed_"
              << num_cams << "Cams_"
              << num_reconstructions << "Reconstr_"
-             << translation_range << "Transl.txt";
+             << translation_range << "Transl" << AdaptiveStoppingTag(stopping) << ExperimentSettingsTag(settings) << ResultExtension(settings.results_format);
+        return path.str();
+    }
+
+    std::string FixedTranslationRangePath(int num_cams, int num_reconstructions, int equivalent_focal_length, const AdaptiveStopping &stopping,
+                                          const GridRefinement &refinement, const ExperimentSettings &settings){
+        std::stringstream path;
+        path << "../results/Effect_of_translation_range_"
+             << num_cams << "Cams_"
+             << num_reconstructions << "Reconstr_"
+             << equivalent_focal_length << "FocalLength_2004paper" << AdaptiveStoppingTag(stopping) << GridRefinementTag(refinement) << ExperimentSettingsTag(settings) << ResultExtension(settings.results_format);
+        return path.str();
+    }
+
+    std::string VaryingFocalLengthPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping,
+                                       const FocalLengthStrata &strata, const ExperimentSettings &settings){
+        std::stringstream path;
+        path << "../results/RecoverK&R_varying_detailed_"
+             << num_cams << "Cams_"
+             << num_reconstructions << "Reconstr_"
+             << translation_range << "Transl"
+             << "_CamDist" << (settings.use_log_normal ? "LogN(" : "N(") << settings.center << "," << settings.stddev << ")" << AdaptiveStoppingTag(stopping)
+             << FocalLengthStrataTag(strata) << ExperimentSettingsTag(settings) << ResultExtension(settings.results_format);
+        return path.str();
+    }
+
+    std::string VaryingTranslationRangePath(int num_cams, int num_reconstructions, const AdaptiveStopping &stopping, const GridRefinement &refinement,
+                                            const FocalLengthStrata &strata, const ExperimentSettings &settings){
+        std::stringstream path;
+        path << "../results/Effect_of_translation_range_varying_"
+             << num_cams << "Cams_"
+             << num_reconstructions << "Reconstr_"
+             << "CamDist" << (settings.use_log_normal ? "LogN(" : "N(") << settings.center << "," << settings.stddev << ")" << AdaptiveStoppingTag(stopping)
+             << GridRefinementTag(refinement) << FocalLengthStrataTag(strata) << ExperimentSettingsTag(settings) << ResultExtension(settings.results_format);
+        return path.str();
+    }
 
-        std::ofstream outFile(path.str());
+    void recoverK_IACvsQR(int num_cams, int num_reconstructions, double translation_range, uint64_t seed, const AdaptiveStopping &stopping,
+                          const ExperimentSettings &settings){
+        // A FIXED focal_length for each reconstruction.
+        // We try to recover K from a random projective distortions by comparing IAC and QR to get K from the metric upgrade.
 
-        if (!outFile){
-            std::cerr << "Errors opening file for writing!" << std::endl;
+        // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
+        const double width = settings.width, height = settings.height;
+        const size_t min_focal_length = settings.min_focal_length, max_focal_length = settings.max_focal_length;
+
+        const std::string path = IACvsQRPath(num_cams, num_reconstructions, translation_range, stopping, settings);
+        std::cout << "writing : " << path << std::endl;
+        ResultWriter outFile;
+        if (!outFile.open(path, "FocalLength\tQRloss\tIACloss" + StatisticsColumns("QRloss") + StatisticsColumns("IACloss") + "\tReconstructions\n")) {
+            return;
         }
 
-        outFile << "FocalLength\tQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate\n";
+        using Losses = FixedFocalLosses;
 
-        for (size_t equivalent_focal_length = 10; equivalent_focal_length < 300; ++equivalent_focal_length){
+        auto run_reconstruction = [&](size_t point, size_t reconstruction, Losses *losses) {
+            const size_t equivalent_focal_length = min_focal_length + point;
             Mat3 K;
             K << equivalent_focal_length, 0, width / 2,
                 0, equivalent_focal_length, height / 2,
                 0, 0, 1;
 
-            double  averageQR_K_cost = 0, averageQR_focal_cost = 0, averageQR_pp_cost = 0 ,averageQR_skew_cost = 0, averageQR_RRt_cost = 0,
-                    averageIAC_K_cost = 0, averageIAC_focal_cost = 0, averageIAC_pp_cost = 0 ,averageIAC_skew_cost = 0, averageIAC_RRt_cost = 0,
-                    rank3_rate = 0;
-            
-            for (size_t reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter){
-                Mat4 H_real;
-                random_Mat4(H_real);
-                AutoCalibrationLinear<double> a;
-
-                // Add cameras with random rotation and translation.
-                Mat34 Ps[num_cams];
-                for (int i = 0; i < num_cams; ++i) {                   
-                    Ps[i] = P_out_of_random_Rt(K, translation_range) * H_real.inverse();  // Distort cameras.
-                    a.AddProjection(Ps[i], width, height);
-                }
-    
-                // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
-                Mat4 Q;
-                int rank = 0;
-                Mat4 H_computed = a.MetricTransformation(&Q, &rank);
-                rank3_rate += (rank == 3);
-        
-                for (int i = 0; i < num_cams; ++i) {
-                    Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
-                    Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
-                    Vec3 t_from_QR;
-
-                    KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
-                    K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
-
-                    R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
-
-                    averageQR_K_cost += Mat3_distance(K, K_from_QR);
-                    averageQR_focal_cost += sqrt((K(1,1) - K_from_QR(1,1)) * (K(1,1) - K_from_QR(1,1)) + (K(0,0) - K_from_QR(0,0)) * (K(0,0) - K_from_QR(0,0)));
-                    averageQR_pp_cost += sqrt((K(0,2) - K_from_QR(0,2)) * (K(0,2) - K_from_QR(0,2)) + (K(1,2) - K_from_QR(1,2)) * (K(1,2) - K_from_QR(1,2)));
-                    averageQR_skew_cost += (K(0,1) - K_from_QR(0,1)) * (K(0,1) - K_from_QR(0,1));
-                    averageQR_RRt_cost += proportional_to_rotation_loss(R_from_QR);
-
-                    averageIAC_K_cost += Mat3_distance(K, K_from_iac);
-                    averageIAC_focal_cost += sqrt((K(1,1) - K_from_iac(1,1)) * (K(1,1) - K_from_iac(1,1)) + (K(0,0) - K_from_iac(0,0)) * (K(0,0) - K_from_iac(0,0)));
-                    averageIAC_pp_cost += sqrt((K(0,2) - K_from_iac(0,2)) * (K(0,2) - K_from_iac(0,2)) + (K(1,2) - K_from_iac(1,2)) * (K(1,2) - K_from_iac(1,2)));
-                    averageIAC_skew_cost += (K(0,1) - K_from_iac(0,1)) * (K(0,1) - K_from_iac(0,1));
-                    averageIAC_RRt_cost += proportional_to_rotation_loss(R_from_iac);
-                }
+            // Cameras with random rotation and translation, distorted by a random projective transformation.
+            thread_local Scene scene;
+            DrawScene(K, num_cams, translation_range, seed, reconstruction, settings, &scene);
+            const std::vector<Mat34> &Ps = scene.Ps;
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : Ps) a.AddProjection(P, width, height);
+
+            // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
+            Mat4 Q;
+            Mat4 H_computed = a.MetricTransformation(&Q);
+
+            for (int i = 0; i < num_cams; ++i) {
+                Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
+                Mat3 K_from_QR, K_from_iac, R;
+                Vec3 t;
+
+                KRt_From_P(P_metric, &K_from_QR, &R, &t);
+                bool iac_positive_definite = K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
+
+                losses->add(Loss::QR_Kcost, Mat3_distance(K, K_from_QR));
+                if (!iac_positive_definite) continue;
+                losses->add(Loss::IAC_Kcost, Mat3_distance(K, K_from_iac));
+            }
+        };
+
+        auto write_point = [&](size_t point, const Losses &losses, size_t point_reconstructions) {
+            outFile << min_focal_length + point
+                    << losses.sum(Loss::QR_Kcost) / (point_reconstructions * num_cams)
+                    << MeanLoss(losses.sum(Loss::IAC_Kcost), losses.iac_count);
+            WriteStatistics(outFile, losses.statistics[static_cast<size_t>(Loss::QR_Kcost)]);
+            WriteStatistics(outFile, losses.statistics[static_cast<size_t>(Loss::IAC_Kcost)]);
+            outFile << point_reconstructions;
+            outFile.end_row();
+        };
+
+        SweepCheckpoint<Losses> checkpoint(path + ".checkpoint", seed, Losses());
+        RunAdaptiveSweep(max_focal_length - min_focal_length, stopping.min_reconstructions_of(num_reconstructions), num_reconstructions, seed,
+                         Losses(), run_reconstruction, [&](const Losses &losses) { return KCostsConverged(losses, stopping); }, write_point,
+                         nullptr, &checkpoint);
+        if (!outFile.close()) return;  // Keeping the checkpoint.
+        checkpoint.remove();
+        std::cout << "Successfully wrote : " << path << std::endl;
+    }
+
+    void recoverK_detailed_losses(int num_cams, int num_reconstructions, double translation_range, uint64_t seed, const AdaptiveStopping &stopping,
+                                  const ExperimentSettings &settings){
+        // A FIXED focal length for each reconstruction.
+        // Outputs detailed losses (in global, focal_length, principal point and skew) when recovering K through QR and IAC
+
+        // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
+        const double width = settings.width, height = settings.height;
+        const size_t min_focal_length = settings.min_focal_length, max_focal_length = settings.max_focal_length;
+        // Max range of camera_translation when picking a translation at random
+
+        const std::string path = DetailedLossesPath(num_cams, num_reconstructions, translation_range, stopping, settings);
+
+        ResultWriter outFile;
+        if (!outFile.open(path, "FocalLength\tQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate"
+                                      + LossesStatisticsColumns() + "\tReconstructions\n")) {
+            return;
+        }
+
+        using Losses = FixedFocalLosses;
+
+        auto run_reconstruction = [&](size_t point, size_t reconstruction, Losses *losses) {
+            const size_t equivalent_focal_length = min_focal_length + point;
+            Mat3 K;
+            K << equivalent_focal_length, 0, width / 2,
+                0, equivalent_focal_length, height / 2,
+                0, 0, 1;
+
+            // Cameras with random rotation and translation, distorted by a random projective transformation.
+            thread_local Scene scene;
+            DrawScene(K, num_cams, translation_range, seed, reconstruction, settings, &scene);
+            const std::vector<Mat34> &Ps = scene.Ps;
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : Ps) a.AddProjection(P, width, height);
+
+            // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
+            Mat4 Q;
+            int rank = 0;
+            Mat4 H_computed = a.MetricTransformation(&Q, &rank);
+            losses->rank3_count += (rank == 3);
+
+            for (int i = 0; i < num_cams; ++i) {
+                Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
+                Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
+                Vec3 t_from_QR;
+
+                KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
+                bool iac_positive_definite = K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
+
+                R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
+
+                losses->add(Loss::QR_Kcost, Mat3_distance(K, K_from_QR));
+                losses->add(Loss::QR_Focalcost, sqrt((K(1,1) - K_from_QR(1,1)) * (K(1,1) - K_from_QR(1,1)) + (K(0,0) - K_from_QR(0,0)) * (K(0,0) - K_from_QR(0,0))));
+                losses->add(Loss::QR_PPcost, sqrt((K(0,2) - K_from_QR(0,2)) * (K(0,2) - K_from_QR(0,2)) + (K(1,2) - K_from_QR(1,2)) * (K(1,2) - K_from_QR(1,2))));
+                losses->add(Loss::QR_Skewcost, (K(0,1) - K_from_QR(0,1)) * (K(0,1) - K_from_QR(0,1)));
+                losses->add(Loss::QR_RRtcost, proportional_to_rotation_loss(R_from_QR));
+
+                if (!iac_positive_definite) continue;
+                losses->add(Loss::IAC_Kcost, Mat3_distance(K, K_from_iac));
+                losses->add(Loss::IAC_Focalcost, sqrt((K(1,1) - K_from_iac(1,1)) * (K(1,1) - K_from_iac(1,1)) + (K(0,0) - K_from_iac(0,0)) * (K(0,0) - K_from_iac(0,0))));
+                losses->add(Loss::IAC_PPcost, sqrt((K(0,2) - K_from_iac(0,2)) * (K(0,2) - K_from_iac(0,2)) + (K(1,2) - K_from_iac(1,2)) * (K(1,2) - K_from_iac(1,2))));
+                losses->add(Loss::IAC_Skewcost, (K(0,1) - K_from_iac(0,1)) * (K(0,1) - K_from_iac(0,1)));
+                losses->add(Loss::IAC_RRtcost, proportional_to_rotation_loss(R_from_iac));
             }
-            averageQR_K_cost /= (num_reconstructions * num_cams);
-            averageQR_focal_cost /= (num_reconstructions * num_cams);
-            averageQR_pp_cost /= (num_reconstructions * num_cams);
-            averageQR_skew_cost /= (num_reconstructions * num_cams);
-            averageQR_RRt_cost /= (num_reconstructions * num_cams);
-
-            averageIAC_K_cost /= (num_reconstructions * num_cams);
-            averageIAC_focal_cost /= (num_reconstructions * num_cams);
-            averageIAC_pp_cost /= (num_reconstructions * num_cams);
-            averageIAC_skew_cost /= (num_reconstructions * num_cams);
-            averageIAC_RRt_cost /= (num_reconstructions * num_cams);
-            rank3_rate /= num_reconstructions;
-
-            outFile << equivalent_focal_length << "\t"
-                    << averageQR_K_cost << "\t"
-                    << averageQR_focal_cost << "\t"
-                    << averageQR_pp_cost << "\t"
-                    << averageQR_skew_cost <<"\t"
-                    << averageQR_RRt_cost << "\t"
-                    << averageIAC_K_cost << "\t"
-                    << averageIAC_focal_cost << "\t"
-                    << averageIAC_pp_cost << "\t"
-                    << averageIAC_skew_cost << "\t"
-                    << averageIAC_RRt_cost << "\t"
-                    << rank3_rate << "\n";
-        }
-        outFile.close();
-        std::cout << "Successfully wrote : " << path.str() << std::endl;
-
-    }
-
-    void recoverK_FIXED_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, int equivalent_focal_length){
+        };
+
+        auto write_point = [&](size_t point, const Losses &losses, size_t point_reconstructions) {
+            const double num_projections = point_reconstructions * num_cams;
+            outFile << min_focal_length + point
+                    << losses.sum(Loss::QR_Kcost) / num_projections
+                    << losses.sum(Loss::QR_Focalcost) / num_projections
+                    << losses.sum(Loss::QR_PPcost) / num_projections
+                    << losses.sum(Loss::QR_Skewcost) / num_projections
+                    << losses.sum(Loss::QR_RRtcost) / num_projections
+                    << MeanLoss(losses.sum(Loss::IAC_Kcost), losses.iac_count)
+                    << MeanLoss(losses.sum(Loss::IAC_Focalcost), losses.iac_count)
+                    << MeanLoss(losses.sum(Loss::IAC_PPcost), losses.iac_count)
+                    << MeanLoss(losses.sum(Loss::IAC_Skewcost), losses.iac_count)
+                    << MeanLoss(losses.sum(Loss::IAC_RRtcost), losses.iac_count)
+                    << losses.rank3_count / point_reconstructions;
+            WriteLossesStatistics(outFile, losses.statistics);
+            outFile << point_reconstructions;
+            outFile.end_row();
+        };
+
+        SweepCheckpoint<Losses> checkpoint(path + ".checkpoint", seed, Losses());
+        RunAdaptiveSweep(max_focal_length - min_focal_length, stopping.min_reconstructions_of(num_reconstructions), num_reconstructions, seed,
+                         Losses(), run_reconstruction, [&](const Losses &losses) { return KCostsConverged(losses, stopping); }, write_point,
+                         nullptr, &checkpoint);
+        if (!outFile.close()) return;  // Keeping the checkpoint.
+        checkpoint.remove();
+        std::cout << "Successfully wrote : " << path << std::endl;
+
+    }
+
+    void recoverK_FIXED_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, int equivalent_focal_length, uint64_t seed, const AdaptiveStopping &stopping, const GridRefinement &refinement,
+                                                            const Shard &shard, const ExperimentSettings &settings){
         // A FIXED focal_length for each reconstruction.
         // We try to recover K from a random projective distortions by comparing IAC and QR to get K from the metric upgrade.
 
         // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
-        const double width = 36, height = 24;
+        const double width = settings.width, height = settings.height;
 
-        // We do a logarithmic sweep of the translation range.
-        const double translation_range_min = 0.001, translation_range_max = 10000;
-        const size_t steps = 200;
+        // We do a logarithmic sweep of the translation range, on a regular grid or on a lattice refined where the
+        // losses change.
+        const double translation_range_min = settings.translation_range_min, translation_range_max = settings.translation_range_max;
+        const size_t steps = refinement.enabled() ? refinement.num_intervals : settings.translation_steps;
 
         const double logStart = std::log10(translation_range_min);
         const double logEnd = std::log10(translation_range_max);
@@ -238,265 +1602,384 @@ namespace rootba_povar {
             0, equivalent_focal_length, height / 2,
             0, 0, 1;
 
-        std::stringstream path;
-        path << "../results/Effect_of_translation_range_"
-            << num_cams << "Cams_"
-            << num_reconstructions << "Reconstr_"
-            << equivalent_focal_length << "FocalLength_2004paper.txt";
-
-        std::ofstream outFile(path.str());
+        const std::string path = FixedTranslationRangePath(num_cams, num_reconstructions, equivalent_focal_length, stopping, refinement, settings);
 
-        if (!outFile){
-            std::cerr << "Erros opening file for writing!" << std::endl;
+        if (refinement.enabled() && shard.enabled()) {
+            std::cerr << "A refined sweep cannot be sharded, its points depend on each other" << std::endl;
+            return;
         }
 
-        outFile << "TranslationRange\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate\n";
+        // The result file, or the partial file of the shard, to be merged by merge_shards.
+        ShardHeader header;
+        header.experiment = "FIXED_translation_range";
+        header.path = path;
+        header.columns = FixedFocalLosses::translation_range_columns();
+        header.num_cams = num_cams;
+        header.seed = seed;
+        ResultWriter outFile;
+        std::ofstream partialFile;
+        if (!OpenSweepFile(&outFile, &partialFile, header, shard)) return;
+
+        using Losses = FixedFocalLosses;
+
+        auto run_reconstruction = [&](size_t step, size_t reconstruction, Losses *losses) {
+            const double translation_range = std::pow(10, logStart + step * logStep);
+
+            // Cameras with random rotation and translation, distorted by a random projective transformation.
+            thread_local Scene scene;
+            DrawScene(K, num_cams, translation_range, seed, reconstruction, settings, &scene);
+            const std::vector<Mat34> &Ps = scene.Ps;
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : Ps) a.AddProjection(P, width, height);
+
+            // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
+            Mat4 Q;
+            int rank = 0;
+            Mat4 H_computed = a.MetricTransformation(&Q, &rank);
+            losses->rank3_count += (rank == 3);
+
+            // K from the image of the absolute quadric of all the cameras at once, into buffers that only grow, as the
+            // scenes of the sweeps.
+            thread_local std::vector<Mat3> Ks_from_iac;
+            thread_local std::unique_ptr<bool[]> iacs_positive_definite;
+            thread_local int iacs_capacity = 0;
+            Ks_from_iac.resize(num_cams);
+            if (iacs_capacity < num_cams) {
+                iacs_positive_definite.reset(new bool[num_cams]);
+                iacs_capacity = num_cams;
+            }
+            K_From_ImageOfTheAbsoluteConic(Q, Ps.data(), num_cams, Ks_from_iac.data(), iacs_positive_definite.get());
 
-        for (size_t i = 0; i < steps; ++i){
-            double translation_range = std::pow(10, logStart + i * logStep);
-            
-            double averageQR_Kcost = 0, averageQR_Focalcost = 0, averageQR_PPcost = 0, averageQR_Skewcost = 0, averageQR_RRtcost = 0,
-                   averageIAC_Kcost = 0, averageIAC_Focalcost = 0, averageIAC_PPcost = 0, averageIAC_Skewcost = 0, averageIAC_RRtcost = 0,
-                   Rank3Rate = 0,
-                   maxQR_Kcost = 0, maxIAC_Kcost = 0;
+            for (int i = 0; i < num_cams; ++i) {
+                Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
+                Mat3 K_from_QR, R_from_QR, R_from_iac;
+                Vec3 t_from_QR;
 
-            for (size_t reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter){
-                Mat4 H_real;
-                random_Mat4(H_real);
-                AutoCalibrationLinear<double> a;
+                KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
+                const Mat3 &K_from_iac = Ks_from_iac[i];
+                R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
 
-                // Add cameras with random rotation and translation.
-                Mat34 Ps[num_cams];
-                for (int i = 0; i < num_cams; ++i) {
-                    Ps[i] = P_out_of_random_Rt(K, translation_range) * H_real.inverse();  // Distort cameras.
-                    a.AddProjection(Ps[i], width, height);
-                }
-    
-                // Compute metric update transformation. Also recover the absolute quadric to try to recover K from it via IAC and compare with QR 
-                Mat4 Q;
-                int rank = 0;
-                Mat4 H_computed = a.MetricTransformation(&Q, &rank);
-                Rank3Rate += (rank == 3);
-                
-                for (int i = 0; i < num_cams; ++i) {
-                    Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
-                    Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
-                    Vec3 t_from_QR;
-
-                    KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
-                    K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
-                    R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
-                    
-                    double QR_Kcost = Mat3_distance(K, K_from_QR);
-                    double IAC_Kcost = Mat3_distance(K, K_from_iac);
-                    averageQR_Kcost += QR_Kcost;
-                    averageIAC_Kcost += IAC_Kcost;
-                    if (QR_Kcost > maxQR_Kcost) maxQR_Kcost = QR_Kcost;
-                    if (IAC_Kcost > maxIAC_Kcost) maxIAC_Kcost = IAC_Kcost;
-                    averageQR_Kcost += QR_Kcost;
-                    averageQR_Focalcost += sqrt((K(1,1) - K_from_QR(1,1)) * (K(1,1) - K_from_QR(1,1)) + (K(0,0) - K_from_QR(0,0)) * (K(0,0) - K_from_QR(0,0)));
-                    averageQR_PPcost += sqrt((K(0,2) - K_from_QR(0,2)) * (K(0,2) - K_from_QR(0,2)) + (K(1,2) - K_from_QR(1,2)) * (K(1,2) - K_from_QR(1,2)));
-                    averageQR_Skewcost += (K(0,1) - K_from_QR(0,1)) * (K(0,1) - K_from_QR(0,1));
-                    averageQR_RRtcost += proportional_to_rotation_loss(R_from_QR);
-
-                    averageIAC_Kcost += IAC_Kcost;
-                    averageIAC_Focalcost += sqrt((K(1,1) - K_from_iac(1,1)) * (K(1,1) - K_from_iac(1,1)) + (K(0,0) - K_from_iac(0,0)) * (K(0,0) - K_from_iac(0,0)));
-                    averageIAC_PPcost += sqrt((K(0,2) - K_from_iac(0,2)) * (K(0,2) - K_from_iac(0,2)) + (K(1,2) - K_from_iac(1,2)) * (K(1,2) - K_from_iac(1,2)));
-                    averageIAC_Skewcost += (K(0,1) - K_from_iac(0,1)) * (K(0,1) - K_from_iac(0,1));
-                    averageIAC_RRtcost += proportional_to_rotation_loss(R_from_iac);
-                }
+                losses->add(Loss::QR_Kcost, Mat3_distance(K, K_from_QR));
+                losses->add(Loss::QR_Focalcost, sqrt((K(1,1) - K_from_QR(1,1)) * (K(1,1) - K_from_QR(1,1)) + (K(0,0) - K_from_QR(0,0)) * (K(0,0) - K_from_QR(0,0))));
+                losses->add(Loss::QR_PPcost, sqrt((K(0,2) - K_from_QR(0,2)) * (K(0,2) - K_from_QR(0,2)) + (K(1,2) - K_from_QR(1,2)) * (K(1,2) - K_from_QR(1,2))));
+                losses->add(Loss::QR_Skewcost, (K(0,1) - K_from_QR(0,1)) * (K(0,1) - K_from_QR(0,1)));
+                losses->add(Loss::QR_RRtcost, proportional_to_rotation_loss(R_from_QR));
+
+                if (!iacs_positive_definite[i]) continue;  // No K from the IAC, counted in IAC_PDRate.
+                losses->add(Loss::IAC_Kcost, Mat3_distance(K, K_from_iac));
+                losses->add(Loss::IAC_Focalcost, sqrt((K(1,1) - K_from_iac(1,1)) * (K(1,1) - K_from_iac(1,1)) + (K(0,0) - K_from_iac(0,0)) * (K(0,0) - K_from_iac(0,0))));
+                losses->add(Loss::IAC_PPcost, sqrt((K(0,2) - K_from_iac(0,2)) * (K(0,2) - K_from_iac(0,2)) + (K(1,2) - K_from_iac(1,2)) * (K(1,2) - K_from_iac(1,2))));
+                losses->add(Loss::IAC_Skewcost, (K(0,1) - K_from_iac(0,1)) * (K(0,1) - K_from_iac(0,1)));
+                losses->add(Loss::IAC_RRtcost, proportional_to_rotation_loss(R_from_iac));
             }
-            averageQR_Kcost /= (num_reconstructions * num_cams);
-            averageQR_Focalcost /= (num_reconstructions * num_cams);
-            averageQR_PPcost /= (num_reconstructions * num_cams);
-            averageQR_Skewcost /= (num_reconstructions * num_cams);
-            averageQR_RRtcost /= (num_reconstructions * num_cams);
-
-            averageIAC_Kcost /= (num_reconstructions * num_cams);
-            averageIAC_Focalcost /= (num_reconstructions * num_cams);
-            averageIAC_PPcost /= (num_reconstructions * num_cams);
-            averageIAC_Skewcost /= (num_reconstructions * num_cams);
-            averageIAC_RRtcost /= (num_reconstructions * num_cams);
-            Rank3Rate /= num_reconstructions;
-
-            outFile << translation_range << "\t"
-                    << averageQR_Kcost << "\t"
-                    << maxQR_Kcost << "\t"
-                    << averageQR_Focalcost << "\t"
-                    << averageQR_PPcost << "\t"
-                    << averageQR_Skewcost << "\t"
-                    << averageQR_RRtcost << "\t"
-                    << averageIAC_Kcost << "\t"
-                    << maxIAC_Kcost << "\t"
-                    << averageIAC_Focalcost << "\t"
-                    << averageIAC_PPcost << "\t"
-                    << averageIAC_Skewcost << "\t"
-                    << averageIAC_RRtcost << "\t"
-                    << Rank3Rate << "\n";
-        }
-        outFile.close();
-        std::cout << "Successfully wrote : " << path.str() << std::endl;
-    }
-
-    void recoverK_varying_focal_length(int num_cams, int num_reconstructions, double translation_range){
+        };
+
+        auto write_point = [&](size_t step, const Losses &losses, size_t point_reconstructions) {
+            const double translation_range = std::pow(10, logStart + step * logStep);
+            if (shard.enabled()) WriteShardRecord(partialFile, step, translation_range, point_reconstructions, losses);
+            else losses.write_losses_for_a_given_translation_range(outFile, translation_range, num_cams, point_reconstructions);
+        };
+
+        // A relaunched sweep continues from the points of the checkpoint, deleted once the file is written.
+        const std::string written_path = shard.enabled() ? ShardPath(path, shard) : path;
+        SweepCheckpoint<Losses> checkpoint(written_path + ".checkpoint", seed, Losses());
+        auto converged = [&](const Losses &losses) { return KCostsConverged(losses, stopping); };
+        if (refinement.enabled()) {
+            RunRefinedSweep(refinement, stopping.min_reconstructions_of(num_reconstructions), num_reconstructions, seed,
+                            Losses(), run_reconstruction, converged, KCostsChange, write_point, nullptr, &checkpoint);
+        } else {
+            RunAdaptiveSweep(ShardPoints(steps, shard), stopping.min_reconstructions_of(num_reconstructions), num_reconstructions, seed,
+                             Losses(), run_reconstruction, converged, write_point, nullptr, &checkpoint);
+        }
+        if (!CloseSweepFile(&outFile, &partialFile, written_path, shard)) return;  // Keeping the checkpoint.
+        checkpoint.remove();
+        std::cout << "Successfully wrote : " << written_path << std::endl;
+    }
+    void recoverK_varying_focal_length(int num_cams, int num_reconstructions, double translation_range, uint64_t seed, const AdaptiveStopping &stopping,
+                                       const FocalLengthStrata &strata, const ExperimentSettings &settings){
         // VARYING focal lengths for each reconstruction
         // Outputs detailed losses (in global, focal_length, principal point and skew) when recovering K through QR and IAC.
 
         // Here we pick the distribution of focal length of the cameras (Normal or log-normal))
-        const double center = 3.7, stddev = 0.6;
-        const bool use_log_normal = true; // If false, use normal distribution.
+        const double center = settings.center, stddev = settings.stddev;
+        const bool use_log_normal = settings.use_log_normal; // If false, use normal distribution.
         // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
-        const double width = 36, height = 24; 
+        const double width = settings.width, height = settings.height; 
     
         Mat3 K;
-        FocalLengths_DistributionAndLosses fl(center, stddev, use_log_normal);
+        FocalLengths_DistributionAndLosses fl(center, stddev, use_log_normal, strata);
 
         double Rank3Rate = 0;
 
-        for (size_t reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter){
-            Mat4 H_real;
-            random_Mat4(H_real);
-            AutoCalibrationLinear<double> a;
-            fl.draw_random_fl(num_cams); //Focal_length used in reconstruction vary.
-
-            Mat34 Ps[num_cams];
-            Mat3 Ks[num_cams];
-            for (size_t i = 0; i < num_cams; ++i){
-                Ks[i] << fl.current_focal_lengths[i], 0, width / 2,
-                            0, fl.current_focal_lengths[i], height / 2,
-                            0, 0, 1;
+        // Generate the reconstructions first, each from its own random stream as in a sweep,
+        // then autocalibrate them all at once on all the cores.  With adaptive stopping or strata,
+        // this is done for the min_reconstructions or for the reconstructions expected to give
+        // target_count cameras to every focal length, then for twice as many, and so on until the
+        // K costs have converged and every focal length of the strata has target_count cameras.
+        const size_t first_reconstructions = FirstVaryingReconstructions(stopping, strata, num_cams, num_reconstructions);
+        const std::string path = VaryingFocalLengthPath(num_cams, num_reconstructions, translation_range, stopping, strata, settings);
+
+        auto enough = [&]() { return VaryingLossesConverged(fl, stopping, strata); };
+
+        // The losses are saved after every round, a relaunched experiment continuing from the last one.
+        SweepCheckpoint<VaryingFocalLosses> checkpoint(path + ".checkpoint", seed, VaryingFocalLosses{fl});
+        size_t reconstructions = 0, round = 0;
+        bool finished = false;
+        VaryingFocalLosses saved{fl};
+        for (size_t saved_reconstructions = 0; checkpoint.take(round, &saved, &saved_reconstructions); ++round) {
+            fl = saved.fl;
+            Rank3Rate = saved.rank3_count;
+            reconstructions = saved_reconstructions;
+            finished = enough();
+        }
+        while (!finished && reconstructions < size_t(num_reconstructions)) {
+            const size_t first_reconstruction = reconstructions;
+            reconstructions = reconstructions == 0 ? first_reconstructions
+                                                   : std::min<size_t>(2 * reconstructions, num_reconstructions);
+            const size_t batch = reconstructions - first_reconstruction;
+
+            std::vector<Mat34> all_Ps;
+            std::vector<Mat3> all_Ks;
+            std::vector<size_t> all_focal_lengths;
+            std::vector<size_t> offsets(1, 0);
+            Scene scene;
+            for (size_t reconstruction_counter = 0; reconstruction_counter < batch; ++reconstruction_counter){
+                const size_t reconstruction = first_reconstruction + reconstruction_counter;
+                SeedExperimentRng(seed, 0, reconstruction);
+                std::shared_ptr<const BaseScene> base;
+                if (settings.common_random_numbers) base = SceneCache::global().get(seed, reconstruction, num_cams, settings.rotations);
+                else scene.draw_distortion();
+                fl.draw_random_fl(num_cams); //Focal_length used in reconstruction vary.
 
-                Ps[i] = P_out_of_random_Rt(Ks[i], translation_range) * H_real.inverse(); // Distort cameras
-                a.AddProjection(Ps[i], width, height);
+                scene.Ks.resize(num_cams);
+                for (int i = 0; i < num_cams; ++i){
+                    scene.Ks[i] << fl.current_focal_lengths[i], 0, width / 2,
+                                      0, fl.current_focal_lengths[i], height / 2,
+                                      0, 0, 1;
+                }
+                if (base) scene.draw_cameras(*base, translation_range);
+                else scene.draw_cameras(translation_range, settings.rotations); // Distort cameras
+                all_Ps.insert(all_Ps.end(), scene.Ps.begin(), scene.Ps.end());
+                all_Ks.insert(all_Ks.end(), scene.Ks.begin(), scene.Ks.end());
+                all_focal_lengths.insert(all_focal_lengths.end(), fl.current_focal_lengths.begin(), fl.current_focal_lengths.end());
+                offsets.push_back(all_Ps.size());
             }
-            
-            Mat4 Q;
-            int rank = 0;
-            Mat4 H_computed = a.MetricTransformation(&Q, &rank);
 
-            Rank3Rate += (rank == 3);
+            std::vector<AutoCalibrationResult<double>> results;
+            AutoCalibrationBatch(all_Ps, offsets, width, height, &results);
 
-            for (size_t i = 0; i < num_cams; ++i) {
-                Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
-                Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
-                Vec3 t_from_QR;
+            // Undistort all the cameras, and decompose them at once.
+            std::vector<Mat34> all_P_metric(all_Ps.size());
+            for (size_t reconstruction_counter = 0; reconstruction_counter < batch; ++reconstruction_counter){
+                for (size_t i = offsets[reconstruction_counter]; i < offsets[reconstruction_counter + 1]; ++i) {
+                    all_P_metric[i] = all_Ps[i] * results[reconstruction_counter].H;
+                }
+            }
+            std::vector<Mat3> all_K_from_QR(all_Ps.size()), all_R_from_QR(all_Ps.size());
+            std::vector<Vec3> all_t_from_QR(all_Ps.size());
+            KRt_From_P_Batch(all_P_metric.data(), all_P_metric.size(), all_K_from_QR.data(), all_R_from_QR.data(), all_t_from_QR.data());
+
+            // Same for K from the image of the absolute quadric, flagging the cameras where it is not positive definite.
+            std::vector<Mat3> all_KKt(all_Ps.size()), all_K_from_iac(all_Ps.size());
+            std::unique_ptr<bool[]> all_iac_positive_definite(new bool[all_Ps.size()]);
+            for (size_t reconstruction_counter = 0; reconstruction_counter < batch; ++reconstruction_counter){
+                const size_t first = offsets[reconstruction_counter];
+                ImagesOfTheAbsoluteQuadric(results[reconstruction_counter].Q, &all_Ps[first], num_cams, &all_KKt[first]);
+            }
+            K_From_ImageOfTheDualAbsoluteQuadric_Batch(all_KKt.data(), all_KKt.size(), all_K_from_iac.data(), all_iac_positive_definite.get());
 
-                KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
-                K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
-                R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
+            for (size_t reconstruction_counter = 0; reconstruction_counter < batch; ++reconstruction_counter){
+                Mat3 *Ks = &all_Ks[offsets[reconstruction_counter]];
+                fl.current_focal_lengths.assign(all_focal_lengths.begin() + offsets[reconstruction_counter],
+                                                all_focal_lengths.begin() + offsets[reconstruction_counter + 1]);
 
-                fl.add_loss(i, "QR_Kcost", Mat3_distance(Ks[i], K_from_QR));
-                fl.add_loss(i, "QR_Focalcost", sqrt((Ks[i](1,1) - K_from_QR(1,1)) * (Ks[i](1,1) - K_from_QR(1,1)) + (Ks[i](0,0) - K_from_QR(0,0)) * (Ks[i](0,0) - K_from_QR(0,0))));
-                fl.add_loss(i, "QR_PPcost", sqrt((Ks[i](0,2) - K_from_QR(0,2)) * (Ks[i](0,2) - K_from_QR(0,2)) + (Ks[i](1,2) - K_from_QR(1,2)) * (Ks[i](1,2) - K_from_QR(1,2))));
-                fl.add_loss(i, "QR_Skewcost", (Ks[i](0,1) - K_from_QR(0,1)) * (Ks[i](0,1) - K_from_QR(0,1)));
-                fl.add_loss(i, "QR_RRtcost", proportional_to_rotation_loss(R_from_QR));
+                Rank3Rate += (results[reconstruction_counter].rank == 3);
 
-                fl.add_loss(i, "IAC_Kcost", Mat3_distance(Ks[i], K_from_iac));
-                fl.add_loss(i, "IAC_Focalcost", sqrt((Ks[i](1,1) - K_from_iac(1,1)) * (Ks[i](1,1) - K_from_iac(1,1)) + (Ks[i](0,0) - K_from_iac(0,0)) * (Ks[i](0,0) - K_from_iac(0,0))));
-                fl.add_loss(i, "IAC_PPcost", sqrt((Ks[i](0,2) - K_from_iac(0,2)) * (Ks[i](0,2) - K_from_iac(0,2)) + (Ks[i](1,2) - K_from_iac(1,2)) * (Ks[i](1,2) - K_from_iac(1,2))));
-                fl.add_loss(i, "IAC_Skewcost", (Ks[i](0,1) - K_from_iac(0,1)) * (Ks[i](0,1) - K_from_iac(0,1)));
-                fl.add_loss(i, "IAC_RRtcost", proportional_to_rotation_loss(R_from_iac));
+                for (int i = 0; i < num_cams; ++i) {
+                    const Mat34 &P_metric = all_P_metric[offsets[reconstruction_counter] + i];
+                    Mat3 K_from_QR = all_K_from_QR[offsets[reconstruction_counter] + i];
+                    Mat3 R_from_QR = all_R_from_QR[offsets[reconstruction_counter] + i];
+                    Mat3 K_from_iac = all_K_from_iac[offsets[reconstruction_counter] + i];
+                    Mat3 R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
+
+                    fl.add_loss(i, Loss::QR_Kcost, Mat3_distance(Ks[i], K_from_QR));
+                    fl.add_loss(i, Loss::QR_Focalcost, sqrt((Ks[i](1,1) - K_from_QR(1,1)) * (Ks[i](1,1) - K_from_QR(1,1)) + (Ks[i](0,0) - K_from_QR(0,0)) * (Ks[i](0,0) - K_from_QR(0,0))));
+                    fl.add_loss(i, Loss::QR_PPcost, sqrt((Ks[i](0,2) - K_from_QR(0,2)) * (Ks[i](0,2) - K_from_QR(0,2)) + (Ks[i](1,2) - K_from_QR(1,2)) * (Ks[i](1,2) - K_from_QR(1,2))));
+                    fl.add_loss(i, Loss::QR_Skewcost, (Ks[i](0,1) - K_from_QR(0,1)) * (Ks[i](0,1) - K_from_QR(0,1)));
+                    fl.add_loss(i, Loss::QR_RRtcost, proportional_to_rotation_loss(R_from_QR));
+
+                    if (!all_iac_positive_definite[offsets[reconstruction_counter] + i]) continue;  // Counted in IAC_PDRate.
+                    fl.add_loss(i, Loss::IAC_Kcost, Mat3_distance(Ks[i], K_from_iac));
+                    fl.add_loss(i, Loss::IAC_Focalcost, sqrt((Ks[i](1,1) - K_from_iac(1,1)) * (Ks[i](1,1) - K_from_iac(1,1)) + (Ks[i](0,0) - K_from_iac(0,0)) * (Ks[i](0,0) - K_from_iac(0,0))));
+                    fl.add_loss(i, Loss::IAC_PPcost, sqrt((Ks[i](0,2) - K_from_iac(0,2)) * (Ks[i](0,2) - K_from_iac(0,2)) + (Ks[i](1,2) - K_from_iac(1,2)) * (Ks[i](1,2) - K_from_iac(1,2))));
+                    fl.add_loss(i, Loss::IAC_Skewcost, (Ks[i](0,1) - K_from_iac(0,1)) * (Ks[i](0,1) - K_from_iac(0,1)));
+                    fl.add_loss(i, Loss::IAC_RRtcost, proportional_to_rotation_loss(R_from_iac));
+                }
             }
+
+            checkpoint.save(round++, VaryingFocalLosses{fl, Rank3Rate}, reconstructions);
+            finished = enough();
         }
-        std::stringstream path;
-        path << "../results/RecoverK&R_varying_detailed_"
-             << num_cams << "Cams_"
-             << num_reconstructions << "Reconstr_"
-             << translation_range << "Transl"
-             << "_CamDistLogN(" << center << "," << stddev << ").txt";
 
-        fl.write_losses(path.str());
+        if (!fl.write_losses(path, reconstructions)) return;  // Keeping the checkpoint.
+        checkpoint.remove();
 
-        Rank3Rate /= num_reconstructions;
-        std::cout << "Successfully wrote" << path.str() << "Rank 3 rate: " << Rank3Rate << std::endl;
+        Rank3Rate /= reconstructions;
+        std::cout << "Successfully wrote" << path << "Rank 3 rate: " << Rank3Rate << std::endl;
+        std::cout << "Mean QR_Kcost : " << fl.population_mean(Loss::QR_Kcost)
+                  << ", mean IAC_Kcost : " << fl.population_mean(Loss::IAC_Kcost) << std::endl;
     }
         
-    void recoverK_VARYING_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions){
+    void recoverK_VARYING_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, uint64_t seed, const AdaptiveStopping &stopping, const GridRefinement &refinement,
+                                                              const FocalLengthStrata &strata, const Shard &shard,
+                                                              const ExperimentSettings &settings){
         // VARYING focal lengths for each reconstruction. Look at the effect of translation range on the losses when recovering K through QR and IAC.
 
         // Here we pick the distribution of focal length of the cameras (Normal or log-normal))
-        const double center = 3.7, stddev = 0.6;
-        const bool use_log_normal = true; // If false, use normal distribution.
+        const double center = settings.center, stddev = settings.stddev;
+        const bool use_log_normal = settings.use_log_normal; // If false, use normal distribution.
         // By using the real dimensions of a full-frame sensor, the focal length is equal to the equivalent focal length
-        const double width = 36, height = 24; 
-    
-        FocalLengths_DistributionAndLosses fl(center, stddev, use_log_normal);
+        const double width = settings.width, height = settings.height; 
 
-        // We do a logarithmic sweep of the translation range.
-        const double translation_range_min = 0.001, translation_range_max = 10000;
-        const size_t steps = 200;
+        // We do a logarithmic sweep of the translation range, on a regular grid or on a lattice refined where the
+        // losses change.
+        const double translation_range_min = settings.translation_range_min, translation_range_max = settings.translation_range_max;
+        const size_t steps = refinement.enabled() ? refinement.num_intervals : settings.translation_steps;
 
         const double logStart = std::log10(translation_range_min);
         const double logEnd = std::log10(translation_range_max);
         const double logStep = (logEnd - logStart) / steps;
 
-        std::stringstream path;
-        path << "../results/Effect_of_translation_range_varying_"
-             << num_cams << "Cams_"
-             << num_reconstructions << "Reconstr_"
-             << "CamDistLogN(" << center << "," << stddev << ").txt";
-
-        std::ofstream outFile(path.str());
+        const std::string path = VaryingTranslationRangePath(num_cams, num_reconstructions, stopping, refinement, strata, settings);
 
-        if (!outFile){
-            std::cerr << "Errors opening file for writing!" << std::endl;
+        if (refinement.enabled() && shard.enabled()) {
+            std::cerr << "A refined sweep cannot be sharded, its points depend on each other" << std::endl;
+            return;
         }
 
-        outFile << "TranslationRange\tFocalLength\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate\n";
-        for (size_t current_step = 0; current_step < steps; ++current_step){
-            fl.clear();
-            double translation_range = std::pow(10, logStart + current_step * logStep);
-            double Rank3Rate;
-
-            for (size_t reconstruction_counter = 0; reconstruction_counter < num_reconstructions; ++reconstruction_counter){
-                Mat4 H_real;
-                random_Mat4(H_real);
-                AutoCalibrationLinear<double> a;
-                fl.draw_random_fl(num_cams); //Focal_length used in reconstruction vary.
-
-                Mat34 Ps[num_cams];
-                Mat3 Ks[num_cams];
-                for (size_t i = 0; i < num_cams; ++i){
-                    Ks[i] << fl.current_focal_lengths[i], 0, width / 2,
-                                0, fl.current_focal_lengths[i], height / 2,
-                                0, 0, 1;
+        // The result file, or the partial file of the shard, to be merged by merge_shards.
+        ShardHeader header;
+        header.experiment = "VARYING_translation_range";
+        header.path = path;
+        header.columns = FocalLengths_DistributionAndLosses::translation_range_columns();
+        header.num_cams = num_cams;
+        header.seed = seed;
+        ResultWriter outFile;
+        std::ofstream partialFile;
+        if (!OpenSweepFile(&outFile, &partialFile, header, shard)) return;
+
+        using Losses = VaryingFocalLosses;
+
+        auto run_reconstruction = [&](size_t step, size_t reconstruction, Losses *losses) {
+            const double translation_range = std::pow(10, logStart + step * logStep);
+            FocalLengths_DistributionAndLosses &fl = losses->fl;
+
+            thread_local Scene scene;
+            std::shared_ptr<const BaseScene> base;  // Of all the points, with common random numbers.
+            if (settings.common_random_numbers) base = SceneCache::global().get(seed, reconstruction, num_cams, settings.rotations);
+            else scene.draw_distortion();
+            fl.draw_random_fl(num_cams); //Focal_length used in reconstruction vary.
 
-                    Ps[i] = P_out_of_random_Rt(Ks[i], translation_range) * H_real.inverse(); // Distort cameras
-                    a.AddProjection(Ps[i], width, height);
-                }
+            scene.Ks.resize(num_cams);
+            for (int i = 0; i < num_cams; ++i){
+                scene.Ks[i] << fl.current_focal_lengths[i], 0, width / 2,
+                                  0, fl.current_focal_lengths[i], height / 2,
+                                  0, 0, 1;
+            }
+            if (base) scene.draw_cameras(*base, translation_range);
+            else scene.draw_cameras(translation_range, settings.rotations); // Distort cameras
+            const std::vector<Mat3> &Ks = scene.Ks;
+            const std::vector<Mat34> &Ps = scene.Ps;
+            AutoCalibrationLinear<double> a;
+            for (const Mat34 &P : Ps) a.AddProjection(P, width, height);
 
-                Mat4 Q;
-                int rank = 0;
-                Mat4 H_computed = a.MetricTransformation(&Q, &rank);
-                Rank3Rate += (rank == 3);
+            Mat4 Q;
+            int rank = 0;
+            Mat4 H_computed = a.MetricTransformation(&Q, &rank);
+            losses->rank3_count += (rank == 3);
 
-                for (size_t i = 0; i < num_cams; ++i) {
-                    Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
-                    Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
-                    Vec3 t_from_QR;
+            for (int i = 0; i < num_cams; ++i) {
+                Mat34 P_metric = Ps[i] * H_computed;  // Undistort cameras.
+                Mat3 K_from_QR, K_from_iac, R_from_QR, R_from_iac;
+                Vec3 t_from_QR;
 
-                    KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
-                    K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
-                    R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
+                KRt_From_P(P_metric, &K_from_QR, &R_from_QR, &t_from_QR);
+                bool iac_positive_definite = K_From_ImageOfTheAbsoluteConic(Q, Ps[i], &K_from_iac);
+                R_from_iac = K_from_iac.inverse() * P_metric.block<3, 3>(0, 0);
 
-                    fl.add_loss(i, "QR_Kcost", Mat3_distance(Ks[i], K_from_QR));
-                    fl.add_loss(i, "QR_Focalcost", sqrt((Ks[i](1,1) - K_from_QR(1,1)) * (Ks[i](1,1) - K_from_QR(1,1)) + (Ks[i](0,0) - K_from_QR(0,0)) * (Ks[i](0,0) - K_from_QR(0,0))));
-                    fl.add_loss(i, "QR_PPcost", sqrt((Ks[i](0,2) - K_from_QR(0,2)) * (Ks[i](0,2) - K_from_QR(0,2)) + (Ks[i](1,2) - K_from_QR(1,2)) * (Ks[i](1,2) - K_from_QR(1,2))));
-                    fl.add_loss(i, "QR_Skewcost", (Ks[i](0,1) - K_from_QR(0,1)) * (Ks[i](0,1) - K_from_QR(0,1)));
-                    fl.add_loss(i, "QR_RRtcost", proportional_to_rotation_loss(R_from_QR));
+                fl.add_loss(i, Loss::QR_Kcost, Mat3_distance(Ks[i], K_from_QR));
+                fl.add_loss(i, Loss::QR_Focalcost, sqrt((Ks[i](1,1) - K_from_QR(1,1)) * (Ks[i](1,1) - K_from_QR(1,1)) + (Ks[i](0,0) - K_from_QR(0,0)) * (Ks[i](0,0) - K_from_QR(0,0))));
+                fl.add_loss(i, Loss::QR_PPcost, sqrt((Ks[i](0,2) - K_from_QR(0,2)) * (Ks[i](0,2) - K_from_QR(0,2)) + (Ks[i](1,2) - K_from_QR(1,2)) * (Ks[i](1,2) - K_from_QR(1,2))));
+                fl.add_loss(i, Loss::QR_Skewcost, (Ks[i](0,1) - K_from_QR(0,1)) * (Ks[i](0,1) - K_from_QR(0,1)));
+                fl.add_loss(i, Loss::QR_RRtcost, proportional_to_rotation_loss(R_from_QR));
 
-                    fl.add_loss(i, "IAC_Kcost", Mat3_distance(Ks[i], K_from_iac));
-                    fl.add_loss(i, "IAC_Focalcost", sqrt((Ks[i](1,1) - K_from_iac(1,1)) * (Ks[i](1,1) - K_from_iac(1,1)) + (Ks[i](0,0) - K_from_iac(0,0)) * (Ks[i](0,0) - K_from_iac(0,0))));
-                    fl.add_loss(i, "IAC_PPcost", sqrt((Ks[i](0,2) - K_from_iac(0,2)) * (Ks[i](0,2) - K_from_iac(0,2)) + (Ks[i](1,2) - K_from_iac(1,2)) * (Ks[i](1,2) - K_from_iac(1,2))));
-                    fl.add_loss(i, "IAC_Skewcost", (Ks[i](0,1) - K_from_iac(0,1)) * (Ks[i](0,1) - K_from_iac(0,1)));
-                    fl.add_loss(i, "IAC_RRtcost", proportional_to_rotation_loss(R_from_iac));
+                if (!iac_positive_definite) continue;  // No K from the IAC, counted in IAC_PDRate.
+                fl.add_loss(i, Loss::IAC_Kcost, Mat3_distance(Ks[i], K_from_iac));
+                fl.add_loss(i, Loss::IAC_Focalcost, sqrt((Ks[i](1,1) - K_from_iac(1,1)) * (Ks[i](1,1) - K_from_iac(1,1)) + (Ks[i](0,0) - K_from_iac(0,0)) * (Ks[i](0,0) - K_from_iac(0,0))));
+                fl.add_loss(i, Loss::IAC_PPcost, sqrt((Ks[i](0,2) - K_from_iac(0,2)) * (Ks[i](0,2) - K_from_iac(0,2)) + (Ks[i](1,2) - K_from_iac(1,2)) * (Ks[i](1,2) - K_from_iac(1,2))));
+                fl.add_loss(i, Loss::IAC_Skewcost, (Ks[i](0,1) - K_from_iac(0,1)) * (Ks[i](0,1) - K_from_iac(0,1)));
+                fl.add_loss(i, Loss::IAC_RRtcost, proportional_to_rotation_loss(R_from_iac));
 
-                }
             }
-            Rank3Rate /= num_reconstructions;
-            fl.write_losses_for_a_given_translation_range(outFile, translation_range, Rank3Rate);
+        };
+
+        auto write_point = [&](size_t step, const Losses &losses, size_t point_reconstructions) {
+            const double translation_range = std::pow(10, logStart + step * logStep);
+            if (shard.enabled()) WriteShardRecord(partialFile, step, translation_range, point_reconstructions, losses);
+            else losses.fl.write_losses_for_a_given_translation_range(outFile, translation_range, losses.rank3_count / point_reconstructions,
+                                                                      point_reconstructions);
+        };
+
+        // A relaunched sweep continues from the points of the checkpoint, deleted once the file is written.
+        const std::string written_path = shard.enabled() ? ShardPath(path, shard) : path;
+        const Losses empty{FocalLengths_DistributionAndLosses(center, stddev, use_log_normal, strata)};
+        SweepCheckpoint<Losses> checkpoint(written_path + ".checkpoint", seed, empty);
+        // With strata, every point runs until each focal length has target_count cameras.
+        const size_t first_reconstructions = FirstVaryingReconstructions(stopping, strata, num_cams, num_reconstructions);
+        auto converged = [&](const Losses &losses) { return VaryingLossesConverged(losses.fl, stopping, strata); };
+        if (refinement.enabled()) {
+            auto change = [](const Losses &a, size_t a_reconstructions, const Losses &b, size_t b_reconstructions) {
+                return std::max({LogChange(a.fl.statistics(Loss::QR_Kcost).mean(), b.fl.statistics(Loss::QR_Kcost).mean()),
+                                 LogChange(a.fl.statistics(Loss::IAC_Kcost).mean(), b.fl.statistics(Loss::IAC_Kcost).mean()),
+                                 std::abs(a.rank3_count / a_reconstructions - b.rank3_count / b_reconstructions)});
+            };
+            RunRefinedSweep(refinement, first_reconstructions, num_reconstructions, seed,
+                            empty, run_reconstruction, converged, change, write_point, nullptr, &checkpoint);
+        } else {
+            RunAdaptiveSweep(ShardPoints(steps, shard), first_reconstructions, num_reconstructions, seed,
+                             empty, run_reconstruction, converged, write_point, nullptr, &checkpoint);
+        }
+        if (!CloseSweepFile(&outFile, &partialFile, written_path, shard)) return;  // Keeping the checkpoint.
+        checkpoint.remove();
+        std::cout << "Successfully wrote : " << written_path << std::endl;
+    }
+
+    bool MergeTranslationRangeShards(const std::vector<std::string> &paths){
+        ShardHeader header;
+        std::ifstream first(paths.front(), std::ios::binary);
+        if (!first || !ReadShardHeader(first, &header)) {
+            std::cerr << "Cannot read the partial file " << paths.front() << std::endl;
+            return false;
+        }
+        first.close();
+
+        if (header.experiment == "FIXED_translation_range") {
+            return MergeShards(paths, FixedFocalLosses(),
+                               [](ResultWriter &out, const ShardHeader &header, double translation_range,
+                                  const FixedFocalLosses &total, size_t num_reconstructions) {
+                                   total.write_losses_for_a_given_translation_range(out, translation_range, header.num_cams, num_reconstructions);
+                               });
+        }
+        if (header.experiment == "VARYING_translation_range") {
+            // The distribution is read back with the losses.
+            return MergeShards(paths, VaryingFocalLosses{FocalLengths_DistributionAndLosses(0, 1)},
+                               [](ResultWriter &out, const ShardHeader &, double translation_range,
+                                  const VaryingFocalLosses &total, size_t num_reconstructions) {
+                                   total.fl.write_losses_for_a_given_translation_range(out, translation_range, total.rank3_count / num_reconstructions,
+                                                                                       num_reconstructions);
+                               });
         }
-        outFile.close();
-        std::cout << "Successfully wrote : " << path.str() << std::endl;
+        std::cerr << "Unknown experiment " << header.experiment << " in " << paths.front() << std::endl;
+        return false;
     }
 }
\ No newline at end of file
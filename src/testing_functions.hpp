@@ -3,19 +3,102 @@
 #pragma once
 
 #include "libmv.hpp"
+#include "sweep.hpp"
+#include "shards.hpp"
+#include "utils_for_testing.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace rootba_povar {
+    // The test_ functions print what they measure.  Those checking a result throw std::runtime_error when it is wrong,
+    // which fails the run of RunExperiments.
     void test_K_From_AbsoluteConic();
 
     void test_with_metric_input();
 
-    void recoverK_IACvsQR(int num_cams = 10, int num_reconstructions = 1, double translation_range = 1);
+    void test_wc_closed_form();
 
-    void recoverK_detailed_losses(int num_cams = 10, int num_reconstructions = 10, double translation_range = 1);
+    void test_normal_equations_vs_svd();
 
-    void recoverK_varying_focal_length(int num_cams = 10, int num_reconstructions = 100, double translation_range = 1);
+    void test_sliding_window();
 
-    void recoverK_FIXED_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, int equivalent_focal_length);
+    void test_simd_jacobi();
 
-    void recoverK_VARYING_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions);
+    void test_KRt_batch();
+
+    void test_upper_cholesky();
+
+    void test_stacked_iac();
+
+    void test_sweep_determinism();
+
+    void test_philox();
+
+    void test_streaming_statistics();
+
+    void test_stratified_focal_lengths();
+
+    void test_checkpoint_resume();
+
+    void test_columnar_results();
+
+    void test_result_sink();
+
+    void test_scene_generator();
+
+    void test_common_random_numbers();
+
+    void test_shared_diac_coefficients();
+
+    void test_constraint_policies();
+
+    void test_sharded_sweep();
+
+    // The sweeps run their reconstructions on all the cores (see RunAdaptiveSweep), the files they write only depend on seed.
+    // num_reconstructions is the number of reconstructions per point, the maximum one when stopping is enabled, and each
+    // row ends with the number actually run.  The translation range sweeps can be split over several processes with
+    // shard, each writing a partial file for merge_shards.  The sweeps save every point to a checkpoint next to their file,
+    // so that a sweep relaunched after dying partway through continues where it stopped.  settings holds the constants of
+    // the scenes, see ExperimentSettings.
+    void recoverK_IACvsQR(int num_cams = 10, int num_reconstructions = 1, double translation_range = 1, uint64_t seed = 0, const AdaptiveStopping &stopping = AdaptiveStopping(),
+                          const ExperimentSettings &settings = ExperimentSettings());
+
+    void recoverK_detailed_losses(int num_cams = 10, int num_reconstructions = 10, double translation_range = 1, uint64_t seed = 0, const AdaptiveStopping &stopping = AdaptiveStopping(),
+                                  const ExperimentSettings &settings = ExperimentSettings());
+
+    // With strata, num_reconstructions is the maximum number of reconstructions, and the losses of each focal length
+    // carry its Probability under the distribution for the weighted means.
+    void recoverK_varying_focal_length(int num_cams = 10, int num_reconstructions = 100, double translation_range = 1, uint64_t seed = 0, const AdaptiveStopping &stopping = AdaptiveStopping(),
+                                       const FocalLengthStrata &strata = FocalLengthStrata(),
+                                       const ExperimentSettings &settings = ExperimentSettings());
+
+    void recoverK_FIXED_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, int equivalent_focal_length, uint64_t seed = 0, const AdaptiveStopping &stopping = AdaptiveStopping(),
+                                                            const GridRefinement &refinement = GridRefinement(),
+                                                            const Shard &shard = Shard(),
+                                                            const ExperimentSettings &settings = ExperimentSettings());
+
+    void recoverK_VARYING_IACvsQR_effect_of_translation_range(int num_cams, int num_reconstructions, uint64_t seed = 0, const AdaptiveStopping &stopping = AdaptiveStopping(),
+                                                              const GridRefinement &refinement = GridRefinement(),
+                                                              const FocalLengthStrata &strata = FocalLengthStrata(),
+                                                              const Shard &shard = Shard(),
+                                                              const ExperimentSettings &settings = ExperimentSettings());
+
+    // The result files of the experiments above, for the same parameters.  A sharded sweep writes ShardPath of its file.
+    std::string IACvsQRPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping, const ExperimentSettings &settings);
+
+    std::string DetailedLossesPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping, const ExperimentSettings &settings);
+
+    std::string VaryingFocalLengthPath(int num_cams, int num_reconstructions, double translation_range, const AdaptiveStopping &stopping,
+                                       const FocalLengthStrata &strata, const ExperimentSettings &settings);
+
+    std::string FixedTranslationRangePath(int num_cams, int num_reconstructions, int equivalent_focal_length, const AdaptiveStopping &stopping,
+                                          const GridRefinement &refinement, const ExperimentSettings &settings);
+
+    std::string VaryingTranslationRangePath(int num_cams, int num_reconstructions, const AdaptiveStopping &stopping, const GridRefinement &refinement,
+                                            const FocalLengthStrata &strata, const ExperimentSettings &settings);
+
+    // Writes the result file of a translation range sweep run in shards from the partial files of all its shards, as
+    // the unsharded sweep would have.  False, with a message, if it cannot.
+    bool MergeTranslationRangeShards(const std::vector<std::string> &paths);
 }
\ No newline at end of file
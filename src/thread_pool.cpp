@@ -0,0 +1,153 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+namespace rootba_povar {
+
+    namespace {
+        // Pool and queue of the worker running on this thread, if any.
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local size_t current_queue = 0;
+    }
+
+    ThreadPool::ThreadPool(int num_threads) {
+        if (num_threads <= 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (int i = 0; i < num_threads; ++i) {
+            queues_.push_back(std::make_unique<TaskQueue>());
+        }
+        for (int i = 0; i < num_threads; ++i) {
+            workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        wake_up_.notify_all();
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+    }
+
+    ThreadPool &ThreadPool::global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        // Counted before it can be popped, so that pop_task never takes the count below zero.
+        ++num_queued_;
+        if (current_pool == this) {
+            // LIFO on the own queue keeps the caches of the worker warm.
+            TaskQueue &queue = *queues_[current_queue];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_front(std::move(task));
+        } else {
+            TaskQueue &queue = *queues_[next_queue_++ % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_front(std::move(task));
+        }
+        {
+            // Taking the lock makes sure that a thread about to sleep sees the new task.
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+        wake_up_.notify_one();
+    }
+
+    bool ThreadPool::pop_task(size_t preferred_queue, std::function<void()> *task) {
+        if (num_queued_ == 0) return false;
+
+        for (size_t k = 0; k < queues_.size(); ++k) {
+            size_t i = (preferred_queue + k) % queues_.size();
+            TaskQueue &queue = *queues_[i];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+
+            // Own tasks from the front, stolen ones from the back where the oldest and largest tasks are.
+            if (k == 0) {
+                *task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                *task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            --num_queued_;
+            return true;
+        }
+        return false;
+    }
+
+    bool ThreadPool::run_pending_task() {
+        size_t preferred_queue = (current_pool == this) ? current_queue : next_queue_.load() % queues_.size();
+        std::function<void()> task;
+        if (!pop_task(preferred_queue, &task)) return false;
+        task();
+        return true;
+    }
+
+    void ThreadPool::worker_loop(size_t index) {
+        current_pool = this;
+        current_queue = index;
+
+        std::function<void()> task;
+        while (true) {
+            if (pop_task(index, &task)) {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_up_.wait(lock, [this] { return stop_ || num_queued_ > 0; });
+            if (stop_ && num_queued_ == 0) return;
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t)> &body) {
+        if (begin >= end) return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t num_tasks = (end - begin + grain - 1) / grain;
+
+        // The last task only touches members of the pool after its decrement, so that the caller may return as soon
+        // as it sees remaining == 0.  The first exception thrown by body is rethrown on the caller, the tasks not
+        // started yet skipping their indices.
+        std::atomic<size_t> remaining{num_tasks};
+        std::atomic<bool> failed{false};
+        std::exception_ptr first_exception;
+        std::mutex exception_mutex;
+
+        for (size_t t = 0; t < num_tasks; ++t) {
+            submit([&, t] {
+                if (!failed.load()) {
+                    try {
+                        size_t first = begin + t * grain;
+                        size_t last = std::min(end, first + grain);
+                        for (size_t i = first; i < last; ++i) {
+                            body(i);
+                        }
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(exception_mutex);
+                        if (!first_exception) first_exception = std::current_exception();
+                        failed.store(true);
+                    }
+                }
+                if (remaining.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                    wake_up_.notify_all();
+                }
+            });
+        }
+
+        // Help with the queued tasks instead of blocking a thread, sleeping until a task is queued or all are done.
+        while (remaining.load() != 0) {
+            if (run_pending_task()) continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_up_.wait(lock, [&] { return remaining.load() == 0 || num_queued_ > 0; });
+        }
+        if (first_exception) std::rethrow_exception(first_exception);
+    }
+}
@@ -0,0 +1,78 @@
+// Work-stealing thread pool used to run independent autocalibrations and experiments in parallel.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rootba_povar {
+
+    class ThreadPool {
+    public:
+        /** \brief Starts the worker threads.
+         *
+         *  \param num_threads Number of workers, 0 for one per hardware thread.
+         */
+        explicit ThreadPool(int num_threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int num_threads() const { return static_cast<int>(workers_.size()); }
+
+        /** \brief Queues a task.
+         *
+         *  Tasks submitted from a worker go to the front of its own queue, other
+         *  tasks are spread over the queues.  Idle workers steal from the back of
+         *  the other queues.
+         */
+        void submit(std::function<void()> task);
+
+        /** \brief Calls body(i) for every i in [begin, end) and returns once all
+         *         calls are done.
+         *
+         *  \param grain Number of consecutive indices run by one task.
+         *
+         *  The calling thread runs queued tasks while it waits, so parallel_for
+         *  can be nested inside tasks of the same pool.  If body throws, the
+         *  indices not started yet are skipped and the first exception is
+         *  rethrown once all the running calls are done.
+         */
+        void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t)> &body);
+
+        /** \brief Runs one queued task, if any, on the calling thread.
+         *
+         *  \return False if all the queues were empty.
+         */
+        bool run_pending_task();
+
+        /** \brief The pool shared by the whole program, with one worker per hardware thread. */
+        static ThreadPool &global();
+
+    private:
+        struct TaskQueue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void worker_loop(size_t index);
+        bool pop_task(size_t preferred_queue, std::function<void()> *task);
+
+        std::vector<std::unique_ptr<TaskQueue>> queues_;
+        std::vector<std::thread> workers_;
+
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_up_;
+        std::atomic<size_t> num_queued_{0};
+        std::atomic<size_t> next_queue_{0};
+        bool stop_ = false;
+    };
+}
@@ -1,6 +1,13 @@
 #include "utils_for_testing.hpp"
+#include "batched_kernels.hpp"
+#include "sweep.hpp"
+#include "binary_io.hpp"
+#include <Eigen/Geometry>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <sstream>
 
 namespace rootba_povar {
     Mat3 RotationAroundX(double angle) {
@@ -34,16 +41,16 @@ namespace rootba_povar {
     }
     
     Mat3 random_rotation(double angle_range) {
-        Mat3 R = RotationAroundX(double(rand()) / RAND_MAX * angle_range)
-            * RotationAroundY(double(rand()) / RAND_MAX * angle_range)
-            * RotationAroundZ(double(rand()) / RAND_MAX * angle_range);
+        Mat3 R = RotationAroundX(UniformRandom() * angle_range)
+            * RotationAroundY(UniformRandom() * angle_range)
+            * RotationAroundZ(UniformRandom() * angle_range);
         return R;
     }
 
     Vec3 random_translation(double translation_range) {
-        Vec3 t(double(rand()) / RAND_MAX * translation_range,
-            double(rand()) / RAND_MAX * translation_range,
-            double(rand()) / RAND_MAX* translation_range);
+        Vec3 t(UniformRandom() * translation_range,
+            UniformRandom() * translation_range,
+            UniformRandom()* translation_range);
         return t;
     }
     Mat34 P_out_of_random_Rt(Mat3 K, double translation_range ){
@@ -59,7 +66,7 @@ namespace rootba_povar {
         (*P) = K * (*P);
     }
 
-    double Mat3_distance(Mat3 &A, Mat3 &B){
+    double Mat3_distance(const Mat3 &A, const Mat3 &B){
         // Normalized w.r.t A so that we get a distance invariant to the scale of the matrices compared.
         double tot = 0;
         for (int i=0; i<3; ++i){
@@ -87,7 +94,7 @@ namespace rootba_povar {
         return tot_diff;
     }
 
-    double proportional_to_rotation_loss(Mat3 &R){
+    double proportional_to_rotation_loss(const Mat3 &R){
         Mat3 RRt = R * R.transpose();
         double average_diagonal = (RRt(0,0) + RRt(1,1) + RRt(2,2)) / 3.0;
         RRt /= average_diagonal; // Normalize the trace to 1
@@ -97,107 +104,534 @@ namespace rootba_povar {
     }
 
     Mat34 add_noise_to_P(const Mat34 &P, double noise_multiplicator){
-        static std::mt19937 gen(std::random_device{}());
-        static std::normal_distribution<double> dist(0.0, 1.0);
+        std::normal_distribution<double> dist(0.0, 1.0);
         double average_coefficient_size = P.norm() / std::sqrt(12.0); // Assuming uniform distribution, the average coefficient size is the norm divided by sqrt(12)
         Mat34 noise;
         for (int i = 0; i < 3; ++i) {
             for (int j = 0; j < 4; ++j) {
-                noise(i, j) = dist(gen) * average_coefficient_size * noise_multiplicator;
+                noise(i, j) = dist(ExperimentRng()) * average_coefficient_size * noise_multiplicator;
             }
         }
         return P + noise;
     }
     
-    void K_From_ImageOfTheAbsoluteConic(Mat4 &Q, Mat34 &P, Mat3 *K){
+    bool K_From_ImageOfTheAbsoluteConic(const Mat4 &Q, const Mat34 &P, Mat3 *K){
         Mat3 KKt = P * Q * P.transpose();
         KKt /= KKt(2,2);
-        K_From_ImageOfTheDualAbsoluteQuadric(KKt, K);
+        return K_From_ImageOfTheDualAbsoluteQuadric(KKt, K);
     }
+
+    void ImagesOfTheAbsoluteQuadric(const Mat4 &Q, const Mat34 *Ps, size_t num_cams, Mat3 *KKt){
+        for (size_t i = 0; i < num_cams; ++i) {
+            // Row major : the result files depend on the rounding of this product.
+            const Eigen::Matrix<double, 3, 4, Eigen::RowMajor> P = Ps[i];
+            Eigen::Matrix<double, 3, 4, Eigen::RowMajor> PQ;
+            PQ.noalias() = P * Q;
+            KKt[i].noalias() = PQ * P.transpose();
+            KKt[i] /= KKt[i](2,2);
+        }
+    }
+
+    void K_From_ImageOfTheAbsoluteConic(const Mat4 &Q, const Mat34 *Ps, size_t num_cams, Mat3 *K, bool *positive_definite){
+        thread_local std::vector<Mat3> KKt;  // Only grows, as the scenes of the sweeps.
+        KKt.resize(num_cams);
+        ImagesOfTheAbsoluteQuadric(Q, Ps, num_cams, KKt.data());
+        K_From_ImageOfTheDualAbsoluteQuadric_Batch(KKt.data(), num_cams, K, positive_definite);
+    }
+
+    void Scene::draw_distortion(){
+        random_Mat4(H_real);
+        H_inverse = H_real.inverse();
+    }
+
+    void Scene::draw_cameras(double translation_range, RotationSampling rotations){
+        const size_t num_cams = Ks.size();
+        Ps.resize(num_cams);
+        Mat34 P_metric;
+        if (rotations == RotationSampling::EulerAngles) {
+            for (size_t i = 0; i < num_cams; ++i) {
+                UseCameraStream(i);
+                const Mat3 R = random_rotation();
+                const Vec3 t = random_translation(translation_range);
+                P_From_KRt(Ks[i], R, t, &P_metric);
+                Ps[i].noalias() = P_metric * H_inverse;
+            }
+            return;
+        }
+
+        // The draws of every camera from its stream, then the rotations of all the cameras from loops over arrays.
+        draws_.resize(7 * num_cams);
+        double *qx = draws_.data(), *qy = qx + num_cams, *qz = qy + num_cams, *qw = qz + num_cams;
+        double *tx = qw + num_cams, *ty = tx + num_cams, *tz = ty + num_cams;
+        for (size_t i = 0; i < num_cams; ++i) {
+            UseCameraStream(i);
+            qx[i] = UniformRandom();
+            qy[i] = UniformRandom();
+            qz[i] = UniformRandom();
+            tx[i] = UniformRandom() * translation_range;
+            ty[i] = UniformRandom() * translation_range;
+            tz[i] = UniformRandom() * translation_range;
+        }
+        // Shoemake's uniform quaternion from the uniform draws (u1, u2, u3) held in (qx, qy, qz).
+        for (size_t i = 0; i < num_cams; ++i) {
+            const double a = std::sqrt(1 - qx[i]), b = std::sqrt(qx[i]);
+            const double angle2 = 2 * M_PI * qy[i], angle3 = 2 * M_PI * qz[i];
+            qx[i] = a * std::sin(angle2);
+            qy[i] = a * std::cos(angle2);
+            qz[i] = b * std::sin(angle3);
+            qw[i] = b * std::cos(angle3);
+        }
+        for (size_t i = 0; i < num_cams; ++i) {
+            const Mat3 R = Eigen::Quaterniond(qw[i], qx[i], qy[i], qz[i]).toRotationMatrix();
+            P_From_KRt(Ks[i], R, Vec3(tx[i], ty[i], tz[i]), &P_metric);
+            Ps[i].noalias() = P_metric * H_inverse;
+        }
+    }
+
+    void Scene::draw(const Mat3 &K, size_t num_cams, double translation_range, RotationSampling rotations){
+        draw_distortion();
+        Ks.assign(num_cams, K);
+        draw_cameras(translation_range, rotations);
+    }
+
+    void Scene::draw_cameras(const BaseScene &base, double translation_range){
+        H_real = base.H_real;
+        H_inverse = base.H_inverse;
+        Ps.resize(Ks.size());
+        Mat34 P_metric;
+        for (size_t i = 0; i < Ks.size(); ++i) {
+            P_From_KRt(Ks[i], base.Rs[i], base.ts[i] * translation_range, &P_metric);
+            Ps[i].noalias() = P_metric * H_inverse;
+        }
+    }
+
+    namespace {
+        // The point of the streams of the base scenes, no point of a sweep.
+        constexpr uint32_t kCommonScenePoint = 0xFFFFFFFF;
+
+        // Cameras first to last of the base scene of (seed, reconstruction), drawn as Scene::draw_cameras does.
+        void DrawBaseCameras(uint64_t seed, uint64_t reconstruction, size_t first, size_t last, RotationSampling rotations,
+                             BaseScene *scene){
+            Philox4x32 rng;
+            rng.seed(seed);
+            auto uniform = [&rng]() { return std::uniform_real_distribution<double>(0, 1)(rng); };
+            scene->Rs.resize(last);
+            scene->ts.resize(last);
+            for (size_t i = first; i < last; ++i) {
+                rng.set_stream(uint32_t(i) + 1, uint32_t(reconstruction), kCommonScenePoint);
+                const double u1 = uniform(), u2 = uniform(), u3 = uniform();
+                if (rotations == RotationSampling::EulerAngles) {
+                    scene->Rs[i] = RotationAroundX(3 * u1) * RotationAroundY(3 * u2) * RotationAroundZ(3 * u3);
+                } else {
+                    const double a = std::sqrt(1 - u1), b = std::sqrt(u1);
+                    scene->Rs[i] = Eigen::Quaterniond(b * std::cos(2 * M_PI * u3), a * std::sin(2 * M_PI * u2),
+                                                      a * std::cos(2 * M_PI * u2), b * std::sin(2 * M_PI * u3)).toRotationMatrix();
+                }
+                const double tx = uniform(), ty = uniform(), tz = uniform();
+                scene->ts[i] = Vec3(tx, ty, tz);
+            }
+        }
+    }
+
+    std::shared_ptr<const BaseScene> SceneCache::get(uint64_t seed, uint64_t reconstruction, size_t num_cams, RotationSampling rotations){
+        const Key key(reconstruction, seed, rotations);
+        std::shared_ptr<const BaseScene> cached;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto scene = scenes_.find(key);
+            if (scene != scenes_.end()) cached = scene->second;
+        }
+        if (cached && cached->num_cams() >= num_cams) return cached;
+
+        // Drawn without the lock : a scene drawn by two threads at once is the same, and only the first one is kept.
+        auto scene = std::make_shared<BaseScene>();
+        if (cached) {
+            *scene = *cached;
+        } else {
+            Philox4x32 rng;
+            rng.seed(seed);
+            rng.set_stream(0, uint32_t(reconstruction), kCommonScenePoint);
+            for (int i = 0; i < 16; ++i) scene->H_real(i / 4, i % 4) = std::uniform_real_distribution<double>(0, 1)(rng) * 10;
+            scene->H_inverse = scene->H_real.inverse();
+        }
+        DrawBaseCameras(seed, reconstruction, cached ? cached->num_cams() : 0, num_cams, rotations, scene.get());
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto inserted = scenes_.insert({key, scene});
+        if (inserted.second) {
+            ++num_drawn_;
+            if (scenes_.size() > capacity_) scenes_.erase(std::prev(scenes_.end()));
+        } else if (inserted.first->second->num_cams() < num_cams) {
+            ++num_drawn_;
+            inserted.first->second = scene;
+        } else {
+            return inserted.first->second;
+        }
+        return scene;
+    }
+
+    SceneCache &SceneCache::global(){
+        static SceneCache cache;
+        return cache;
+    }
+
+    void DrawScene(const Mat3 &K, size_t num_cams, double translation_range, uint64_t seed, uint64_t reconstruction,
+                   const ExperimentSettings &settings, Scene *scene){
+        if (!settings.common_random_numbers) {
+            scene->draw(K, num_cams, translation_range, settings.rotations);
+            return;
+        }
+        scene->Ks.assign(num_cams, K);
+        scene->draw_cameras(*SceneCache::global().get(seed, reconstruction, num_cams, settings.rotations), translation_range);
+    }
+
     void random_Mat4(Mat4& P, double scale){
-        P << double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale,
-        double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale,
-        double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale,
-        double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale, double(rand()) / RAND_MAX * scale;
+        P << UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale,
+        UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale,
+        UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale,
+        UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale, UniformRandom() * scale;
     }
 
-    FocalLengths_DistributionAndLosses::FocalLengths_DistributionAndLosses(double center, double stddev, bool use_LogNormal)
-        : center(center), stddev(stddev), use_LogNormal(use_LogNormal)
+    std::string LossesStatisticsColumns(){
+        std::string columns;
+        for (const char *name : kLossNames) columns += StatisticsColumns(name);
+        return columns;
+    }
+
+    void WriteLossesStatistics(ResultWriter &out, const LossesStatistics &statistics){
+        for (const StreamingStatistics &loss_statistics : statistics) WriteStatistics(out, loss_statistics);
+    }
+
+    double MeanLoss(double sum, double count){
+        return count > 0 ? sum / count : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    void FixedFocalLosses::add(Loss which_loss, double loss){
+        sums[static_cast<size_t>(which_loss)] += loss;
+        statistics[static_cast<size_t>(which_loss)].add(loss);
+        if (which_loss == Loss::QR_Kcost) {
+            maxQR_Kcost = std::max(maxQR_Kcost, loss);
+        } else if (which_loss == Loss::IAC_Kcost) {
+            maxIAC_Kcost = std::max(maxIAC_Kcost, loss);
+            iac_count++;
+        }
+    }
+
+    void FixedFocalLosses::merge(const FixedFocalLosses &other){
+        for (size_t which_loss = 0; which_loss < kNumLosses; ++which_loss) {
+            sums[which_loss] += other.sums[which_loss];
+            statistics[which_loss].merge(other.statistics[which_loss]);
+        }
+        rank3_count += other.rank3_count;
+        maxQR_Kcost = std::max(maxQR_Kcost, other.maxQR_Kcost);
+        maxIAC_Kcost = std::max(maxIAC_Kcost, other.maxIAC_Kcost);
+        iac_count += other.iac_count;
+    }
+
+    std::string FixedFocalLosses::translation_range_columns(){
+        return "TranslationRange\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate\tIAC_PDRate"
+               + LossesStatisticsColumns() + "\tReconstructions\n";
+    }
+
+    void FixedFocalLosses::write_losses_for_a_given_translation_range(ResultWriter &outFile, double translation_range, size_t num_cams, size_t num_reconstructions) const {
+        const double num_projections = num_reconstructions * num_cams;
+        outFile << translation_range
+                << sum(Loss::QR_Kcost) / num_projections
+                << maxQR_Kcost
+                << sum(Loss::QR_Focalcost) / num_projections
+                << sum(Loss::QR_PPcost) / num_projections
+                << sum(Loss::QR_Skewcost) / num_projections
+                << sum(Loss::QR_RRtcost) / num_projections
+                << MeanLoss(sum(Loss::IAC_Kcost), iac_count)
+                << maxIAC_Kcost
+                << MeanLoss(sum(Loss::IAC_Focalcost), iac_count)
+                << MeanLoss(sum(Loss::IAC_PPcost), iac_count)
+                << MeanLoss(sum(Loss::IAC_Skewcost), iac_count)
+                << MeanLoss(sum(Loss::IAC_RRtcost), iac_count)
+                << rank3_count / num_reconstructions
+                << iac_count / num_projections;
+        WriteLossesStatistics(outFile, statistics);
+        outFile << num_reconstructions;
+        outFile.end_row();
+    }
+
+    void FixedFocalLosses::save(std::ostream &out) const {
+        WriteBinary(out, sums);
+        for (const StreamingStatistics &loss_statistics : statistics) loss_statistics.save(out);
+        WriteBinary(out, rank3_count);
+        WriteBinary(out, maxQR_Kcost);
+        WriteBinary(out, maxIAC_Kcost);
+        WriteBinary(out, uint64_t(iac_count));
+    }
+
+    void FixedFocalLosses::load(std::istream &in) {
+        ReadBinary(in, &sums);
+        for (StreamingStatistics &loss_statistics : statistics) loss_statistics.load(in);
+        ReadBinary(in, &rank3_count);
+        ReadBinary(in, &maxQR_Kcost);
+        ReadBinary(in, &maxIAC_Kcost);
+        uint64_t count = 0;
+        ReadBinary(in, &count);
+        iac_count = count;
+    }
+
+    std::string FocalLengthStrataTag(const FocalLengthStrata &strata){
+        std::stringstream tag;
+        if (strata.enabled()) tag << "_Stratified" << strata.min_focal_length << "-" << strata.max_focal_length;
+        if (strata.target_count != FocalLengthStrata().target_count) tag << "_Target" << strata.target_count;
+        return tag.str();
+    }
+
+    std::string ExperimentSettingsTag(const ExperimentSettings &settings){
+        const ExperimentSettings defaults;
+        std::stringstream tag;
+        if (settings.width != defaults.width || settings.height != defaults.height) {
+            tag << "_Sensor" << settings.width << "x" << settings.height;
+        }
+        if (settings.min_focal_length != defaults.min_focal_length || settings.max_focal_length != defaults.max_focal_length) {
+            tag << "_FL" << settings.min_focal_length << "-" << settings.max_focal_length;
+        }
+        if (settings.translation_range_min != defaults.translation_range_min || settings.translation_range_max != defaults.translation_range_max
+            || settings.translation_steps != defaults.translation_steps) {
+            tag << "_Transl" << settings.translation_range_min << "-" << settings.translation_range_max << "x" << settings.translation_steps;
+        }
+        if (settings.rotations != defaults.rotations) tag << "_UniformRotations";
+        if (settings.common_random_numbers) tag << "_CRN";
+        return tag.str();
+    }
+
+    FocalLengths_DistributionAndLosses::FocalLengths_DistributionAndLosses(double center, double stddev, bool use_LogNormal, const FocalLengthStrata &strata)
+        : center(center), stddev(stddev), use_LogNormal(use_LogNormal), strata(strata)
     {
-        std::random_device rd;
-        gen = std::mt19937(rd());
         dist = std::normal_distribution<double>(center, stddev);
         log_dist = std::lognormal_distribution<double>(center, stddev);
     }
 
-    void FocalLengths_DistributionAndLosses::add_loss(size_t idx, std::string which_loss, double loss){
-            losses_map[current_focal_lengths[idx]][which_loss] += loss;
-            if (which_loss == "QR_Kcost") {
-                losses_map[current_focal_lengths[idx]]["maxQR_Kcost"] = std::max(losses_map[current_focal_lengths[idx]]["maxQR_Kcost"], loss);
-            } else if (which_loss == "IAC_Kcost") {
-                losses_map[current_focal_lengths[idx]]["maxIAC_Kcost"] = std::max(losses_map[current_focal_lengths[idx]]["maxIAC_Kcost"], loss);
+    void FocalLengths_DistributionAndLosses::add_loss(size_t idx, Loss which_loss, double loss){
+            FlLog &losses_list = losses_map[current_focal_lengths[idx]];  // Allocated by draw_random_fl.
+            losses_list[which_loss] += loss;
+            losses_list.statistics[static_cast<size_t>(which_loss)].add(loss);
+            if (which_loss == Loss::QR_Kcost) {
+                losses_list.maxQR_Kcost = std::max(losses_list.maxQR_Kcost, loss);
+            } else if (which_loss == Loss::IAC_Kcost) {
+                losses_list.maxIAC_Kcost = std::max(losses_list.maxIAC_Kcost, loss);
+                losses_list.IAC_Count += 1;
             }
     }
 
     void FocalLengths_DistributionAndLosses::draw_random_fl(size_t num_cams){
         current_focal_lengths.resize(num_cams);
-        for (int i = 0; i < num_cams; ++i) {
-            double number;
-            if (use_LogNormal) number = log_dist(gen);
-            else do {number = dist(gen);} while (number < 5);
-            size_t val = static_cast<size_t>(std::round(number)); // Choose integer focal length
+        // Forget the numbers cached by the previous draws, so that the focal lengths only depend on the stream of
+        // the reconstruction.
+        dist.reset();
+        log_dist.reset();
+        for (size_t i = 0; i < num_cams; ++i) {
+            size_t val;
+            if (strata.enabled()) {
+                val = strata.min_focal_length + std::min(static_cast<size_t>(UniformRandom() * strata.num_focal_lengths()),
+                                                         strata.num_focal_lengths() - 1);
+            } else {
+                double number;
+                if (use_LogNormal) number = log_dist(ExperimentRng());
+                else do {number = dist(ExperimentRng());} while (number < 5);
+                val = static_cast<size_t>(std::round(number)); // Choose integer focal length
+            }
             current_focal_lengths[i] = val;
-            losses_map[val]["Count"] += 1;
+            if (val >= losses_map.size()) losses_map.resize(val + 1);
+            losses_map[val].Count += 1;
+        }
+    }
+
+    bool FocalLengths_DistributionAndLosses::write_losses(std::string path, size_t num_reconstructions){
+        ResultWriter outFile;
+        if (!outFile.open(path, "FocalLength\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tIAC_PDRate"
+                                + LossesStatisticsColumns() + "\tReconstructions\tProbability\n")) {
+            return false;
+        }
+        for (size_t focal_length = 0; focal_length < losses_map.size(); ++focal_length) {
+            const FlLog &losses_list = losses_map[focal_length];
+            if (losses_list.Count >= strata.target_count){  // Fewer cameras give too noisy means.
+                outFile << focal_length
+                        << losses_list[Loss::QR_Kcost] / losses_list.Count
+                        << losses_list.maxQR_Kcost
+                        << losses_list[Loss::QR_Focalcost] / losses_list.Count
+                        << losses_list[Loss::QR_PPcost] / losses_list.Count
+                        << losses_list[Loss::QR_Skewcost] / losses_list.Count
+                        << losses_list[Loss::QR_RRtcost] / losses_list.Count
+                        << MeanLoss(losses_list[Loss::IAC_Kcost], losses_list.IAC_Count)
+                        << losses_list.maxIAC_Kcost
+                        << MeanLoss(losses_list[Loss::IAC_Focalcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_PPcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_Skewcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_RRtcost], losses_list.IAC_Count)
+                        << losses_list.IAC_Count / losses_list.Count;
+                WriteLossesStatistics(outFile, losses_list.statistics);
+                outFile << num_reconstructions << probability(focal_length);
+                outFile.end_row();
+            }
+        }
+        return outFile.close();
+    }
+
+    std::string FocalLengths_DistributionAndLosses::translation_range_columns(){
+        return "TranslationRange\tFocalLength\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\tRank3Rate\tIAC_PDRate"
+               + LossesStatisticsColumns() + "\tReconstructions\tProbability\n";
+    }
+
+    void FocalLengths_DistributionAndLosses::write_losses_for_a_given_translation_range(ResultWriter &outFile, double translation_range, double Rank3Rate, size_t num_reconstructions) const {
+        for (size_t focal_length = 0; focal_length < losses_map.size(); ++focal_length) {
+            const FlLog &losses_list = losses_map[focal_length];
+            if (losses_list.Count >= strata.target_count){  // Fewer cameras give too noisy means.
+                outFile << translation_range
+                        << focal_length
+                        << losses_list[Loss::QR_Kcost] / losses_list.Count
+                        << losses_list.maxQR_Kcost
+                        << losses_list[Loss::QR_Focalcost] / losses_list.Count
+                        << losses_list[Loss::QR_PPcost] / losses_list.Count
+                        << losses_list[Loss::QR_Skewcost] / losses_list.Count
+                        << losses_list[Loss::QR_RRtcost] / losses_list.Count
+                        << MeanLoss(losses_list[Loss::IAC_Kcost], losses_list.IAC_Count)
+                        << losses_list.maxIAC_Kcost
+                        << MeanLoss(losses_list[Loss::IAC_Focalcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_PPcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_Skewcost], losses_list.IAC_Count)
+                        << MeanLoss(losses_list[Loss::IAC_RRtcost], losses_list.IAC_Count)
+                        << Rank3Rate
+                        << losses_list.IAC_Count / losses_list.Count;
+                WriteLossesStatistics(outFile, losses_list.statistics);
+                outFile << num_reconstructions << probability(focal_length);
+                outFile.end_row();
+            }
         }
     }
 
-    void FocalLengths_DistributionAndLosses::write_losses(std::string path){
-        std::ofstream outFile(path);
+    StreamingStatistics FocalLengths_DistributionAndLosses::statistics(Loss which_loss) const {
+        StreamingStatistics statistics;
+        for (const FlLog &losses_list : losses_map) {
+            statistics.merge(losses_list.statistics[static_cast<size_t>(which_loss)]);
+        }
+        return statistics;
+    }
 
-        if (!outFile){
-            std::cerr << "Erros opening file for writing!" << std::endl;
+    void FocalLengths_DistributionAndLosses::save(std::ostream &out) const {
+        WriteBinary(out, center);
+        WriteBinary(out, stddev);
+        WriteBinary(out, use_LogNormal);
+        WriteBinary(out, uint64_t(strata.min_focal_length));
+        WriteBinary(out, uint64_t(strata.max_focal_length));
+        WriteBinary(out, uint64_t(strata.target_count));
+        // Only the focal lengths with cameras, most of the dense array being empty.
+        WriteBinary(out, uint64_t(losses_map.size()));
+        WriteBinary(out, uint64_t(std::count_if(losses_map.begin(), losses_map.end(), [](const FlLog &losses_list) { return losses_list.Count > 0; })));
+        for (size_t focal_length = 0; focal_length < losses_map.size(); ++focal_length) {
+            const FlLog &losses_list = losses_map[focal_length];
+            if (losses_list.Count == 0) continue;
+            WriteBinary(out, uint64_t(focal_length));
+            WriteBinary(out, losses_list.sums);
+            for (const StreamingStatistics &loss_statistics : losses_list.statistics) loss_statistics.save(out);
+            WriteBinary(out, losses_list.maxQR_Kcost);
+            WriteBinary(out, losses_list.maxIAC_Kcost);
+            WriteBinary(out, losses_list.Count);
+            WriteBinary(out, losses_list.IAC_Count);
         }
+    }
+
+    void FocalLengths_DistributionAndLosses::load(std::istream &in) {
+        uint64_t min_focal_length = 0, max_focal_length = 0, target_count = 0, num_focal_lengths = 0, num_saved = 0;
+        ReadBinary(in, &center);
+        ReadBinary(in, &stddev);
+        ReadBinary(in, &use_LogNormal);
+        ReadBinary(in, &min_focal_length);
+        ReadBinary(in, &max_focal_length);
+        ReadBinary(in, &target_count);
+        ReadBinary(in, &num_focal_lengths);
+        ReadBinary(in, &num_saved);
+        if (!in) return;
+        strata.min_focal_length = min_focal_length;
+        strata.max_focal_length = max_focal_length;
+        strata.target_count = target_count;
+        dist = std::normal_distribution<double>(center, stddev);
+        log_dist = std::lognormal_distribution<double>(center, stddev);
+        losses_map.assign(num_focal_lengths, FlLog());
+        for (uint64_t saved = 0; saved < num_saved; ++saved) {
+            uint64_t focal_length = 0;
+            ReadBinary(in, &focal_length);
+            if (!in || focal_length >= losses_map.size()) {
+                in.setstate(std::ios::failbit);
+                return;
+            }
+            FlLog &losses_list = losses_map[focal_length];
+            ReadBinary(in, &losses_list.sums);
+            for (StreamingStatistics &loss_statistics : losses_list.statistics) loss_statistics.load(in);
+            ReadBinary(in, &losses_list.maxQR_Kcost);
+            ReadBinary(in, &losses_list.maxIAC_Kcost);
+            ReadBinary(in, &losses_list.Count);
+            ReadBinary(in, &losses_list.IAC_Count);
+        }
+    }
+
+    double FocalLengths_DistributionAndLosses::probability(size_t focal_length) const {
+        // draw_random_fl rounds the number drawn : focal_length comes from [focal_length - 0.5, focal_length + 0.5).
+        auto normal_cdf = [](double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); };
+        const double low = std::max(focal_length - 0.5, 0.0), high = focal_length + 0.5;
+        if (use_LogNormal) {
+            const double low_cdf = low > 0 ? normal_cdf((std::log(low) - center) / stddev) : 0;
+            return normal_cdf((std::log(high) - center) / stddev) - low_cdf;
+        }
+        // The normal draws below 5 are rejected.
+        if (high <= 5) return 0;
+        const double kept = 1 - normal_cdf((5 - center) / stddev);
+        return (normal_cdf((high - center) / stddev) - normal_cdf((std::max(low, 5.0) - center) / stddev)) / kept;
+    }
+
+    double FocalLengths_DistributionAndLosses::weight(size_t focal_length) const {
+        if (!strata.enabled()) return 1;
+        return probability(focal_length) * strata.num_focal_lengths();
+    }
 
-        outFile << "FocalLength\tQR_Kcost\tmaxQR_Kcost\tQR_Focalcost\tQR_PPcost\tQR_Skewcost\tQR_RRtcost\tIAC_Kcost\tmaxIAC_Kcost\tIAC_Focalcost\tIAC_PPcost\tIAC_Skewcost\tIAC_RRtcost\n";
-        for (auto& [focal_length, losses_list] : losses_map) {
-            if (losses_list["Count"] > 15){
-                outFile << focal_length << "\t"
-                        << losses_list["QR_Kcost"] / losses_list["Count"] << "\t"
-                        << losses_list["maxQR_Kcost"] << "\t"
-                        << losses_list["QR_Focalcost"] / losses_list["Count"] << "\t"
-                        << losses_list["QR_PPcost"] / losses_list["Count"] << "\t"
-                        << losses_list["QR_Skewcost"] / losses_list["Count"] <<"\t"
-                        << losses_list["QR_RRtcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_Kcost"] / losses_list["Count"] << "\t"
-                        << losses_list["maxIAC_Kcost"] << "\t"
-                        << losses_list["IAC_Focalcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_PPcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_Skewcost"] / losses_list["Count"] <<"\t"
-                        << losses_list["IAC_RRtcost"] / losses_list["Count"] << "\n";
+    double FocalLengths_DistributionAndLosses::population_mean(Loss which_loss) const {
+        const bool is_iac_loss = which_loss >= Loss::IAC_Kcost;
+        if (!strata.enabled()) {
+            double sum = 0, count = 0;
+            for (const FlLog &losses_list : losses_map) {
+                sum += losses_list[which_loss];
+                count += is_iac_loss ? losses_list.IAC_Count : losses_list.Count;
             }
+            return MeanLoss(sum, count);
+        }
+        double weighted_sum = 0, weighted_count = 0;
+        for (size_t focal_length = 0; focal_length < losses_map.size(); ++focal_length) {
+            const FlLog &losses_list = losses_map[focal_length];
+            const double count = is_iac_loss ? losses_list.IAC_Count : losses_list.Count;
+            if (count == 0) continue;
+            // The mean of a focal length does not depend on how often it is drawn, only its weight does.
+            weighted_sum += weight(focal_length) * losses_list[which_loss] / count;
+            weighted_count += weight(focal_length);
         }
-        outFile.close();
-    }
-
-    void FocalLengths_DistributionAndLosses::write_losses_for_a_given_translation_range(std::ofstream &outFile, double translation_range, double Rank3Rate){
-        for (auto& [focal_length, losses_list] : losses_map) {
-            if (losses_list["Count"] > 15){
-                outFile << translation_range << "\t"
-                        << focal_length << "\t"
-                        << losses_list["QR_Kcost"] / losses_list["Count"] << "\t"
-                        << losses_list["maxQR_Kcost"] << "\t"
-                        << losses_list["QR_Focalcost"] / losses_list["Count"] << "\t"
-                        << losses_list["QR_PPcost"] / losses_list["Count"] << "\t"
-                        << losses_list["QR_Skewcost"] / losses_list["Count"] <<"\t"
-                        << losses_list["QR_RRtcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_Kcost"] / losses_list["Count"] << "\t"
-                        << losses_list["maxIAC_Kcost"] << "\t"
-                        << losses_list["IAC_Focalcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_PPcost"] / losses_list["Count"] << "\t"
-                        << losses_list["IAC_Skewcost"] / losses_list["Count"] <<"\t"
-                        << losses_list["IAC_RRtcost"] / losses_list["Count"] << "\t"
-                        << Rank3Rate << "\n";
+        return MeanLoss(weighted_sum, weighted_count);
+    }
+
+    double FocalLengths_DistributionAndLosses::min_count() const {
+        double count = std::numeric_limits<double>::infinity();
+        for (size_t focal_length = strata.min_focal_length; focal_length <= strata.max_focal_length; ++focal_length) {
+            count = std::min(count, focal_length < losses_map.size() ? losses_map[focal_length].Count : 0);
+        }
+        return count;
+    }
+
+    void FocalLengths_DistributionAndLosses::merge(const FocalLengths_DistributionAndLosses &other) {
+        if (other.losses_map.size() > losses_map.size()) losses_map.resize(other.losses_map.size());
+        for (size_t focal_length = 0; focal_length < other.losses_map.size(); ++focal_length) {
+            FlLog &losses_list = losses_map[focal_length];
+            const FlLog &other_losses_list = other.losses_map[focal_length];
+            for (size_t which_loss = 0; which_loss < kNumLosses; ++which_loss) {
+                losses_list.sums[which_loss] += other_losses_list.sums[which_loss];
+                losses_list.statistics[which_loss].merge(other_losses_list.statistics[which_loss]);
             }
+            losses_list.maxQR_Kcost = std::max(losses_list.maxQR_Kcost, other_losses_list.maxQR_Kcost);
+            losses_list.maxIAC_Kcost = std::max(losses_list.maxIAC_Kcost, other_losses_list.maxIAC_Kcost);
+            losses_list.Count += other_losses_list.Count;
+            losses_list.IAC_Count += other_losses_list.IAC_Count;
         }
     }
 
@@ -205,4 +639,19 @@ namespace rootba_povar {
         losses_map.clear();
         current_focal_lengths.clear();
     }
-}
\ No newline at end of file
+
+    void VaryingFocalLosses::merge(const VaryingFocalLosses &other) {
+        fl.merge(other.fl);
+        rank3_count += other.rank3_count;
+    }
+
+    void VaryingFocalLosses::save(std::ostream &out) const {
+        fl.save(out);
+        WriteBinary(out, rank3_count);
+    }
+
+    void VaryingFocalLosses::load(std::istream &in) {
+        fl.load(in);
+        ReadBinary(in, &rank3_count);
+    }
+}
@@ -3,11 +3,18 @@
 #pragma once
 
 #include "libmv.hpp"
+#include "streaming_statistics.hpp"
+#include "result_writer.hpp"
 #include <random>
 #include <vector>
-#include <map>
+#include <array>
 #include <string>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <tuple>
 
 namespace rootba_povar {
     Mat3 RotationAroundX(double angle);
@@ -19,28 +26,205 @@ namespace rootba_povar {
 
     void P_From_KRt(const Mat3 &K, const Mat3 &R, const Vec3 &t, Mat34 *P);
 
-    void K_From_ImageOfTheAbsoluteConic(Mat4 &Q, Mat34 &P, Mat3 *K);
+    bool K_From_ImageOfTheAbsoluteConic(const Mat4 &Q, const Mat34 &P, Mat3 *K); // False if P Q P^T is not positive definite
+
+    // KKt[i] = P_i Q P_i^T normalized by its (2,2) element, for the num_cams cameras stored one after the other, as
+    // those of a Scene : each 3x4 block P_i Q and the 3x3 diagonal block of Ps Q Ps^T are fixed size products, without
+    // any temporary.  KKt is ready for K_From_ImageOfTheDualAbsoluteQuadric_Batch.
+    void ImagesOfTheAbsoluteQuadric(const Mat4 &Q, const Mat34 *Ps, size_t num_cams, Mat3 *KKt);
+
+    // K_From_ImageOfTheAbsoluteConic for all the cameras of Ps, positive_definite[i] being its return value for camera i.
+    void K_From_ImageOfTheAbsoluteConic(const Mat4 &Q, const Mat34 *Ps, size_t num_cams, Mat3 *K, bool *positive_definite);
+
+    // How the rotations of the cameras are drawn : three Euler angles uniform in [0, 3] as in the experiments of the
+    // paper, or uniformly over all the rotations, from uniform quaternions computed for all the cameras at once.
+    enum class RotationSampling { EulerAngles, UniformQuaternions };
+
+    // The part of a scene shared by all the points of a sweep with common random numbers : the distortion, and the
+    // rotation and the translation for a translation range of 1 of every camera.
+    struct BaseScene {
+        Mat4 H_real, H_inverse;
+        std::vector<Mat3> Rs;
+        std::vector<Vec3> ts;
+
+        size_t num_cams() const { return Rs.size(); }
+    };
+
+    // A reconstruction drawn at once : the distortion H_real, inverted once, and the distorted cameras
+    // Ps[i] = Ks[i] [R_i | t_i] H_real^-1, one after the other so that AddProjection and the IAC read them in place.
+    // Camera i is drawn from its camera stream, so that a scene is the same whatever the order it is drawn in.  A thread
+    // keeps its scene from one reconstruction to the next, the buffers only growing.
+    struct Scene {
+        Mat4 H_real, H_inverse;
+        std::vector<Mat3> Ks;  // Set before draw_cameras.
+        std::vector<Mat34> Ps;
+
+        size_t num_cams() const { return Ps.size(); }
+
+        // H_real from the stream of the reconstruction, as random_Mat4.
+        void draw_distortion();
+
+        // A camera for each of Ks.  With EulerAngles, camera i is P_out_of_random_Rt(Ks[i], translation_range) * H_real.inverse().
+        void draw_cameras(double translation_range, RotationSampling rotations = RotationSampling::EulerAngles);
 
-    double Mat3_distance(Mat3 &A, Mat3 &B);
+        // draw_distortion, then num_cams cameras of calibration K.
+        void draw(const Mat3 &K, size_t num_cams, double translation_range, RotationSampling rotations = RotationSampling::EulerAngles);
+
+        // The distortion and the cameras of base instead of drawing them, with the calibrations of Ks (as many cameras).
+        void draw_cameras(const BaseScene &base, double translation_range);
+
+    private:
+        std::vector<double> draws_;  // The uniform draws of the quaternions and the translations, one array per coordinate.
+    };
+
+    // Common random numbers : the base scene of reconstruction r of seed is the same at every point of every sweep, for
+    // every method and camera count, so that their differences are not drowned in the differences between scenes.
+    // The scenes are drawn on demand from streams of their own, then kept up to capacity scenes, dropping those of the
+    // last reconstructions : the sweeps go through the reconstructions in order at every point, so that a cache too
+    // small for all of them still holds the first ones at the next point.  Drawing them again gives the same scenes, so
+    // the cache only saves their drawing, and is shared by all the threads.
+    class SceneCache {
+    public:
+        explicit SceneCache(size_t capacity = 4096) : capacity_(capacity) {}
+
+        // The base scene of (seed, reconstruction), with at least num_cams cameras : the first cameras of a scene do
+        // not depend on the number of cameras.
+        std::shared_ptr<const BaseScene> get(uint64_t seed, uint64_t reconstruction, size_t num_cams,
+                                             RotationSampling rotations = RotationSampling::EulerAngles);
+
+        size_t num_drawn() const { return num_drawn_; }  // Scenes drawn instead of found in the cache, once each.
+
+        // The cache of all the experiments.
+        static SceneCache &global();
+
+    private:
+        using Key = std::tuple<uint64_t, uint64_t, RotationSampling>;  // Reconstruction first, then seed.
+
+        const size_t capacity_;
+        std::mutex mutex_;
+        std::map<Key, std::shared_ptr<const BaseScene>> scenes_;  // The last one is dropped first.
+        std::atomic<size_t> num_drawn_{0};
+    };
+
+    double Mat3_distance(const Mat3 &A, const Mat3 &B);
 
     void random_Mat4(Mat4& P, double scale = 10);
 
-    double proportional_to_rotation_loss(Mat3 &R);
+    double proportional_to_rotation_loss(const Mat3 &R);
 
     Mat34 add_noise_to_P(const Mat34 &P, double noise_multiplicator);
 
+    // Losses summed per focal length by FocalLengths_DistributionAndLosses. The QR ones are averaged over all the
+    // cameras, the IAC ones over the cameras whose image of the absolute quadric is positive definite.
+    enum class Loss { QR_Kcost, QR_Focalcost, QR_PPcost, QR_Skewcost, QR_RRtcost,
+                      IAC_Kcost, IAC_Focalcost, IAC_PPcost, IAC_Skewcost, IAC_RRtcost, NumLosses };
+    constexpr size_t kNumLosses = static_cast<size_t>(Loss::NumLosses);
+    constexpr const char *kLossNames[kNumLosses] = {"QR_Kcost", "QR_Focalcost", "QR_PPcost", "QR_Skewcost", "QR_RRtcost",
+                                                   "IAC_Kcost", "IAC_Focalcost", "IAC_PPcost", "IAC_Skewcost", "IAC_RRtcost"};
+    using LossesStatistics = std::array<StreamingStatistics, kNumLosses>;
+
+    // Columns of the standard deviation, median and 90th percentile of every loss, appended to the result files.
+    std::string LossesStatisticsColumns();
+    void WriteLossesStatistics(ResultWriter &out, const LossesStatistics &statistics);
+
+    // sum / count, NaN if no camera has the loss, e.g. the IAC losses when no image of the absolute quadric is
+    // positive definite.
+    double MeanLoss(double sum, double count);
+
+    // Losses of the fixed focal length sweeps, summed over the cameras of some reconstructions.  The IAC losses only
+    // cover the iac_count cameras whose image of the absolute quadric is positive definite.
+    struct FixedFocalLosses {
+        std::array<double, kNumLosses> sums{};
+        LossesStatistics statistics;  // Of the same losses as sums.
+        double rank3_count = 0, maxQR_Kcost = 0, maxIAC_Kcost = 0;
+        size_t iac_count = 0;
+
+        void add(Loss which_loss, double loss);
+        double sum(Loss which_loss) const { return sums[static_cast<size_t>(which_loss)]; }
+        void merge(const FixedFocalLosses &other);
+
+        // Row of the losses of num_reconstructions reconstructions of num_cams cameras at translation_range, in the
+        // columns of translation_range_columns.
+        static std::string translation_range_columns();
+        void write_losses_for_a_given_translation_range(ResultWriter &outFile, double translation_range, size_t num_cams, size_t num_reconstructions) const;
+
+        void save(std::ostream &out) const; // With WriteBinary, read back by load
+        void load(std::istream &in);
+    };
+
+    // Focal lengths drawn uniformly in [min_focal_length, max_focal_length] by FocalLengths_DistributionAndLosses
+    // instead of from its distribution, so that every focal length of the range gets about as many cameras.  A
+    // varying experiment, at every point of a sweep, draws reconstructions until each of them has target_count cameras.
+    // Disabled when max_focal_length is 0.  With or without strata, only the focal lengths with target_count cameras
+    // are written.
+    struct FocalLengthStrata {
+        size_t min_focal_length = 0, max_focal_length = 0;
+        size_t target_count = 16;
+
+        bool enabled() const { return max_focal_length > 0; }
+        size_t num_focal_lengths() const { return max_focal_length - min_focal_length + 1; }
+    };
+
+    // "_Stratified<min>-<max>" for the names of the files of a stratified experiment, and "_Target<target_count>" when
+    // target_count is not the default.
+    std::string FocalLengthStrataTag(const FocalLengthStrata &strata);
+
+    // Constants of the scenes of the experiments : the sensor, the focal lengths of the fixed focal length sweeps, the
+    // distribution of the varying focal lengths and the grid of the translation range sweeps.  The defaults are the
+    // values of the paper experiments.
+    struct ExperimentSettings {
+        double width = 36, height = 24;  // Full-frame sensor, so that the focal length is equal to the equivalent focal length.
+        size_t min_focal_length = 10, max_focal_length = 300;
+        double center = 3.7, stddev = 0.6;
+        bool use_log_normal = true;  // If false, use normal distribution.
+        double translation_range_min = 0.001, translation_range_max = 10000;
+        size_t translation_steps = 200;  // Of the regular grid, a refined one has GridRefinement::num_intervals.
+        ResultFormat results_format = ResultFormat::Text;  // Only changes the extension of the names of the files.
+        RotationSampling rotations = RotationSampling::EulerAngles;
+        bool common_random_numbers = false;  // The same scenes at every point, from SceneCache::global().
+    };
+
+    // "_Sensor<width>x<height>", "_FL<min>-<max>", "_Transl<min>-<max>x<steps>", "_UniformRotations" and "_CRN" for the
+    // settings that differ from the defaults, for the names of the files.  The distribution is already in the names of the varying experiments.
+    std::string ExperimentSettingsTag(const ExperimentSettings &settings);
+
+    // Scene::draw, or with settings.common_random_numbers the base scene of (seed, reconstruction) with calibration K.
+    void DrawScene(const Mat3 &K, size_t num_cams, double translation_range, uint64_t seed, uint64_t reconstruction,
+                   const ExperimentSettings &settings, Scene *scene);
+
     class FocalLengths_DistributionAndLosses {
         
-        // Each focal length has a dictionnary containing : Count, QR_Kcost, QR_Focalcost, QR_PPcost, QR_Skewcost and the IAC equivalents
-        using FlLog = std::map<std::string, double>;
-        using LossesMap = std::map<size_t, FlLog>;
+        // Each focal length has the sums of its losses, the largest K costs, its number of cameras (Count) and
+        // its number of cameras with an IAC loss (IAC_Count).  Focal lengths are integers and index a dense array.
+        struct FlLog {
+            std::array<double, kNumLosses> sums{};
+            LossesStatistics statistics;  // Of the same losses as sums.
+            double maxQR_Kcost = 0, maxIAC_Kcost = 0;
+            double Count = 0, IAC_Count = 0;
+
+            double &operator[](Loss which_loss) { return sums[static_cast<size_t>(which_loss)]; }
+            double operator[](Loss which_loss) const { return sums[static_cast<size_t>(which_loss)]; }
+        };
+        using LossesMap = std::vector<FlLog>;
     public:
-        FocalLengths_DistributionAndLosses(double center, double stddev, bool use_LogNormal = false);
+        FocalLengths_DistributionAndLosses(double center, double stddev, bool use_LogNormal = false, const FocalLengthStrata &strata = FocalLengthStrata());
         void draw_random_fl(size_t num_cams); // Choose the focal lengths according to the distribution for the current reconstruction
-        void add_loss(size_t idx, std::string which_loss, double loss); // Add correct loss corresponding to the idx-th image of the reconstrution
-        void write_losses(std::string path); // Average losses and write them in a file for each focal length
-        void write_losses_for_a_given_translation_range(std::ofstream &outFile, double translation_range, double Rank3Rate);
+        void add_loss(size_t idx, Loss which_loss, double loss); // Add correct loss corresponding to the idx-th image of the reconstrution
+        bool write_losses(std::string path, size_t num_reconstructions); // Average losses and write them in a file for each focal length, false if it cannot
+        static std::string translation_range_columns(); // Of the rows of write_losses_for_a_given_translation_range
+        void write_losses_for_a_given_translation_range(ResultWriter &outFile, double translation_range, double Rank3Rate, size_t num_reconstructions) const;
+        StreamingStatistics statistics(Loss which_loss) const; // Of one loss over all the focal lengths
+
+        // With strata, the cameras of a focal length stand for probability(focal_length) / (1 / num_focal_lengths)
+        // times as many cameras drawn from the distribution.  Weights are 1 otherwise.
+        double probability(size_t focal_length) const; // Of drawing focal_length from the distribution
+        double weight(size_t focal_length) const;
+        double population_mean(Loss which_loss) const; // Mean of one loss over the cameras of the distribution, from the weighted means of the focal lengths
+        double min_count() const; // Fewest cameras of a focal length of the strata
+        void merge(const FocalLengths_DistributionAndLosses &other); // Add the losses of other, for the reduction of a sweep
         void clear();
+        void save(std::ostream &out) const; // The distribution and the losses, with WriteBinary, read back by load
+        void load(std::istream &in);
 
         std::vector<size_t> current_focal_lengths;
 
@@ -48,10 +232,20 @@ namespace rootba_povar {
         double center;
         double stddev;
         bool use_LogNormal;
+        FocalLengthStrata strata;
 
-        LossesMap losses_map;
+        LossesMap losses_map;  // Indexed by focal length.
         std::normal_distribution<double> dist;
-        std::lognormal_distribution<double> log_dist;
-        std::mt19937 gen;
+        std::lognormal_distribution<double> log_dist;  // Both draw from ExperimentRng().
+    };
+
+    // Losses per focal length of the reconstructions of the VARYING sweeps, with their number of rank 3 metric upgrades.
+    struct VaryingFocalLosses {
+        FocalLengths_DistributionAndLosses fl;
+        double rank3_count = 0;
+
+        void merge(const VaryingFocalLosses &other);
+        void save(std::ostream &out) const; // With WriteBinary, read back by load
+        void load(std::istream &in);
     };
-}
\ No newline at end of file
+}